@@ -5,4 +5,11 @@ CONFIG += ordered
 SUBDIRS += \
     EzGraverCore \
     EzGraverCli \
-    EzGraverUi
+    EzGraverUi \
+    EzGraverBench \
+    EzGraverDaemon
+
+unix:!macx: SUBDIRS += EzGraverSim
+
+# The tests run against the simulator where it is available.
+SUBDIRS += EzGraverTests
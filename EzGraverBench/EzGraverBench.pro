@@ -0,0 +1,20 @@
+include(../common.pri)
+
+QT += core
+QT += gui
+QT += testlib
+
+TARGET = EzGraverBench
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+SOURCES += pipelinebenchmark.cpp
+
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../EzGraverCore/release/ -lEzGraverCore
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../EzGraverCore/debug/ -lEzGraverCore
+else:unix: LIBS += -L$$OUT_PWD/../EzGraverCore/ -lEzGraverCore
+
+INCLUDEPATH += $$PWD/../EzGraverCore
+DEPENDPATH += $$PWD/../EzGraverCore
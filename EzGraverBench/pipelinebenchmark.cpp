@@ -0,0 +1,502 @@
+#include <QtTest>
+#include <QImage>
+#include <QPainter>
+#include <QTransform>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QMap>
+
+#include <algorithm>
+#include <vector>
+
+#include "imagepacker.h"
+#include "grayscalelayers.h"
+#include "dithering.h"
+#include "specifications.h"
+
+/*!
+ * Times every stage of the image conversion pipeline, from decoding the source file to
+ * packing the payload sent to the engraver. The results of the stages implemented by
+ * EzGraver are compared against straightforward reference implementations to ensure the
+ * optimized ones remain bit-exact. The stages merely timing Qt are not verified.
+ */
+class PipelineBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void decode_data();
+    void decode();
+    void mirror_data();
+    void mirror();
+    void rotate_data();
+    void rotate();
+    void scale_data();
+    void scale();
+    void compose_data();
+    void compose();
+    void dither_data();
+    void dither();
+    void ditherEngine_data();
+    void ditherEngine();
+    void layers_data();
+    void layers();
+    void pack_data();
+    void pack();
+
+private:
+    struct Source {
+        QString name;
+        QSize size;
+    };
+
+    QList<Source> _corpus{};
+    QMap<QString, QByteArray> _encoded{};
+    QMap<QString, QImage> _decoded{};
+    QMap<QString, QImage> _composed{};
+
+    void _addCorpusRows();
+};
+
+namespace {
+
+QImage createSource(QSize const& size) {
+    // Gradients, rings and noise give the dithering something to chew on.
+    QImage image{size, QImage::Format_ARGB32};
+    quint32 seed{0x2545F491};
+    auto cx = size.width() / 2;
+    auto cy = size.height() / 2;
+    auto radius = std::max(1, std::min(cx, cy) / 8);
+
+    for(int y{0}; y < size.height(); ++y) {
+        auto line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for(int x{0}; x < size.width(); ++x) {
+            seed = seed * 1664525u + 1013904223u;
+            auto dx = x - cx;
+            auto dy = y - cy;
+            auto ring = ((dx * dx + dy * dy) / (radius * radius)) % 2 == 0 ? 64 : 0;
+            auto noise = static_cast<int>(seed >> 27);
+            auto red = (x * 255 / size.width() + ring + noise) & 0xFF;
+            auto green = (y * 255 / size.height() + noise) & 0xFF;
+            auto blue = ((x + y) * 255 / (size.width() + size.height()) + ring) & 0xFF;
+            auto alpha = (x / 64 + y / 64) % 7 == 0 ? 128 : 255;
+            line[x] = qRgba(red, green, blue, alpha);
+        }
+    }
+    return image;
+}
+
+QByteArray digest(QImage const& image) {
+    QCryptographicHash hash{QCryptographicHash::Sha1};
+    hash.addData(QByteArray::number(image.format()));
+    hash.addData(QByteArray::number(image.width()) + 'x' + QByteArray::number(image.height()));
+    for(auto color : image.colorTable()) {
+        hash.addData(QByteArray::number(color, 16));
+    }
+
+    // Only the visible pixels count, the padding of the scanlines is undefined.
+    auto lineSize = (image.width() * image.depth() + 7) / 8;
+    for(int y{0}; y < image.height(); ++y) {
+        hash.addData(reinterpret_cast<char const*>(image.constScanLine(y)), lineSize);
+    }
+    return hash.result().toHex();
+}
+
+QByteArray digest(QByteArray const& data) {
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
+QImage compose(QImage const& source) {
+    // Equivalent of the composite stage of Ez::ImagePipeline without any transformation.
+    QImage image{QSize{Ez::Specifications::ImageWidth, Ez::Specifications::ImageHeight}, QImage::Format_ARGB32};
+    image.fill(QColor{Qt::white});
+    QPainter painter{&image};
+    painter.drawImage(QPoint{}, source.mirrored(false, false).scaled(image.size()));
+    return image;
+}
+
+QVector<QRgb> createColorTable(int layerCount) {
+    // Equivalent of Ez::layerColorTable.
+    QVector<QRgb> colorTable{};
+    for(int i{0}; i < layerCount - 1; ++i) {
+        int gray{(256 / (layerCount - 1)) * i};
+        colorTable.push_back(qRgb(gray, gray, gray));
+    }
+    colorTable.push_back(qRgb(255, 255, 255));
+    return colorTable;
+}
+
+QImage createLayer(QImage const& original, int layerCount, int layer, Qt::ImageConversionFlags flags) {
+    // The layer extraction ImageLabel performed before Ez::quantizeLayers was introduced.
+    auto colorTable = createColorTable(layerCount);
+    QImage grayed{original.convertToFormat(QImage::Format_Indexed8, colorTable, flags)};
+    if(layer == 0) {
+        return grayed;
+    }
+
+    for(int i{0}; i < colorTable.size(); ++i) {
+        colorTable[i] = i == layer - 1 ? qRgb(0, 0, 0) : qRgb(255, 255, 255);
+    }
+    grayed.setColorTable(colorTable);
+    return grayed.convertToFormat(QImage::Format_Mono, flags);
+}
+
+QByteArray legacyPayload(QImage const& original, Ez::PayloadFormat format) {
+    // The encoder based conversion used before packImage was introduced.
+    QImage image{original
+            .scaled(Ez::Specifications::ImageWidth, Ez::Specifications::ImageHeight)
+            .mirrored()
+            .convertToFormat(QImage::Format_Mono)};
+    if(format == Ez::PayloadFormat::Bitmap) {
+        image.invertPixels();
+    }
+
+    QByteArray bytes{};
+    QBuffer buffer{&bytes};
+    image.save(&buffer, "BMP");
+    return format == Ez::PayloadFormat::Bitmap ? bytes : bytes.mid(62);
+}
+
+struct ReferenceWeight {
+    int dx;
+    int dy;
+    int weight;
+};
+
+QImage referenceDither(QImage const& original, Ez::DitherMethod method) {
+    // A plain sequential error diffusion with the integer arithmetic of Ez::dither.
+    QVector<ReferenceWeight> weights{};
+    int divisor{0};
+    switch(method) {
+    case Ez::DitherMethod::FloydSteinberg:
+    case Ez::DitherMethod::FloydSteinbergSerpentine:
+        weights = {{1, 0, 7}, {-1, 1, 3}, {0, 1, 5}, {1, 1, 1}};
+        divisor = 16;
+        break;
+    case Ez::DitherMethod::Atkinson:
+        weights = {{1, 0, 1}, {2, 0, 1}, {-1, 1, 1}, {0, 1, 1}, {1, 1, 1}, {0, 2, 1}};
+        divisor = 8;
+        break;
+    case Ez::DitherMethod::JarvisJudiceNinke:
+        weights = {{1, 0, 7}, {2, 0, 5}, {-2, 1, 3}, {-1, 1, 5}, {0, 1, 7}, {1, 1, 5}, {2, 1, 3},
+                   {-2, 2, 1}, {-1, 2, 3}, {0, 2, 5}, {1, 2, 3}, {2, 2, 1}};
+        divisor = 48;
+        break;
+    case Ez::DitherMethod::Stucki:
+        weights = {{1, 0, 8}, {2, 0, 4}, {-2, 1, 2}, {-1, 1, 4}, {0, 1, 8}, {1, 1, 4}, {2, 1, 2},
+                   {-2, 2, 1}, {-1, 2, 2}, {0, 2, 4}, {1, 2, 2}, {2, 2, 1}};
+        divisor = 42;
+        break;
+    default:
+        return QImage{};
+    }
+
+    auto source = original.convertToFormat(QImage::Format_ARGB32);
+    auto width = source.width();
+    auto height = source.height();
+    QImage image{source.size(), QImage::Format_Mono};
+    image.setColorTable({qRgb(255, 255, 255), qRgb(0, 0, 0)});
+    image.fill(0);
+
+    std::vector<std::vector<int>> errors(height + 2, std::vector<int>(width + 4, 0));
+    auto serpentine = method == Ez::DitherMethod::FloydSteinbergSerpentine;
+    for(int y{0}; y < height; ++y) {
+        auto direction = serpentine && y % 2 == 1 ? -1 : 1;
+        for(int i{0}; i < width; ++i) {
+            auto x = direction > 0 ? i : width - 1 - i;
+            auto pixel = source.pixel(x, y);
+            auto gray = (qGray(pixel) * qAlpha(pixel) + 255 * (255 - qAlpha(pixel))) / 255;
+            auto value = gray + errors[y][x + 2] / divisor;
+            auto black = value < 128;
+            image.setPixel(x, y, black ? 1 : 0);
+
+            auto error = value - (black ? 0 : 255);
+            for(auto const& weight : weights) {
+                errors[y + weight.dy][x + direction * weight.dx + 2] += error * weight.weight;
+            }
+        }
+    }
+    return image;
+}
+
+}
+
+void PipelineBenchmark::initTestCase() {
+    _corpus << Source{"small", QSize{800, 600}}
+            << Source{"12mp", QSize{4000, 3000}}
+            << Source{"50mp", QSize{8192, 6144}};
+
+    for(auto const& source : _corpus) {
+        auto image = createSource(source.size);
+        QByteArray bytes{};
+        QBuffer buffer{&bytes};
+        QVERIFY(image.save(&buffer, "PNG"));
+
+        _encoded.insert(source.name, bytes);
+        _decoded.insert(source.name, image);
+        _composed.insert(source.name, ::compose(image));
+    }
+}
+
+void PipelineBenchmark::decode_data() {
+    _addCorpusRows();
+}
+
+void PipelineBenchmark::decode() {
+    QFETCH(QString, source);
+    auto bytes = _encoded[source];
+
+    QImage image{};
+    QBENCHMARK {
+        image = QImage::fromData(bytes, "PNG");
+    }
+    QCOMPARE(image, _decoded[source]);
+}
+
+void PipelineBenchmark::mirror_data() {
+    _addCorpusRows();
+}
+
+void PipelineBenchmark::mirror() {
+    QFETCH(QString, source);
+    auto image = _decoded[source];
+
+    QImage mirrored{};
+    QBENCHMARK {
+        mirrored = image.mirrored(true, false);
+    }
+    QVERIFY(!mirrored.isNull());
+}
+
+void PipelineBenchmark::rotate_data() {
+    _addCorpusRows();
+}
+
+void PipelineBenchmark::rotate() {
+    QFETCH(QString, source);
+    auto image = _decoded[source];
+    QTransform rotation{};
+    rotation.rotate(30);
+
+    QImage rotated{};
+    QBENCHMARK {
+        rotated = image.transformed(rotation);
+    }
+    QVERIFY(!rotated.isNull());
+}
+
+void PipelineBenchmark::scale_data() {
+    _addCorpusRows();
+}
+
+void PipelineBenchmark::scale() {
+    QFETCH(QString, source);
+    auto image = _decoded[source];
+
+    QImage scaled{};
+    QBENCHMARK {
+        scaled = image.scaled(Ez::Specifications::ImageWidth, Ez::Specifications::ImageHeight);
+    }
+    QVERIFY(!scaled.isNull());
+}
+
+void PipelineBenchmark::compose_data() {
+    _addCorpusRows();
+}
+
+void PipelineBenchmark::compose() {
+    QFETCH(QString, source);
+    auto image = _decoded[source];
+
+    QImage composed{};
+    QBENCHMARK {
+        composed = ::compose(image);
+    }
+    QVERIFY(!composed.isNull());
+}
+
+void PipelineBenchmark::dither_data() {
+    QTest::addColumn<QString>("source");
+    QTest::addColumn<QString>("mode");
+    QTest::addColumn<int>("flags");
+
+    QList<QPair<QString, int>> modes{
+        qMakePair(QString{"DiffuseDither"}, static_cast<int>(Qt::DiffuseDither)),
+        qMakePair(QString{"OrderedDither"}, static_cast<int>(Qt::OrderedDither)),
+        qMakePair(QString{"ThresholdDither"}, static_cast<int>(Qt::ThresholdDither))
+    };
+    for(auto const& source : _corpus) {
+        for(auto const& mode : modes) {
+            QTest::newRow(qPrintable(source.name + "/" + mode.first)) << source.name << mode.first << mode.second;
+        }
+    }
+}
+
+void PipelineBenchmark::dither() {
+    QFETCH(QString, source);
+    QFETCH(QString, mode);
+    QFETCH(int, flags);
+    auto image = _composed[source];
+
+    QImage dithered{};
+    QBENCHMARK {
+        dithered = image.convertToFormat(QImage::Format_Mono, static_cast<Qt::ImageConversionFlags>(flags));
+    }
+    QCOMPARE(dithered.format(), QImage::Format_Mono);
+}
+
+void PipelineBenchmark::ditherEngine_data() {
+    QTest::addColumn<QString>("source");
+    QTest::addColumn<int>("method");
+    QTest::addColumn<bool>("singleThread");
+
+    for(auto const& source : _corpus) {
+        for(auto method : Ez::ditherMethods()) {
+            if(method == Ez::DitherMethod::ConversionFlags) {
+                continue;
+            }
+            auto name = source.name + "/" + Ez::ditherMethodName(method);
+            QTest::newRow(qPrintable(name)) << source.name << static_cast<int>(method) << false;
+            QTest::newRow(qPrintable(name + "/single-thread")) << source.name << static_cast<int>(method) << true;
+        }
+    }
+}
+
+void PipelineBenchmark::ditherEngine() {
+    QFETCH(QString, source);
+    QFETCH(int, method);
+    QFETCH(bool, singleThread);
+    auto image = _composed[source];
+    auto ditherMethod = static_cast<Ez::DitherMethod>(method);
+
+    QImage dithered{};
+    QBENCHMARK {
+        dithered = Ez::dither(image, ditherMethod, singleThread ? 1 : 0);
+    }
+
+    // The wavefront has to produce the bitmap of the sequential reference regardless of the number of threads.
+    if(ditherMethod == Ez::DitherMethod::BlueNoise) {
+        if(!singleThread) {
+            QCOMPARE(digest(dithered), digest(Ez::dither(image, ditherMethod, 1)));
+        }
+    } else {
+        QCOMPARE(digest(dithered), digest(referenceDither(image, ditherMethod)));
+    }
+}
+
+void PipelineBenchmark::layers_data() {
+    QTest::addColumn<QString>("source");
+    QTest::addColumn<int>("layerCount");
+    QTest::addColumn<int>("layer");
+    QTest::addColumn<bool>("singlePass");
+    QTest::addColumn<bool>("composed");
+
+    for(auto const& source : _corpus) {
+        for(auto layerCount : {3, 8}) {
+            for(auto layer : {0, 1, layerCount}) {
+                QTest::newRow(qPrintable(QString{"%1/%2/%3"}.arg(source.name).arg(layerCount).arg(layer)))
+                        << source.name << layerCount << layer << false << true;
+                QTest::newRow(qPrintable(QString{"%1/%2/%3/single-pass"}.arg(source.name).arg(layerCount).arg(layer)))
+                        << source.name << layerCount << layer << true << true;
+            }
+        }
+    }
+
+    // The colored and partly transparent source as it is, the colors are matched against the gray levels.
+    QTest::newRow("small/3/1/single-pass/colored") << QString{"small"} << 3 << 1 << true << false;
+    QTest::newRow("small/8/0/single-pass/colored") << QString{"small"} << 8 << 0 << true << false;
+}
+
+void PipelineBenchmark::layers() {
+    QFETCH(QString, source);
+    QFETCH(int, layerCount);
+    QFETCH(int, layer);
+    QFETCH(bool, singlePass);
+    QFETCH(bool, composed);
+    auto image = composed ? _composed[source] : _decoded[source];
+
+    // The single pass quantizer extracts all layers at once and has to match the legacy extraction.
+    QImage split{};
+    if(singlePass) {
+        QBENCHMARK {
+            auto layers = Ez::quantizeLayers(image, layerCount, Qt::DiffuseDither);
+            split = layer == 0 ? layers.levels : layers.layers[layer - 1];
+        }
+    } else {
+        QBENCHMARK {
+            split = createLayer(image, layerCount, layer, Qt::DiffuseDither);
+        }
+    }
+    if(singlePass) {
+        QCOMPARE(digest(split), digest(createLayer(image, layerCount, layer, Qt::DiffuseDither)));
+    }
+}
+
+void PipelineBenchmark::pack_data() {
+    QTest::addColumn<QString>("source");
+    QTest::addColumn<int>("protocol");
+    QTest::addColumn<bool>("legacy");
+    QTest::addColumn<QString>("input");
+
+    for(auto const& source : _corpus) {
+        for(int protocol{1}; protocol <= 4; ++protocol) {
+            QTest::newRow(qPrintable(QString{"%1/v%2"}.arg(source.name).arg(protocol))) << source.name << protocol << false << QString{"mono"};
+            QTest::newRow(qPrintable(QString{"%1/v%2/legacy"}.arg(source.name).arg(protocol))) << source.name << protocol << true << QString{"mono"};
+        }
+    }
+
+    // Bit reversed, dithered while packing and scaled while packing inputs.
+    for(auto const& input : {QString{"mono-lsb"}, QString{"composed"}, QString{"decoded"}}) {
+        for(auto protocol : {1, 3}) {
+            QTest::newRow(qPrintable(QString{"small/v%1/%2"}.arg(protocol).arg(input))) << QString{"small"} << protocol << false << input;
+        }
+    }
+}
+
+void PipelineBenchmark::pack() {
+    QFETCH(QString, source);
+    QFETCH(int, protocol);
+    QFETCH(bool, legacy);
+    QFETCH(QString, input);
+    auto image = _composed[source].convertToFormat(QImage::Format_Mono, Qt::DiffuseDither);
+    if(input == "mono-lsb") {
+        image = image.convertToFormat(QImage::Format_MonoLSB);
+    } else if(input == "composed") {
+        image = _composed[source];
+    } else if(input == "decoded") {
+        image = _decoded[source];
+    }
+    auto format = protocol < 3 ? Ez::PayloadFormat::Bitmap : Ez::PayloadFormat::Raw;
+
+    QByteArray payload{};
+    if(legacy) {
+        QBENCHMARK {
+            payload = legacyPayload(image, format);
+        }
+    } else {
+        QBENCHMARK {
+            payload = Ez::packImage(image, format);
+        }
+    }
+
+    // Both implementations have to produce the same payload.
+    QCOMPARE(payload.size(), Ez::payloadSize(format));
+    if(!legacy) {
+        QCOMPARE(digest(payload), digest(legacyPayload(image, format)));
+
+        // Nothing is sent for images the encoder could not have written either.
+        QVERIFY(Ez::packImage(QImage{}, format).isEmpty());
+    }
+}
+
+void PipelineBenchmark::_addCorpusRows() {
+    QTest::addColumn<QString>("source");
+    for(auto const& source : _corpus) {
+        QTest::newRow(qPrintable(source.name)) << source.name;
+    }
+}
+
+QTEST_GUILESS_MAIN(PipelineBenchmark)
+
+#include "pipelinebenchmark.moc"
@@ -2,6 +2,7 @@ include(../common.pri)
 
 QT += core
 QT += serialport
+QT += concurrent
 
 TARGET = EzGraverCli
 CONFIG += console
@@ -9,7 +10,10 @@ CONFIG -= app_bundle
 
 TEMPLATE = app
 
-SOURCES += main.cpp
+SOURCES += main.cpp \
+    batchrunner.cpp
+
+HEADERS += batchrunner.h
 
 win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../EzGraverCore/release/ -lEzGraverCore
 else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../EzGraverCore/debug/ -lEzGraverCore
@@ -0,0 +1,197 @@
+#include "batchrunner.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "serialworker.h"
+
+BatchRunner::BatchRunner(std::shared_ptr<Ez::EzGraver> engraver, BatchManifest const& manifest, QObject* parent)
+        : QObject{parent}, _engraver{engraver}, _manifest{manifest}, _layerJob{engraver} {
+    connect(&_conversion, &QFutureWatcherBase::finished, this, &BatchRunner::_conversionFinished);
+
+    connect(&_layerJob, &Ez::LayerJob::layerStarted, this, [this](int layer, int pixels) {
+        std::cout << "job " << _current << ": engraving layer " << layer << " (" << pixels << " pixels, burn time "
+                  << static_cast<int>(_layerJob.layers()[layer].burnTime) << ")\n";
+        _reportedProgress = 0;
+    });
+    connect(&_layerJob, &Ez::LayerJob::layerProgressed, this, [this](int layer, int engraved, int pixels) {
+        // The remaining time is reported every tenth of a layer.
+        auto progress = engraved * 10 / std::max(pixels, 1);
+        if(progress > _reportedProgress && progress < 10) {
+            _reportedProgress = progress;
+            std::cout << "job " << _current << ": layer " << layer << " " << progress * 10 << "% engraved, "
+                      << (_layerJob.remainingTime() + 500) / 1000 << " s remaining\n";
+        }
+    });
+    connect(&_layerJob, &Ez::LayerJob::layerFinished, this, [this](Ez::LayerTiming const& timing) {
+        if(timing.skipped) {
+            std::cout << "job " << _current << ": layer " << timing.layer << " skipped as it is blank\n";
+            return;
+        }
+        std::cout << "job " << _current << ": layer " << timing.layer << " erase " << timing.erase << " ms, upload "
+                  << timing.upload << " ms, engrave " << timing.engrave << " ms (planned " << timing.planned << " ms)"
+                  << (timing.incomplete ? " (incomplete)" : "") << '\n';
+    });
+    connect(&_layerJob, &Ez::LayerJob::finished, this, &BatchRunner::_layersFinished);
+    connect(&_layerJob, &Ez::LayerJob::failed, this, [this](QString const& reason) {
+        std::cout << "job " << _current << ": " << reason.toStdString() << '\n';
+        _jobFinished(true);
+    });
+
+    connect(_engraver.get(), &Ez::EzGraver::frameDecoded, &_layerJob, &Ez::LayerJob::processFrame);
+
+    // The operator confirms having repositioned the workpiece, unless a jig is moved in a fixed time.
+    connect(&_reposition, &QFutureWatcherBase::finished, this, [this] { _runTile(_tile + 1); });
+    _jigTimer.setSingleShot(true);
+    connect(&_jigTimer, &QTimer::timeout, this, [this] { _runTile(_tile + 1); });
+}
+
+BatchManifest BatchRunner::loadManifest(QString const& fileName) {
+    QFile file{fileName};
+    if(!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error{QString{"unable to read manifest '%1'"}.arg(fileName).toStdString()};
+    }
+
+    QJsonParseError error{};
+    auto document = QJsonDocument::fromJson(file.readAll(), &error);
+    if(error.error != QJsonParseError::NoError || !document.isObject()) {
+        throw std::runtime_error{QString{"malformed manifest: %1"}.arg(error.errorString()).toStdString()};
+    }
+
+    auto const root = document.object();
+    BatchManifest manifest{};
+    manifest.protocol = root["protocol"].toInt(manifest.protocol);
+
+    auto directory = QFileInfo{fileName}.absoluteDir();
+    for(auto const& job : root["jobs"].toArray()) {
+        manifest.jobs.append(Ez::parseJob(job.toObject(), directory));
+    }
+    return manifest;
+}
+
+void BatchRunner::start() {
+    _current = -1;
+    _converting = -1;
+    _failedJobs = 0;
+    _idleClock.start();
+    _convertNext();
+    if(_converting >= _manifest.jobs.size()) {
+        emit finished(_failedJobs);
+    }
+}
+
+Ez::ConvertedJob BatchRunner::_convertPacked(Ez::BatchJob const& job, Ez::PayloadFormat format) {
+    auto converted = Ez::convertJob(job);
+    Ez::packJob(converted, format);
+    return converted;
+}
+
+void BatchRunner::_convertNext() {
+    _converted = false;
+    if(++_converting < _manifest.jobs.size()) {
+        _conversion.setFuture(QtConcurrent::run(&BatchRunner::_convertPacked, _manifest.jobs[_converting], _engraver->payloadFormat()));
+    }
+}
+
+void BatchRunner::_conversionFinished() {
+    _converted = true;
+    if(!_engraving) {
+        _runConverted();
+    }
+}
+
+void BatchRunner::_runConverted() {
+    auto converted = _conversion.result();
+    _current = _converting;
+    std::cout << "job " << _current << ": " << _manifest.jobs[_current].image.toStdString() << '\n';
+    std::cout << "job " << _current << ": converted in " << converted.duration << " ms, device waited "
+              << _idleClock.elapsed() << " ms\n";
+
+    // The next job is converted while the current one is busy on the device.
+    _convertNext();
+    if(!converted.error.isEmpty()) {
+        std::cout << "job " << _current << ": " << converted.error.toStdString() << '\n';
+        _jobFinished(true);
+        return;
+    }
+
+    _engraving = true;
+    _jobClock.start();
+    if(!converted.tiles.isEmpty()) {
+        auto const& last = converted.tiles.last().tile;
+        std::cout << "job " << _current << ": " << converted.tiles.size() << " tiles in " << last.row + 1 << " rows of "
+                  << last.column + 1 << '\n';
+        _tiles = converted.tiles;
+        _jobPlanned = 0;
+        _runTile(0);
+        return;
+    }
+
+    _layerJob.setLayers(converted.layers);
+    _jobPlanned = _layerJob.predictedTime();
+    std::cout << "job " << _current << ": expected to take " << (_jobPlanned + 500) / 1000 << " s plus uploads\n";
+    _layerJob.start();
+}
+
+void BatchRunner::_runTile(int tile) {
+    _tile = tile;
+    auto const& area = _tiles[tile].tile.area;
+    _layerJob.setLayers(_tiles[tile].layers);
+    auto planned = _layerJob.predictedTime();
+    _jobPlanned += planned;
+    std::cout << "job " << _current << ": tile " << tile << " covering " << area.x() << "," << area.y() << " to "
+              << area.right() << "," << area.bottom() << " expected to take " << (planned + 500) / 1000 << " s plus uploads\n";
+    _layerJob.start();
+}
+
+void BatchRunner::_layersFinished() {
+    if(_tiles.isEmpty() || _tile + 1 >= _tiles.size()) {
+        _jobFinished(false);
+        return;
+    }
+
+    // The head stays where it is, the workpiece moves opposite to the next tile.
+    auto const& area = _tiles[_tile].tile.area;
+    auto const& next = _tiles[_tile + 1].tile.area;
+    std::cout << "job " << _current << ": move the workpiece by " << area.x() - next.x() << " px horizontally and "
+              << area.y() - next.y() << " px vertically for tile " << _tile + 1 << '\n';
+
+    auto jigDelay = _manifest.jobs[_current].jigDelay;
+    if(jigDelay >= 0) {
+        _jigTimer.start(jigDelay);
+    } else {
+        std::cout << "job " << _current << ": press enter once the workpiece has been repositioned" << std::endl;
+        _reposition.setFuture(QtConcurrent::run([] {
+            std::string line{};
+            std::getline(std::cin, line);
+        }));
+    }
+}
+
+void BatchRunner::_jobFinished(bool failed) {
+    if(_engraving) {
+        std::cout << "job " << _current << ": " << (failed ? "failed" : "done") << " after " << _jobClock.elapsed() << " ms (planned "
+                  << _jobPlanned << " ms)\n";
+    }
+    _engraving = false;
+    _tiles.clear();
+    _tile = -1;
+    _failedJobs += failed ? 1 : 0;
+    _idleClock.restart();
+
+    if(_converted) {
+        _runConverted();
+    } else if(_converting >= _manifest.jobs.size()) {
+        emit finished(_failedJobs);
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef EZGRAVER_BATCHRUNNER_H
+#define EZGRAVER_BATCHRUNNER_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QList>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QTimer>
+
+#include <memory>
+
+#include "ezgraver.h"
+#include "factory.h"
+#include "layerjob.h"
+#include "batchjob.h"
+
+/*!
+ * The parsed batch manifest.
+ */
+struct BatchManifest {
+    int protocol{Ez::AutoDetect};
+    QVector<Ez::BatchJob> jobs{};
+};
+
+/*!
+ * Engraves the jobs of a manifest over a single connection. The next job is converted and
+ * packed on a worker thread while the current one is being erased, uploaded and engraved, thus the
+ * device does not wait on the host as long as a conversion is faster than a job.
+ *
+ * The tiles of a tiled job are converted and packed in parallel before the first one is
+ * engraved. They are engraved one after another, the operator repositions the workpiece in
+ * between.
+ */
+class BatchRunner : public QObject {
+    Q_OBJECT
+
+public:
+    /*!
+     * Creates a new runner driving the given \a engraver.
+     *
+     * \param engraver The engraver to use.
+     * \param manifest The jobs to engrave.
+     * \param parent The parent of the runner.
+     */
+    explicit BatchRunner(std::shared_ptr<Ez::EzGraver> engraver, BatchManifest const& manifest, QObject* parent=NULL);
+
+    /*!
+     * Reads a batch manifest. Relative image paths are resolved against the directory of
+     * the manifest.
+     *
+     * \param fileName The manifest to read.
+     * \return The parsed manifest.
+     * \throws std::runtime_error Thrown if the manifest cannot be read or is malformed.
+     */
+    static BatchManifest loadManifest(QString const& fileName);
+
+public slots:
+    /*!
+     * Starts converting and engraving the jobs.
+     */
+    void start();
+
+signals:
+    /*!
+     * Fired as soon as all jobs are done.
+     *
+     * \param failedJobs The number of jobs which could not be engraved.
+     */
+    void finished(int failedJobs);
+
+private:
+    std::shared_ptr<Ez::EzGraver> _engraver;
+    BatchManifest _manifest;
+    Ez::LayerJob _layerJob;
+    QFutureWatcher<Ez::ConvertedJob> _conversion{};
+
+    int _converting{-1};
+    int _current{-1};
+    bool _converted{false};
+    bool _engraving{false};
+    int _failedJobs{0};
+    qint64 _jobPlanned{0};
+    int _reportedProgress{0};
+    QElapsedTimer _jobClock{};
+    QElapsedTimer _idleClock{};
+
+    QVector<Ez::ConvertedTile> _tiles{};
+    int _tile{-1};
+    QFutureWatcher<void> _reposition{};
+    QTimer _jigTimer{};
+
+    static Ez::ConvertedJob _convertPacked(Ez::BatchJob const& job, Ez::PayloadFormat format);
+    void _convertNext();
+    void _conversionFinished();
+    void _runConverted();
+    void _runTile(int tile);
+    void _layersFinished();
+    void _jobFinished(bool failed);
+};
+
+#endif // EZGRAVER_BATCHRUNNER_H
@@ -1,15 +1,31 @@
 #include <QCoreApplication>
-#include <QThread>
+#include <QEventLoop>
+#include <QTimer>
+#include <QHash>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
 
 #include <iterator>
 #include <algorithm>
 #include <iostream>
 #include <memory>
 #include <exception>
+#include <stdexcept>
+#include <vector>
 
 #include "ezgraver.h"
 #include "factory.h"
 #include "specifications.h"
+#include "wiretrace.h"
+#include "farm.h"
+#include "imagepipeline.h"
+#include "imagepacker.h"
+#include "payloadcache.h"
+#include "eraseoperation.h"
+#include "layerjob.h"
+#include "serialworker.h"
+#include "batchrunner.h"
 
 std::ostream& operator<<(std::ostream& lhv, QString const& rhv) {
     return lhv << rhv.toStdString();
@@ -21,10 +37,13 @@ void showHelp() {
     std::cout << "  v - Prints the version information\n";
     std::cout << "  a - Shows the available ports\n";
     std::cout << "  h <port> - Moves the engraver to the home position\n";
-    std::cout << "  s <port> - Starts the engraving process with the burn time 60\n";
+    std::cout << "  s <port> [burn time] - Starts the engraving process, the burn time defaults to 60\n";
     std::cout << "  p <port> - Pauses the engraver\n";
     std::cout << "  r <port> - Resets the engraver\n";
     std::cout << "  u <port> <image> - Uploads the given image to the engraver\n";
+    std::cout << "  b <port> <manifest> - Engraves all jobs of the given manifest\n";
+    std::cout << "  f <port>[,<port>...] <manifest> - Engraves all jobs of the given manifest on several engravers\n";
+    std::cout << "  e <port> [runs] - Calibrates the erase wait by engraving a test pattern into scrap material, 12 runs by default\n";
 }
 
 void showAvailablePorts() {
@@ -42,19 +61,259 @@ void uploadImage(std::shared_ptr<Ez::EzGraver>& engraver, QList<QString> const&
     }
 
     auto fileName = arguments[1];
-    QImage image{};
-    if(!image.load(fileName)) {
+    QFile file{fileName};
+    if(!file.open(QIODevice::ReadOnly)) {
         std::cout << "Error while loading image '" << fileName << "'\n";
         return;
     }
+    auto source = file.readAll();
+
+    // Images are converted using the default settings, thus only the source and the format make up the key.
+    Ez::ImagePipeline pipeline{};
+    Ez::PayloadCache cache{};
+    auto key = Ez::PayloadCache::key(Ez::PayloadCache::sourceDigest(source), pipeline.settings(), engraver->payloadFormat());
+    auto payload = cache.find(key);
+    if(payload.isNull()) {
+        QImage image{};
+        if(!image.loadFromData(source)) {
+            std::cout << "Error while loading image '" << fileName << "'\n";
+            return;
+        }
+        pipeline.setSource(image);
+        payload.data = Ez::packImage(pipeline.result(), engraver->payloadFormat());
+        if(payload.data.isEmpty()) {
+            std::cout << "Error while converting image '" << fileName << "'\n";
+            return;
+        }
+        cache.insert(key, payload.data);
+    } else {
+        std::cout << "using cached payload\n";
+    }
 
     std::cout << "erasing EEPROM\n";
-    auto waitTimeMs = engraver->erase();
-    engraver->awaitTransmission();
-    QThread::msleep(waitTimeMs);
+    Ez::EraseOperation erase{engraver};
+    QEventLoop loop{};
+    auto erased = false;
+    QObject::connect(&erase, &Ez::EraseOperation::erased, &loop, [&loop, &erased](qint64 elapsed) {
+        std::cout << "EEPROM erased after " << elapsed << " ms\n";
+        erased = true;
+        loop.quit();
+    });
+    QObject::connect(&erase, &Ez::EraseOperation::failed, &loop, [&loop](QString const& reason) {
+        std::cout << "Error: " << reason << '\n';
+        loop.quit();
+    });
+    QObject::connect(engraver.get(), &Ez::EzGraver::frameDecoded, &erase, &Ez::EraseOperation::processFrame);
+    erase.start();
+    loop.exec();
+    if(!erased) {
+        return;
+    }
 
     std::cout << "uploading image to EEPROM\n";
-    engraver->uploadImage(image);
+    engraver->uploadImage(payload.data);
+    engraver->awaitTransmission();
+}
+
+unsigned char burnTime(QList<QString> const& arguments) {
+    if(arguments.size() < 2) {
+        return 60;
+    }
+
+    bool valid{false};
+    auto burnTime = arguments[1].toInt(&valid);
+    if(!valid || burnTime < 0x01 || burnTime > 0xF0) {
+        throw std::invalid_argument{QString{"invalid burn time '%1'"}.arg(arguments[1]).toStdString()};
+    }
+    return static_cast<unsigned char>(burnTime);
+}
+
+void runBatch(QList<QString> const& arguments) {
+    if(arguments.size() < 2) {
+        std::cout << "No manifest provided\n";
+        return;
+    }
+
+    try {
+        auto manifest = BatchRunner::loadManifest(arguments[1]);
+        if(manifest.protocol != Ez::AutoDetect) {
+            Ez::forgetProtocol(Ez::deviceId(arguments[0]));
+        }
+        auto engraver = Ez::create(arguments[0], manifest.protocol);
+
+        BatchRunner runner{engraver, manifest};
+        QEventLoop loop{};
+        QObject::connect(&runner, &BatchRunner::finished, &loop, [&loop, &manifest](int failedJobs) {
+            std::cout << "batch done, " << (manifest.jobs.size() - failedJobs) << " of " << manifest.jobs.size() << " jobs engraved\n";
+            loop.quit();
+        });
+        QTimer::singleShot(0, &runner, &BatchRunner::start);
+        loop.exec();
+
+        engraver->awaitTransmission();
+    } catch(std::exception const& e) {
+        std::cout << "Error: " << e.what() << '\n';
+    }
+}
+
+void runFarm(QList<QString> const& arguments) {
+    if(arguments.size() < 2) {
+        std::cout << "No manifest provided\n";
+        return;
+    }
+
+    try {
+        auto manifest = BatchRunner::loadManifest(arguments[1]);
+        Ez::Farm farm{};
+        auto ports = arguments[0].split(',', QString::SkipEmptyParts);
+        auto detected = manifest.protocol == Ez::AutoDetect ? Ez::detectProtocols(ports) : QHash<QString, int>{};
+        for(auto const& port : ports) {
+            if(manifest.protocol != Ez::AutoDetect) {
+                Ez::forgetProtocol(Ez::deviceId(port));
+            }
+            // Devices not detected use the guessed or the default protocol.
+            auto guessed = manifest.protocol == Ez::AutoDetect && detected.value(port, Ez::AutoDetect) == Ez::AutoDetect;
+            auto engraver = Ez::create(port, guessed ? Ez::AutoDetect : detected.value(port, manifest.protocol));
+            std::cout << "engraver " << farm.addEngraver(engraver, port) << ": " << port << " (protocol v" << engraver->protocol()
+                      << (guessed ? ", guessed" : "") << ")\n";
+        }
+
+        int pending{0};
+        for(auto const& job : manifest.jobs) {
+            if(job.tiled) {
+                throw std::invalid_argument{"tiled jobs need an operator and are only supported by the batch mode"};
+            }
+            for(auto engraver : job.engravers) {
+                if(engraver < 0 || engraver >= farm.engraverCount()) {
+                    throw std::invalid_argument{QString{"unknown engraver '%1'"}.arg(engraver).toStdString()};
+                }
+            }
+            pending += job.engravers.isEmpty() ? 1 : job.engravers.size();
+        }
+        auto total = pending;
+        int failed{0};
+
+        QEventLoop loop{};
+        auto done = [&loop, &pending, &failed](int count, bool jobFailed) {
+            failed += jobFailed ? count : 0;
+            pending -= count;
+            if(pending == 0) {
+                loop.quit();
+            }
+        };
+
+        QHash<int, int> manifestIndex{};
+        QObject::connect(&farm, &Ez::Farm::jobStarted, [&farm, &manifestIndex](int job, int engraver) {
+            std::cout << "job " << manifestIndex[job] << ": started on " << farm.engraverName(engraver) << '\n';
+        });
+        QObject::connect(&farm, &Ez::Farm::layerFinished, [&farm, &manifestIndex](int job, int engraver, Ez::LayerTiming const& timing) {
+            if(timing.skipped) {
+                return;
+            }
+            std::cout << "job " << manifestIndex[job] << ": layer " << timing.layer << " on " << farm.engraverName(engraver)
+                      << " erase " << timing.erase << " ms, upload " << timing.upload << " ms, engrave " << timing.engrave << " ms (planned "
+                      << timing.planned << " ms)\n";
+        });
+        QObject::connect(&farm, &Ez::Farm::jobFinished, [&farm, &manifestIndex, &done](int job, int engraver, bool jobFailed) {
+            std::cout << "job " << manifestIndex[job] << ": " << (jobFailed ? "failed" : "done") << " on " << farm.engraverName(engraver) << '\n';
+            done(1, jobFailed);
+        });
+
+        // Jobs are converted in the background and queued as soon as they are ready.
+        std::vector<std::unique_ptr<QFutureWatcher<Ez::ConvertedJob>>> conversions{};
+        for(int i{0}; i < manifest.jobs.size(); ++i) {
+            std::unique_ptr<QFutureWatcher<Ez::ConvertedJob>> conversion{new QFutureWatcher<Ez::ConvertedJob>{}};
+            auto watcher = conversion.get();
+            QObject::connect(watcher, &QFutureWatcherBase::finished, [&farm, &manifest, &manifestIndex, &done, watcher, i] {
+                auto converted = watcher->result();
+                auto const& job = manifest.jobs[i];
+                if(!converted.error.isEmpty()) {
+                    std::cout << "job " << i << ": " << converted.error << '\n';
+                    done(job.engravers.isEmpty() ? 1 : job.engravers.size(), true);
+                    return;
+                }
+
+                // The job may start right away, thus its identifier is mapped before submitting it.
+                std::cout << "job " << i << ": converted in " << converted.duration << " ms\n";
+                manifestIndex.insert(manifestIndex.size(), i);
+                farm.submit(converted.layers, job.engravers);
+            });
+            watcher->setFuture(QtConcurrent::run(&Ez::convertJob, manifest.jobs[i]));
+            conversions.push_back(std::move(conversion));
+        }
+        if(pending > 0) {
+            loop.exec();
+        }
+
+        auto statistics = farm.statistics();
+        std::cout << "farm done, " << (total - failed) << " of " << total << " jobs engraved on " << statistics.engravers
+                  << " engravers in " << statistics.elapsed << " ms\n";
+        std::cout << "  " << statistics.uploadedBytes << " bytes uploaded, " << statistics.engravedPixels << " pixels engraved, "
+                  << statistics.stolenJobs << " jobs stolen, " << statistics.packedPayloads << " payloads packed\n";
+    } catch(std::exception const& e) {
+        std::cout << "Error: " << e.what() << '\n';
+    }
+}
+
+void calibrateErase(QList<QString> const& arguments) {
+    auto runs = 12;
+    if(arguments.size() > 1) {
+        bool valid{false};
+        runs = arguments[1].toInt(&valid);
+        if(!valid || runs < 1) {
+            std::cout << "Error: invalid number of runs '" << arguments[1] << "'\n";
+            return;
+        }
+    }
+
+    try {
+        auto engraver = Ez::create(arguments[0]);
+
+        // The pattern covers the leading bytes of the upload, the ones lost if the wait is too short.
+        QImage pattern{Ez::Specifications::ImageWidth, Ez::Specifications::ImageHeight, QImage::Format_Mono};
+        pattern.setColorTable(QVector<QRgb>{qRgb(255, 255, 255), qRgb(0, 0, 0)});
+        pattern.fill(0);
+        for(int y{0}; y < 2; ++y) {
+            for(int x{0}; x < pattern.width(); x += 8) {
+                pattern.setPixel(x, y, 1);
+            }
+        }
+
+        // The shortest burn time barely marks the workpiece.
+        Ez::JobLayer layer{};
+        layer.image = pattern;
+        layer.burnTime = 1;
+
+        Ez::LayerJob job{engraver};
+        job.setCalibrating(true);
+        job.setIdleTimeout(3000);
+        job.setLayers(QVector<Ez::JobLayer>{layer});
+        QObject::connect(engraver.get(), &Ez::EzGraver::frameDecoded, &job, &Ez::LayerJob::processFrame);
+
+        QEventLoop loop{};
+        int run{0};
+        QObject::connect(&job, &Ez::LayerJob::layerFinished, [&run](Ez::LayerTiming const& timing) {
+            std::cout << "run " << run << ": erase wait " << timing.erase << " ms, "
+                      << (timing.incomplete ? "pixels lost" : "complete") << '\n';
+        });
+        QObject::connect(&job, &Ez::LayerJob::finished, &loop, [&loop, &job, &run, runs] {
+            if(++run < runs) {
+                job.start();
+            } else {
+                loop.quit();
+            }
+        });
+        QObject::connect(&job, &Ez::LayerJob::failed, &loop, [&loop](QString const& reason) {
+            std::cout << "Error: " << reason << '\n';
+            loop.quit();
+        });
+        QTimer::singleShot(0, &job, &Ez::LayerJob::start);
+        loop.exec();
+
+        engraver->awaitTransmission();
+    } catch(std::exception const& e) {
+        std::cout << "Error: " << e.what() << '\n';
+    }
 }
 
 void processCommand(char const& command, QList<QString> const& arguments) {
@@ -69,7 +328,7 @@ void processCommand(char const& command, QList<QString> const& arguments) {
             engraver->center();
             break;
         case 's':
-            engraver->start(60);
+            engraver->start(burnTime(arguments));
             break;
         case 'r':
             engraver->reset();
@@ -112,6 +371,19 @@ void handleArguments(QStringList const& arguments) {
         return;
     }
 
+    if(command == 'b') {
+        runBatch(arguments.mid(2));
+        return;
+    }
+    if(command == 'f') {
+        runFarm(arguments.mid(2));
+        return;
+    }
+    if(command == 'e') {
+        calibrateErase(arguments.mid(2));
+        return;
+    }
+
     processCommand(command, arguments.mid(2));
 }
 
@@ -121,4 +393,9 @@ int main(int argc, char* argv[]) {
     QStringList arguments{};
     std::copy(argv, argv+argc, std::back_inserter(arguments));
     handleArguments(arguments);
+
+    auto traceFile = qgetenv("EZ_TRACE_FILE");
+    if(!traceFile.isEmpty()) {
+        Ez::Trace::dump(QString::fromLocal8Bit(traceFile));
+    }
 }
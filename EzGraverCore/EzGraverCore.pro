@@ -2,6 +2,7 @@ include(../common.pri)
 
 QT += core
 QT += serialport
+QT += concurrent
 
 TARGET = EzGraverCore
 TEMPLATE = lib
@@ -9,20 +10,50 @@ TEMPLATE = lib
 DEFINES += EZGRAVERCORE_LIBRARY
 
 SOURCES += ezgraver.cpp \
-    ezgraver_v1.cpp \
-    ezgraver_v2.cpp \
     factory.cpp \
-    ezgraver_v3.cpp \
-    ezgraver_v4.cpp
+    ezgraver_v4.cpp \
+    imagepacker.cpp \
+    streamwriter.cpp \
+    wiretrace.cpp \
+    serialworker.cpp \
+    framedecoder.cpp \
+    imagepipeline.cpp \
+    grayscalelayers.cpp \
+    layerjob.cpp \
+    farm.cpp \
+    payloadcache.cpp \
+    baudnegotiator.cpp \
+    eraseoperation.cpp \
+    portwatcher.cpp \
+    dithering.cpp \
+    engravetimemodel.cpp \
+    protocolspec.cpp \
+    tiling.cpp \
+    batchjob.cpp
 
 HEADERS += ezgraver.h\
         ezgravercore_global.h \
-    ezgraver_v1.h \
-    ezgraver_v2.h \
     specifications.h \
     factory.h \
-    ezgraver_v3.h \
-    ezgraver_v4.h
+    ezgraver_v4.h \
+    imagepacker.h \
+    streamwriter.h \
+    wiretrace.h \
+    serialworker.h \
+    framedecoder.h \
+    imagepipeline.h \
+    grayscalelayers.h \
+    layerjob.h \
+    farm.h \
+    payloadcache.h \
+    baudnegotiator.h \
+    eraseoperation.h \
+    portwatcher.h \
+    dithering.h \
+    engravetimemodel.h \
+    protocolspec.h \
+    tiling.h \
+    batchjob.h
 
 unix {
     target.path = /usr/lib
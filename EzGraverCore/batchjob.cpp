@@ -0,0 +1,186 @@
+#include "batchjob.h"
+
+#include <QImage>
+#include <QJsonArray>
+#include <QElapsedTimer>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <functional>
+#include <stdexcept>
+
+#include "imagepipeline.h"
+#include "specifications.h"
+
+namespace Ez {
+
+namespace {
+
+unsigned char burnTime(QJsonObject const& object, QString const& key, unsigned char fallback) {
+    if(!object.contains(key)) {
+        return fallback;
+    }
+
+    auto value = object[key].toInt(-1);
+    if(value < 0x01 || value > 0xF0) {
+        throw std::runtime_error{QString{"burn time '%1' out of range"}.arg(value).toStdString()};
+    }
+    return static_cast<unsigned char>(value);
+}
+
+void parseDither(QString const& dither, BatchJob& job) {
+    if(dither == "diffuse") {
+        job.flags = Qt::DiffuseDither;
+    } else if(dither == "ordered") {
+        job.flags = Qt::OrderedDither;
+    } else if(dither == "threshold") {
+        job.flags = Qt::ThresholdDither;
+    } else {
+        // All other modes are run by the dithering engine.
+        try {
+            job.ditherMethod = ditherMethod(dither);
+        } catch(std::invalid_argument const&) {
+            throw std::runtime_error{QString{"unknown dither mode '%1'"}.arg(dither).toStdString()};
+        }
+    }
+}
+
+void parseTiles(QJsonObject const& tiles, BatchJob& job) {
+    job.tiled = true;
+    job.tileWidth = tiles["width"].toInt(job.tileWidth);
+    job.tileOverlap = tiles["overlap"].toInt(job.tileOverlap);
+    job.jigDelay = tiles["jigDelay"].toInt(job.jigDelay);
+
+    if(job.tileWidth < 0) {
+        throw std::runtime_error{QString{"invalid tiled artwork width '%1'"}.arg(job.tileWidth).toStdString()};
+    }
+    if(job.tileOverlap < 0 || job.tileOverlap * 2 >= Specifications::ImageWidth) {
+        throw std::runtime_error{QString{"unsupported tile overlap '%1'"}.arg(job.tileOverlap).toStdString()};
+    }
+    if(job.jigDelay < -1) {
+        throw std::runtime_error{QString{"invalid jig delay '%1'"}.arg(job.jigDelay).toStdString()};
+    }
+}
+
+QVector<JobLayer> convertImage(QImage const& image, BatchJob const& job) {
+    ImagePipeline pipeline{};
+    pipeline.setSource(image);
+    pipeline.setFlip(job.flipHorizontally, job.flipVertically);
+    pipeline.setKeepAspectRatio(job.keepAspectRatio);
+    pipeline.setTransformation(job.transformed, job.scale, job.rotation);
+    pipeline.setConversionFlags(job.flags);
+    pipeline.setDitherMethod(job.ditherMethod);
+
+    if(job.layers > 0) {
+        // The brightest layer is white and thus never engraved. All layers are quantized at once.
+        QVector<QImage> layers{};
+        for(int layer{1}; layer < job.layers; ++layer) {
+            pipeline.setLayers(true, job.layers, layer);
+            layers.append(pipeline.result());
+        }
+        return LayerJob::rampedLayers(layers, job.burnTime, job.lastBurnTime);
+    }
+
+    JobLayer layer{};
+    layer.image = pipeline.result();
+    layer.burnTime = job.burnTime;
+    return QVector<JobLayer>{layer};
+}
+
+void packLayers(QVector<JobLayer>& layers, PayloadFormat format) {
+    for(auto& layer : layers) {
+        if(LayerJob::engravedPixels(layer.image) > 0) {
+            layer.payload = packImage(layer.image, format);
+        }
+    }
+}
+
+QVector<ConvertedTile> convertTiles(QImage const& image, BatchJob const& job) {
+    // Flipping and scaling apply to the whole artwork, the tiles are cut out of it as they are.
+    auto artwork = image.mirrored(job.flipHorizontally, job.flipVertically);
+    if(job.tileWidth > 0 && job.tileWidth != artwork.width()) {
+        artwork = artwork.scaledToWidth(job.tileWidth, Qt::SmoothTransformation);
+    }
+
+    BatchJob tileJob{job};
+    tileJob.flipHorizontally = false;
+    tileJob.flipVertically = false;
+    tileJob.transformed = false;
+
+    std::function<ConvertedTile(Tile const&)> convertTile = [&artwork, &tileJob](Tile const& tile) {
+        ConvertedTile converted{};
+        converted.tile = tile;
+        converted.layers = convertImage(tileImage(artwork, tile), tileJob);
+        return converted;
+    };
+    return QtConcurrent::blockingMapped<QVector<ConvertedTile>>(tileGrid(artwork.size(), job.tileOverlap), convertTile);
+}
+
+}
+
+BatchJob parseJob(QJsonObject const& object, QDir const& directory) {
+    BatchJob job{};
+    auto image = object["image"].toString();
+    if(image.isEmpty()) {
+        throw std::runtime_error{"job without image"};
+    }
+    job.image = directory.absoluteFilePath(image);
+    job.burnTime = burnTime(object, "burnTime", job.burnTime);
+    job.lastBurnTime = burnTime(object, "lastBurnTime", job.burnTime);
+
+    job.layers = object["layers"].toInt(0);
+    if(job.layers != 0 && (job.layers < 2 || job.layers > 256)) {
+        throw std::runtime_error{QString{"unsupported number of layers '%1'"}.arg(job.layers).toStdString()};
+    }
+
+    job.flipHorizontally = object["flipHorizontally"].toBool(job.flipHorizontally);
+    job.flipVertically = object["flipVertically"].toBool(job.flipVertically);
+    job.keepAspectRatio = object["keepAspectRatio"].toBool(job.keepAspectRatio);
+    job.transformed = object.contains("scale") || object.contains("rotation");
+    job.scale = static_cast<float>(object["scale"].toDouble(job.scale));
+    job.rotation = object["rotation"].toInt(job.rotation);
+    parseDither(object["dither"].toString("diffuse"), job);
+    for(auto const& engraver : object["engravers"].toArray()) {
+        job.engravers.append(engraver.toInt());
+    }
+    if(object.contains("tiles")) {
+        parseTiles(object["tiles"].toObject(), job);
+    }
+    return job;
+}
+
+ConvertedJob convertJob(BatchJob const& job) {
+    QElapsedTimer clock{};
+    clock.start();
+
+    ConvertedJob converted{};
+    QImage image{};
+    if(!image.load(job.image)) {
+        converted.error = QString{"error while loading image '%1'"}.arg(job.image);
+        return converted;
+    }
+
+    try {
+        if(job.tiled) {
+            converted.tiles = convertTiles(image, job);
+        } else {
+            converted.layers = convertImage(image, job);
+        }
+    } catch(std::invalid_argument const& e) {
+        converted.error = QString::fromUtf8(e.what());
+    }
+
+    converted.duration = clock.elapsed();
+    return converted;
+}
+
+void packJob(ConvertedJob& converted, PayloadFormat format) {
+    packLayers(converted.layers, format);
+
+    // All tiles are packed in parallel, the next one is ready as soon as the workpiece has been repositioned.
+    std::function<void(ConvertedTile&)> pack = [format](ConvertedTile& tile) {
+        packLayers(tile.layers, format);
+    };
+    QtConcurrent::blockingMap(converted.tiles, pack);
+}
+
+}
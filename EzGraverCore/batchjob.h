@@ -0,0 +1,99 @@
+#ifndef EZGRAVER_BATCHJOB_H
+#define EZGRAVER_BATCHJOB_H
+
+#include "ezgravercore_global.h"
+
+#include <QString>
+#include <QVector>
+#include <QList>
+#include <QJsonObject>
+#include <QDir>
+
+#include "layerjob.h"
+#include "dithering.h"
+#include "tiling.h"
+#include "imagepacker.h"
+
+namespace Ez {
+
+/*!
+ * A single job as found in a batch manifest or submitted to the daemon.
+ */
+struct EZGRAVERCORESHARED_EXPORT BatchJob {
+    QString image{};
+    unsigned char burnTime{60};
+    unsigned char lastBurnTime{60};
+    int layers{0};
+    bool flipHorizontally{false};
+    bool flipVertically{false};
+    bool keepAspectRatio{true};
+    bool transformed{false};
+    float scale{1.0};
+    int rotation{0};
+    Qt::ImageConversionFlags flags{Qt::DiffuseDither};
+    DitherMethod ditherMethod{DitherMethod::ConversionFlags};
+    QList<int> engravers{};
+
+    /*! Whether the image is split into tiles the size of the work area instead of being fitted onto it. */
+    bool tiled{false};
+
+    /*! The width of the tiled artwork in device pixels, 0 keeps the width of the image. */
+    int tileWidth{0};
+
+    /*! The number of pixels shared by adjacent tiles. */
+    int tileOverlap{0};
+
+    /*! The time in ms to wait for a jig to be moved between tiles, -1 prompts the operator instead. */
+    int jigDelay{-1};
+};
+
+/*!
+ * A tile of a job converted into the layers to engrave.
+ */
+struct EZGRAVERCORESHARED_EXPORT ConvertedTile {
+    Tile tile{};
+    QVector<JobLayer> layers{};
+};
+
+/*!
+ * A job converted into the layers to engrave, or into tiles if the job is tiled.
+ */
+struct EZGRAVERCORESHARED_EXPORT ConvertedJob {
+    QVector<JobLayer> layers{};
+    QVector<ConvertedTile> tiles{};
+    QString error{};
+    qint64 duration{0};
+};
+
+/*!
+ * Parses a single job of a manifest.
+ *
+ * \param object The job as found in the manifest.
+ * \param directory The directory relative image paths are resolved against.
+ * \return The parsed job.
+ * \throws std::runtime_error Thrown if the job is malformed.
+ */
+EZGRAVERCORESHARED_EXPORT BatchJob parseJob(QJsonObject const& object, QDir const& directory);
+
+/*!
+ * Converts the image of the given \a job into the layers to engrave. The tiles of a tiled
+ * job are converted in parallel. Safe to be called from any thread.
+ *
+ * \param job The job to convert.
+ * \return The converted layers or tiles, or the reason the conversion failed.
+ */
+EZGRAVERCORESHARED_EXPORT ConvertedJob convertJob(BatchJob const& job);
+
+/*!
+ * Packs the payloads of all layers of a converted job ahead, thus they are ready to be uploaded
+ * as soon as the device is, see \a LayerJob::setLayers. The tiles are packed in parallel. Blank
+ * layers are left without payload. Safe to be called from any thread.
+ *
+ * \param converted The converted job to pack.
+ * \param format The payload format of the engraver.
+ */
+EZGRAVERCORESHARED_EXPORT void packJob(ConvertedJob& converted, PayloadFormat format);
+
+}
+
+#endif // EZGRAVER_BATCHJOB_H
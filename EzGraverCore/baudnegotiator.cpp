@@ -0,0 +1,125 @@
+#include "baudnegotiator.h"
+
+#include <QDebug>
+
+#include <stdexcept>
+
+#include "ezgraver.h"
+
+namespace Ez {
+
+BaudNegotiator::BaudNegotiator(EzGraver& engraver, Transmit transmit, QVector<BaudRate> const& rates, QByteArray const& handshake,
+                               Frame::Type acknowledgement, int timeout, QObject* parent)
+        : QObject{parent}, _engraver(engraver), _transmit{transmit}, _rates{rates}, _handshake{handshake},
+          _acknowledgement{acknowledgement}, _timeout{timeout} {
+    if(_rates.isEmpty()) {
+        throw std::invalid_argument{"no baud rate to negotiate"};
+    }
+
+    _timer.setSingleShot(true);
+    connect(&_timer, &QTimer::timeout, this, &BaudNegotiator::_fallback);
+    connect(&_handshakeSent, &QFutureWatcherBase::finished, this, &BaudNegotiator::_sent);
+}
+
+QFuture<void> BaudNegotiator::negotiate() {
+    _metrics.baudRate = 0;
+    _metrics.attempts = 0;
+    _metrics.handshakeTime = -1;
+    _metrics.reverts = 0;
+    _metrics.recovered = false;
+    _current = _preferred;
+    return _attempt();
+}
+
+void BaudNegotiator::cancel() {
+    _timer.stop();
+    _current = -1;
+}
+
+bool BaudNegotiator::negotiating() const {
+    return _current >= 0;
+}
+
+void BaudNegotiator::dataReceived() {
+    // The owner of the connection consumed the announced frame, thus it is no longer expected.
+    if(!negotiating() || _engraver.frameDecoder().expecting(_acknowledgement)) {
+        return;
+    }
+
+    _timer.stop();
+    _metrics.baudRate = _rates[_current].baudRate;
+    _metrics.handshakeTime = _clock.isValid() ? _clock.elapsed() : -1;
+    _metrics.recovered = _metrics.reverts > 0;
+    _preferred = _current;
+    _current = -1;
+    qDebug() << "negotiated" << _metrics.baudRate << "baud, handshake answered in" << _metrics.handshakeTime << "ms";
+    emit negotiated(_metrics.baudRate);
+}
+
+NegotiationMetrics BaudNegotiator::metrics() const {
+    return _metrics;
+}
+
+QFuture<void> BaudNegotiator::_attempt() {
+    auto const& rate = _rates[_current];
+    ++_metrics.attempts;
+    qDebug() << "negotiating" << rate.baudRate << "baud";
+
+    // Switching requests are understood at the rate the device starts with only.
+    _engraver.setBaudRate(_rates.last().baudRate);
+    if(!rate.request.isEmpty()) {
+        _transmit(rate.request);
+        _engraver.setBaudRate(rate.baudRate);
+    }
+
+    // The baud rate is changed once the request has left the host, no fixed delay is needed.
+    _engraver.frameDecoder().expect(_acknowledgement);
+    _clock.invalidate();
+    auto sent = _transmit(_handshake);
+    _handshakeSent.setFuture(sent);
+    _timer.start(_timeout);
+    return sent;
+}
+
+void BaudNegotiator::_sent() {
+    if(!negotiating()) {
+        return;
+    }
+    if(_handshakeSent.isCanceled()) {
+        qDebug() << "handshake could not be sent with" << _rates[_current].baudRate << "baud";
+        _timer.stop();
+        _fallback();
+        return;
+    }
+    _clock.start();
+}
+
+void BaudNegotiator::_fallback() {
+    if(!negotiating()) {
+        return;
+    }
+
+    // The request may have been understood even though the answer got lost, thus the device is
+    // reverted with the rate it may be listening with before the host returns to the initial rate.
+    auto const& revert = _rates[_current].revert;
+    if(!revert.isEmpty()) {
+        qDebug() << "reverting device from" << _rates[_current].baudRate << "baud";
+        _transmit(revert);
+        ++_metrics.reverts;
+    }
+    _engraver.setBaudRate(_rates.last().baudRate);
+
+    if(_current + 1 >= _rates.size()) {
+        qDebug() << "device did not acknowledge any baud rate";
+        _current = -1;
+        emit failed();
+        return;
+    }
+
+    qDebug() << "no answer with" << _rates[_current].baudRate << "baud, falling back";
+    ++_current;
+    ++_metrics.fallbacks;
+    _attempt();
+}
+
+}
@@ -0,0 +1,157 @@
+#ifndef EZGRAVER_BAUDNEGOTIATOR_H
+#define EZGRAVER_BAUDNEGOTIATOR_H
+
+#include "ezgravercore_global.h"
+
+#include <QObject>
+#include <QByteArray>
+#include <QVector>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QFutureWatcher>
+
+#include <functional>
+
+#include "framedecoder.h"
+
+namespace Ez {
+
+struct EzGraver;
+
+/*!
+ * A baud rate supported by the engraver.
+ */
+struct EZGRAVERCORESHARED_EXPORT BaudRate {
+    /*! The baud rate. */
+    qint32 baudRate;
+
+    /*! The command switching the device to the baud rate, empty for the rate it starts with. */
+    QByteArray request;
+
+    /*! The command switching the device back to the rate it starts with, sent with this rate if it has not been acknowledged. */
+    QByteArray revert;
+};
+
+/*!
+ * The outcome of the last baud rate negotiation.
+ */
+struct EZGRAVERCORESHARED_EXPORT NegotiationMetrics {
+    /*! The baud rate acknowledged by the device, 0 if none has been. */
+    qint32 baudRate{0};
+
+    /*! The number of rates tried by the last negotiation. */
+    int attempts{0};
+
+    /*! The number of times a slower rate had to be used since the connection has been established. */
+    int fallbacks{0};
+
+    /*! The time in milliseconds between sending the handshake and its acknowledgement, -1 if not acknowledged. */
+    qint64 handshakeTime{-1};
+
+    /*! The number of times the last negotiation asked the device to revert to the rate it starts with. */
+    int reverts{0};
+
+    /*! Whether the device acknowledged a slower rate after having been reverted by the last negotiation. */
+    bool recovered{false};
+};
+
+/*!
+ * Switches the connection to the fastest baud rate the device acknowledges. Every rate is
+ * checked by sending a handshake command whose answer is announced to the frame decoder.
+ * If the answer does not arrive in time, or the transmission fails, the device is asked to
+ * revert to the rate it starts with, as it may have switched without its answer arriving,
+ * and the next slower rate is tried. The last acknowledged rate is tried first by subsequent negotiations, thus a device
+ * without support for a rate only costs a single timeout.
+ */
+class EZGRAVERCORESHARED_EXPORT BaudNegotiator : public QObject {
+    Q_OBJECT
+
+public:
+    /*! Sends a command to the device and finishes as soon as it has been transmitted. */
+    using Transmit = std::function<QFuture<void>(QByteArray const&)>;
+
+    /*!
+     * Creates a new negotiator.
+     *
+     * \param engraver The engraver whose connection is negotiated.
+     * \param transmit Sends commands to the engraver.
+     * \param rates The supported rates ordered from fastest to slowest. The slowest is the rate the device starts with.
+     * \param handshake The command answered by the device with the announced frame.
+     * \param acknowledgement The type of the frame answering the handshake.
+     * \param timeout The time in milliseconds to await the acknowledgement.
+     * \param parent The parent of the negotiator.
+     * \throws std::invalid_argument Thrown if no rate is provided.
+     */
+    BaudNegotiator(EzGraver& engraver, Transmit transmit, QVector<BaudRate> const& rates, QByteArray const& handshake,
+                   Frame::Type acknowledgement, int timeout, QObject* parent=NULL);
+
+    /*!
+     * Starts negotiating. The device answers the handshake of the acknowledged rate as usual,
+     * thus its answer is processed by the owner of the connection.
+     *
+     * \return A future which finishes as soon as the first handshake has been transmitted.
+     */
+    QFuture<void> negotiate();
+
+    /*!
+     * Aborts a negotiation in progress, e.g. as the device has been reset.
+     */
+    void cancel();
+
+    /*!
+     * Gets if a negotiation is in progress.
+     *
+     * \return \c true if the acknowledgement is awaited.
+     */
+    bool negotiating() const;
+
+    /*!
+     * Checks if the acknowledgement has been received. Has to be invoked after the received data
+     * has been fed into the frame decoder.
+     */
+    void dataReceived();
+
+    /*!
+     * Gets the outcome of the last negotiation.
+     *
+     * \return The negotiation metrics.
+     */
+    NegotiationMetrics metrics() const;
+
+signals:
+    /*!
+     * Fired as soon as the device acknowledged a rate.
+     *
+     * \param baudRate The negotiated baud rate.
+     */
+    void negotiated(qint32 baudRate);
+
+    /*!
+     * Fired if the device did not acknowledge any rate.
+     */
+    void failed();
+
+private:
+    EzGraver& _engraver;
+    Transmit _transmit;
+    QVector<BaudRate> _rates;
+    QByteArray _handshake;
+    Frame::Type _acknowledgement;
+    int _timeout;
+
+    int _preferred{0};
+    int _current{-1};
+    NegotiationMetrics _metrics{};
+    QTimer _timer{this};
+    QFutureWatcher<void> _handshakeSent{this};
+    QElapsedTimer _clock{};
+
+    QFuture<void> _attempt();
+    void _sent();
+    void _fallback();
+};
+
+}
+
+#endif // EZGRAVER_BAUDNEGOTIATOR_H
@@ -0,0 +1,460 @@
+#include "dithering.h"
+
+#include <QThread>
+#include <QVector>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EZ_DITHER_SSE2
+#endif
+
+namespace Ez {
+
+namespace {
+
+/*! A share of the quantization error passed to a neighbour. */
+struct Weight {
+    int dx;
+    int dy;
+    int weight;
+};
+
+/*! An error diffusion kernel, the weights are relative to \a divisor. */
+struct Kernel {
+    Weight const* weights;
+    int count;
+    int divisor;
+    int reach;
+};
+
+constexpr Weight FloydSteinbergWeights[]{
+    {1, 0, 7}, {-1, 1, 3}, {0, 1, 5}, {1, 1, 1}
+};
+
+// Atkinson passes on six eighths of the error only.
+constexpr Weight AtkinsonWeights[]{
+    {1, 0, 1}, {2, 0, 1}, {-1, 1, 1}, {0, 1, 1}, {1, 1, 1}, {0, 2, 1}
+};
+
+constexpr Weight JarvisJudiceNinkeWeights[]{
+    {1, 0, 7}, {2, 0, 5},
+    {-2, 1, 3}, {-1, 1, 5}, {0, 1, 7}, {1, 1, 5}, {2, 1, 3},
+    {-2, 2, 1}, {-1, 2, 3}, {0, 2, 5}, {1, 2, 3}, {2, 2, 1}
+};
+
+constexpr Weight StuckiWeights[]{
+    {1, 0, 8}, {2, 0, 4},
+    {-2, 1, 2}, {-1, 1, 4}, {0, 1, 8}, {1, 1, 4}, {2, 1, 2},
+    {-2, 2, 1}, {-1, 2, 2}, {0, 2, 4}, {1, 2, 2}, {2, 2, 1}
+};
+
+/*! The number of columns and rows of error kept beyond the image, the largest reach of the kernels. */
+constexpr int ErrorPadding{2};
+
+/*! The number of pixels a row is processed in before its progress is published. */
+constexpr int ChunkSize{32};
+
+/*! The width and height of the blue noise threshold matrix. */
+constexpr int BlueNoiseSize{64};
+
+Kernel kernel(DitherMethod method) {
+    switch(method) {
+    case DitherMethod::FloydSteinberg:
+    case DitherMethod::FloydSteinbergSerpentine:
+        return Kernel{FloydSteinbergWeights, 4, 16, 1};
+    case DitherMethod::Atkinson:
+        return Kernel{AtkinsonWeights, 6, 8, 2};
+    case DitherMethod::JarvisJudiceNinke:
+        return Kernel{JarvisJudiceNinkeWeights, 12, 48, 2};
+    case DitherMethod::Stucki:
+        return Kernel{StuckiWeights, 12, 42, 2};
+    default:
+        throw std::invalid_argument{"not an error diffusion method"};
+    }
+}
+
+/*! Writes the gray level of \a count pixels of a 32 bit scanline, transparent pixels are composed onto white. */
+void grayRow(QRgb const* pixels, uchar* gray, int count) {
+    for(int x{0}; x < count; ++x) {
+        auto pixel = pixels[x];
+        auto alpha = qAlpha(pixel);
+        gray[x] = alpha == 255
+                ? static_cast<uchar>(qGray(pixel))
+                : static_cast<uchar>((qGray(pixel) * alpha + 255 * (255 - alpha)) / 255);
+    }
+}
+
+/*! Everything shared by the threads diffusing the error of an image. */
+struct Diffusion {
+    Kernel kernel;
+    int width;
+    int height;
+    uchar const* source;
+    int sourceStride;
+    uchar* bits;
+    int bitsStride;
+    std::vector<int> errors;
+    int errorStride;
+    std::unique_ptr<std::atomic<int>[]> progress;
+
+    int* errorRow(int y) {
+        return errors.data() + y * errorStride + ErrorPadding;
+    }
+};
+
+/*!
+ * Quantizes the pixels \a from to \a to of a row and diffuses their error. The error of a
+ * pixel is accumulated in the cells of its neighbours weighted but not yet divided.
+ */
+void diffuse(Kernel const& kernel, uchar const* gray, int* errors, int errorStride, uchar* bits, int from, int to, int direction) {
+    for(int x{from}; x != to; x += direction) {
+        auto value = gray[x] + errors[x] / kernel.divisor;
+        auto black = value < 128;
+        auto error = value - (black ? 0 : 255);
+        if(black) {
+            bits[x >> 3] |= static_cast<uchar>(0x80 >> (x & 7));
+        }
+        for(int i{0}; i < kernel.count; ++i) {
+            auto const& weight = kernel.weights[i];
+            errors[weight.dy * errorStride + x + direction * weight.dx] += error * weight.weight;
+        }
+    }
+}
+
+/*!
+ * Diffuses every \a step th row starting with \a first. A chunk of a row is only processed
+ * once the row above it is 2 * reach + 1 pixels ahead: the chunk then receives no error from
+ * that row anymore, and both rows never add to the same cells of the rows below at once.
+ */
+void diffuseRows(Diffusion& diffusion, int first, int step) {
+    auto const& kernel = diffusion.kernel;
+    auto width = diffusion.width;
+    QVector<uchar> gray(width);
+    for(int y{first}; y < diffusion.height; y += step) {
+        grayRow(reinterpret_cast<QRgb const*>(diffusion.source + y * diffusion.sourceStride), gray.data(), width);
+        auto errors = diffusion.errorRow(y);
+        auto bits = diffusion.bits + y * diffusion.bitsStride;
+        for(int from{0}; from < width; from += ChunkSize) {
+            auto to = std::min(width, from + ChunkSize);
+            if(y > 0) {
+                auto required = std::min(width, to + 2 * kernel.reach + 1);
+                while(diffusion.progress[y - 1].load(std::memory_order_acquire) < required) {
+                    std::this_thread::yield();
+                }
+            }
+            diffuse(kernel, gray.constData(), errors, diffusion.errorStride, bits, from, to, 1);
+            diffusion.progress[y].store(to, std::memory_order_release);
+        }
+    }
+}
+
+/*! Scans the rows alternately from left to right and right to left, which requires every row to be complete before the next one. */
+void diffuseSerpentine(Diffusion& diffusion) {
+    auto width = diffusion.width;
+    QVector<uchar> gray(width);
+    for(int y{0}; y < diffusion.height; ++y) {
+        grayRow(reinterpret_cast<QRgb const*>(diffusion.source + y * diffusion.sourceStride), gray.data(), width);
+        auto errors = diffusion.errorRow(y);
+        auto bits = diffusion.bits + y * diffusion.bitsStride;
+        if(y % 2 == 0) {
+            diffuse(diffusion.kernel, gray.constData(), errors, diffusion.errorStride, bits, 0, width, 1);
+        } else {
+            diffuse(diffusion.kernel, gray.constData(), errors, diffusion.errorStride, bits, width - 1, -1, -1);
+        }
+    }
+}
+
+/*!
+ * Generates a blue noise threshold matrix using the void-and-cluster method. The pixels are
+ * ranked by the order they are added to or removed from a pattern whose points are spread as
+ * evenly as possible, measured by a gaussian energy wrapping around the edges of the matrix.
+ */
+class BlueNoiseMatrix {
+public:
+    BlueNoiseMatrix() : _thresholds(Area) {
+        for(int dy{0}; dy < BlueNoiseSize; ++dy) {
+            for(int dx{0}; dx < BlueNoiseSize; ++dx) {
+                // Distances wrap around, the matrix is tiled across the image.
+                auto wrappedX = std::min(dx, BlueNoiseSize - dx);
+                auto wrappedY = std::min(dy, BlueNoiseSize - dy);
+                _gaussian[dy * BlueNoiseSize + dx] = std::exp(-(wrappedX * wrappedX + wrappedY * wrappedY) / (2 * Sigma * Sigma));
+            }
+        }
+
+        // A fixed seed keeps the matrix and thus every dithered image the same across runs.
+        std::mt19937 random{0x45A6};
+        std::vector<bool> initial(Area, false);
+        for(int placed{0}; placed < Area / 10;) {
+            auto index = static_cast<int>(random() % Area);
+            if(!initial[index]) {
+                initial[index] = true;
+                ++placed;
+            }
+        }
+        auto ones = _relax(initial);
+
+        std::vector<int> rank(Area, 0);
+        _reset(initial);
+        for(int current{ones - 1}; current >= 0; --current) {
+            auto index = _extreme(true, true);
+            _toggle(index);
+            rank[index] = current;
+        }
+
+        // Filling the largest void up to the full matrix is the same as removing the tightest
+        // cluster of zeros for the energy is symmetric.
+        _reset(initial);
+        for(int current{ones}; current < Area; ++current) {
+            auto index = _extreme(false, false);
+            _toggle(index);
+            rank[index] = current;
+        }
+
+        // Thresholds range from 1 to 255: black stays black and white stays white.
+        for(int index{0}; index < Area; ++index) {
+            _thresholds[index] = static_cast<uchar>(1 + rank[index] * 255 / Area);
+        }
+    }
+
+    uchar const* row(int y) const {
+        return _thresholds.data() + (y % BlueNoiseSize) * BlueNoiseSize;
+    }
+
+private:
+    static constexpr int Area{BlueNoiseSize * BlueNoiseSize};
+    static constexpr double Sigma{1.5};
+
+    double _gaussian[Area];
+    std::vector<double> _energy{};
+    std::vector<bool> _pattern{};
+    std::vector<uchar> _thresholds;
+
+    void _reset(std::vector<bool> const& pattern) {
+        _pattern.assign(Area, false);
+        _energy.assign(Area, 0.0);
+        for(int index{0}; index < Area; ++index) {
+            if(pattern[index]) {
+                _toggle(index);
+            }
+        }
+    }
+
+    void _toggle(int index) {
+        _pattern[index] = !_pattern[index];
+        auto sign = _pattern[index] ? 1.0 : -1.0;
+        auto x = index % BlueNoiseSize;
+        auto y = index / BlueNoiseSize;
+        for(int otherY{0}; otherY < BlueNoiseSize; ++otherY) {
+            auto gaussian = _gaussian + ((otherY - y + BlueNoiseSize) % BlueNoiseSize) * BlueNoiseSize;
+            auto energy = _energy.data() + otherY * BlueNoiseSize;
+            for(int otherX{0}; otherX < BlueNoiseSize; ++otherX) {
+                energy[otherX] += sign * gaussian[(otherX - x + BlueNoiseSize) % BlueNoiseSize];
+            }
+        }
+    }
+
+    /*! Finds the tightest cluster, the set pixel of the highest energy, or the largest void, the unset one of the lowest. */
+    int _extreme(bool set, bool highest) const {
+        int result{-1};
+        for(int index{0}; index < Area; ++index) {
+            if(_pattern[index] == set && (result < 0 || (highest ? _energy[index] > _energy[result] : _energy[index] < _energy[result]))) {
+                result = index;
+            }
+        }
+        return result;
+    }
+
+    /*! Moves points from the tightest cluster to the largest void until the pattern is stable. */
+    int _relax(std::vector<bool>& pattern) {
+        _reset(pattern);
+        forever {
+            auto cluster = _extreme(true, true);
+            _toggle(cluster);
+            auto gap = _extreme(false, false);
+            _toggle(gap);
+            if(gap == cluster) {
+                break;
+            }
+        }
+        pattern = _pattern;
+        return static_cast<int>(std::count(pattern.begin(), pattern.end(), true));
+    }
+};
+
+BlueNoiseMatrix const& blueNoise() {
+    static BlueNoiseMatrix const matrix{};
+    return matrix;
+}
+
+/*! Reverses the bits of a byte, the lowest pixel of a comparison mask is the highest bit of a monochrome scanline. */
+struct BitReversal {
+    uchar bytes[256];
+
+    BitReversal() : bytes{} {
+        for(int value{0}; value < 256; ++value) {
+            int reversed{0};
+            for(int bit{0}; bit < 8; ++bit) {
+                reversed |= ((value >> bit) & 1) << (7 - bit);
+            }
+            bytes[value] = static_cast<uchar>(reversed);
+        }
+    }
+};
+
+/*! Compares a row against the tiled threshold matrix, pixels darker than their threshold are black. */
+void thresholdRow(uchar const* gray, uchar const* thresholds, uchar* bits, int width) {
+    int x{0};
+#if defined(EZ_DITHER_SSE2)
+    static BitReversal const reversal{};
+    // Bytes are compared signed, flipping the top bit preserves their order.
+    __m128i const bias{_mm_set1_epi8(static_cast<char>(0x80))};
+    for(; x + 16 <= width; x += 16) {
+        auto pixels = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(gray + x)), bias);
+        auto limits = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(thresholds + x % BlueNoiseSize)), bias);
+        auto mask = _mm_movemask_epi8(_mm_cmplt_epi8(pixels, limits));
+        bits[x >> 3] = reversal.bytes[mask & 0xFF];
+        bits[(x >> 3) + 1] = reversal.bytes[(mask >> 8) & 0xFF];
+    }
+#endif
+    for(; x < width; ++x) {
+        if(gray[x] < thresholds[x % BlueNoiseSize]) {
+            bits[x >> 3] |= static_cast<uchar>(0x80 >> (x & 7));
+        }
+    }
+}
+
+void thresholdRows(uchar const* source, int sourceStride, uchar* bits, int bitsStride, int width, int first, int last) {
+    auto const& matrix = blueNoise();
+    QVector<uchar> gray(width);
+    for(int y{first}; y < last; ++y) {
+        grayRow(reinterpret_cast<QRgb const*>(source + y * sourceStride), gray.data(), width);
+        thresholdRow(gray.constData(), matrix.row(y), bits + y * bitsStride, width);
+    }
+}
+
+int threadCount(int threads, int rows) {
+    auto count = threads > 0 ? threads : QThread::idealThreadCount();
+    return std::max(1, std::min(count, rows));
+}
+
+}
+
+QList<DitherMethod> ditherMethods() {
+    return QList<DitherMethod>{
+        DitherMethod::ConversionFlags,
+        DitherMethod::FloydSteinberg,
+        DitherMethod::FloydSteinbergSerpentine,
+        DitherMethod::Atkinson,
+        DitherMethod::JarvisJudiceNinke,
+        DitherMethod::Stucki,
+        DitherMethod::BlueNoise
+    };
+}
+
+QString ditherMethodName(DitherMethod method) {
+    switch(method) {
+    case DitherMethod::ConversionFlags:
+        return "conversion-flags";
+    case DitherMethod::FloydSteinberg:
+        return "floyd-steinberg";
+    case DitherMethod::FloydSteinbergSerpentine:
+        return "floyd-steinberg-serpentine";
+    case DitherMethod::Atkinson:
+        return "atkinson";
+    case DitherMethod::JarvisJudiceNinke:
+        return "jarvis";
+    case DitherMethod::Stucki:
+        return "stucki";
+    case DitherMethod::BlueNoise:
+        return "blue-noise";
+    }
+    return QString{};
+}
+
+DitherMethod ditherMethod(QString const& name) {
+    for(auto method : ditherMethods()) {
+        if(ditherMethodName(method) == name) {
+            return method;
+        }
+    }
+    throw std::invalid_argument{QString{"unknown dither method '%1'"}.arg(name).toStdString()};
+}
+
+QImage dither(QImage const& image, DitherMethod method, int threads) {
+    if(method == DitherMethod::ConversionFlags) {
+        throw std::invalid_argument{"conversion flags are applied by QImage"};
+    }
+
+    auto source = image.format() == QImage::Format_ARGB32 || image.format() == QImage::Format_RGB32
+            ? image : image.convertToFormat(QImage::Format_ARGB32);
+    QImage result{source.size(), QImage::Format_Mono};
+    result.setColorTable(QVector<QRgb>{qRgb(255, 255, 255), qRgb(0, 0, 0)});
+    result.setDotsPerMeterX(source.dotsPerMeterX());
+    result.setDotsPerMeterY(source.dotsPerMeterY());
+    result.fill(0);
+    if(source.isNull()) {
+        return result;
+    }
+
+    auto width = source.width();
+    auto height = source.height();
+    auto count = threadCount(threads, height);
+    // The scanlines are accessed directly, QImage must not detach while the threads run.
+    auto sourceBits = source.constBits();
+    auto resultBits = result.bits();
+    std::vector<std::thread> workers{};
+
+    if(method == DitherMethod::BlueNoise) {
+        auto band = (height + count - 1) / count;
+        for(int first{band}; first < height; first += band) {
+            workers.emplace_back(thresholdRows, sourceBits, source.bytesPerLine(), resultBits, result.bytesPerLine(),
+                                 width, first, std::min(height, first + band));
+        }
+        thresholdRows(sourceBits, source.bytesPerLine(), resultBits, result.bytesPerLine(), width, 0, std::min(height, band));
+        for(auto& worker : workers) {
+            worker.join();
+        }
+        return result;
+    }
+
+    Diffusion diffusion{};
+    diffusion.kernel = kernel(method);
+    diffusion.width = width;
+    diffusion.height = height;
+    diffusion.source = sourceBits;
+    diffusion.sourceStride = source.bytesPerLine();
+    diffusion.bits = resultBits;
+    diffusion.bitsStride = result.bytesPerLine();
+    diffusion.errorStride = width + 2 * ErrorPadding;
+    diffusion.errors.assign(static_cast<size_t>(diffusion.errorStride) * (height + ErrorPadding), 0);
+    diffusion.progress.reset(new std::atomic<int>[height]);
+    for(int y{0}; y < height; ++y) {
+        diffusion.progress[y].store(0);
+    }
+
+    if(method == DitherMethod::FloydSteinbergSerpentine) {
+        diffuseSerpentine(diffusion);
+        return result;
+    }
+
+    for(int first{1}; first < count; ++first) {
+        workers.emplace_back(diffuseRows, std::ref(diffusion), first, count);
+    }
+    diffuseRows(diffusion, 0, count);
+    for(auto& worker : workers) {
+        worker.join();
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,85 @@
+#ifndef EZGRAVER_DITHERING_H
+#define EZGRAVER_DITHERING_H
+
+#include "ezgravercore_global.h"
+
+#include <QImage>
+#include <QString>
+#include <QList>
+#include <QMetaType>
+
+namespace Ez {
+
+/*!
+ * The algorithms available to convert an image into the monochrome bitmap to engrave.
+ */
+enum class DitherMethod : quint8 {
+    /*! Uses the conversion flags of QImage, i.e. Qt's diffuse, ordered or threshold dither. */
+    ConversionFlags,
+
+    /*! Floyd-Steinberg error diffusion. */
+    FloydSteinberg,
+
+    /*! Floyd-Steinberg error diffusion scanning every other row from right to left. */
+    FloydSteinbergSerpentine,
+
+    /*! Atkinson error diffusion, only diffuses three quarters of the error and keeps more contrast. */
+    Atkinson,
+
+    /*! Jarvis-Judice-Ninke error diffusion over two rows. */
+    JarvisJudiceNinke,
+
+    /*! Stucki error diffusion over two rows. */
+    Stucki,
+
+    /*! Ordered dither using a blue noise threshold matrix generated by the void-and-cluster method. */
+    BlueNoise
+};
+
+/*!
+ * Gets all dither methods.
+ *
+ * \return The dither methods in the order they should be offered.
+ */
+EZGRAVERCORESHARED_EXPORT QList<DitherMethod> ditherMethods();
+
+/*!
+ * Gets the name of the given \a method as used in manifests, e.g. "floyd-steinberg".
+ *
+ * \param method The dither method.
+ * \return The name of the method.
+ */
+EZGRAVERCORESHARED_EXPORT QString ditherMethodName(DitherMethod method);
+
+/*!
+ * Gets the method of the given \a name.
+ *
+ * \param name The name as returned by \a ditherMethodName.
+ * \return The dither method.
+ * \throws std::invalid_argument Thrown if the name is unknown.
+ */
+EZGRAVERCORESHARED_EXPORT DitherMethod ditherMethod(QString const& name);
+
+/*!
+ * Converts the given \a image into a monochrome bitmap. Transparent pixels are composed onto
+ * white. The black pixels of the result are the ones to engrave.
+ *
+ * Error diffusion runs on several threads. Every thread processes a row as soon as the row
+ * above it got far enough ahead that no pixel still receives error from it, thus the result
+ * is identical regardless of the number of threads. Scanning serpentine requires every row to
+ * wait for the complete previous one, it always runs on a single thread. The ordered dither
+ * compares 16 pixels at once where SSE2 is available.
+ *
+ * \param image The image to dither.
+ * \param method The algorithm to use, must not be \a DitherMethod::ConversionFlags.
+ * \param threads The number of threads to use, 0 uses one per core.
+ * \return The dithered image in \c QImage::Format_Mono.
+ * \throws std::invalid_argument Thrown if the method is \a DitherMethod::ConversionFlags.
+ */
+EZGRAVERCORESHARED_EXPORT QImage dither(QImage const& image, DitherMethod method, int threads=0);
+
+}
+
+Q_DECLARE_METATYPE(Ez::DitherMethod)
+
+#endif // EZGRAVER_DITHERING_H
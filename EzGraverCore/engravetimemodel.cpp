@@ -0,0 +1,323 @@
+#include "engravetimemodel.h"
+
+#include <QSettings>
+#include <QUrl>
+#include <QVariantList>
+#include <QDebug>
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstdlib>
+
+#include "specifications.h"
+
+namespace Ez {
+
+int const EngraveTimeModel::MaximumStep;
+int const EngraveTimeModel::FitInterval;
+int const EngraveTimeModel::Coefficients;
+
+namespace {
+
+constexpr int RowBytes{((Specifications::ImageWidth + 31) / 32) * 4};
+
+/*! The size of the header preceding the pixels of a bitmap payload. */
+constexpr int BitmapHeaderSize{14 + 40 + 2 * 4};
+
+/*!
+ * The coefficients assumed before any calibration, in milliseconds per unit of burn time,
+ * pixel, run, blank pixel and row.
+ */
+constexpr double PriorCoefficients[]{1.0, 2.0, 5.0, 0.5, 20.0};
+
+/*! The weight of the prior, in samples. */
+constexpr double PriorWeight{25.0};
+
+/*! The number of samples beyond which older ones are faded out, keeping the model adaptive. */
+constexpr double MaximumSamples{200000.0};
+
+}
+
+EngraveFeatures engraveFeatures(QByteArray const& payload, PayloadFormat format) {
+    EngraveFeatures features{};
+
+    if(payload.size() < payloadSize(format)) {
+        return features;
+    }
+
+    // Protocol v1 and v2 expect inverted pixels, the burnt ones are cleared.
+    auto const bitmap = format == PayloadFormat::Bitmap;
+    auto const mask = static_cast<uchar>(bitmap ? 0xFF : 0x00);
+    auto data = reinterpret_cast<uchar const*>(payload.constData()) + (bitmap ? BitmapHeaderSize : 0);
+
+    int const lineBytes{(Specifications::ImageWidth + 7) / 8};
+    for(int row{0}; row < Specifications::ImageHeight; ++row, data += RowBytes) {
+        int pixels{0};
+        int first{-1};
+        int last{-1};
+        uchar previous{0};
+        for(int i{0}; i < lineBytes; ++i) {
+            auto bits = static_cast<uchar>(data[i] ^ mask);
+            if(!bits) {
+                previous = 0;
+                continue;
+            }
+
+            // A run starts at every burnt pixel whose left neighbour is blank.
+            auto left = static_cast<uchar>((bits >> 1) | ((previous & 1) << 7));
+            features.runs += static_cast<int>(std::bitset<8>(bits & ~left).count());
+            pixels += static_cast<int>(std::bitset<8>(bits).count());
+
+            if(first < 0) {
+                int bit{7};
+                while(!(bits & (1 << bit))) {
+                    --bit;
+                }
+                first = i * 8 + 7 - bit;
+            }
+            int bit{0};
+            while(!(bits & (1 << bit))) {
+                ++bit;
+            }
+            last = i * 8 + 7 - bit;
+            previous = bits;
+        }
+
+        if(pixels > 0) {
+            features.pixels += pixels;
+            features.gaps += last - first + 1 - pixels;
+            ++features.rows;
+        }
+    }
+    return features;
+}
+
+EngraveFeatures engraveFeatures(QImage const& image) {
+    return engraveFeatures(packImage(image, PayloadFormat::Raw), PayloadFormat::Raw);
+}
+
+EngraveTimeModel::EngraveTimeModel(QString const& deviceId)
+        : _settingsGroup{"EngraveTimeModel/" + QString::fromLatin1(QUrl::toPercentEncoding(deviceId))},
+          _coefficients{}, _normal{}, _target{} {
+    _load();
+    _fit();
+}
+
+EngraveTimeModel::~EngraveTimeModel() {
+    if(_unfitted > 0) {
+        _save();
+    }
+}
+
+void EngraveTimeModel::_vector(EngraveFeatures const& features, unsigned char burnTime, double (&vector)[Coefficients]) {
+    vector[0] = static_cast<double>(features.pixels) * burnTime;
+    vector[1] = features.pixels;
+    vector[2] = features.runs;
+    vector[3] = features.gaps;
+    vector[4] = features.rows;
+}
+
+qint64 EngraveTimeModel::predict(EngraveFeatures const& features, unsigned char burnTime) const {
+    double vector[Coefficients];
+    _vector(features, burnTime, vector);
+
+    double time{0};
+    for(int i{0}; i < Coefficients; ++i) {
+        time += _coefficients[i] * vector[i];
+    }
+    return std::max<qint64>(0, std::llround(time));
+}
+
+void EngraveTimeModel::begin(EngraveFeatures const& features, unsigned char burnTime) {
+    _running = true;
+    _total = features;
+    _done = EngraveFeatures{};
+    _burnTime = burnTime;
+    _planned = predict(features, burnTime);
+    _clock.start();
+    _lastReport = 0;
+    qDebug() << "engraving" << features.pixels << "pixels in" << features.rows << "rows is expected to take" << _planned << "ms";
+}
+
+void EngraveTimeModel::progress(QPoint const& position) {
+    if(!_running) {
+        return;
+    }
+
+    // Every report accounts for the features of the step from the previously reported pixel.
+    EngraveFeatures step{};
+    step.pixels = 1;
+    if(_done.pixels == 0 || position.y() != _last.y()) {
+        step.runs = 1;
+        step.rows = 1;
+    } else {
+        auto distance = std::abs(position.x() - _last.x());
+        step.runs = distance > 1 ? 1 : 0;
+        step.gaps = std::max(0, distance - 1);
+    }
+
+    // The first report includes the time to get going, which is not part of the model.
+    auto now = _clock.elapsed();
+    auto time = now - _lastReport;
+    if(_done.pixels > 0 && time <= MaximumStep) {
+        double vector[Coefficients];
+        _vector(step, _burnTime, vector);
+        _addSample(vector, static_cast<double>(time));
+    }
+
+    _done.pixels += step.pixels;
+    _done.runs += step.runs;
+    _done.gaps += step.gaps;
+    _done.rows += step.rows;
+    _last = position;
+    _lastReport = now;
+}
+
+void EngraveTimeModel::finish() {
+    if(!_running) {
+        return;
+    }
+
+    _running = false;
+    qDebug() << "engraving took" << _clock.elapsed() << "ms, expected" << _planned << "ms";
+    if(_unfitted > 0) {
+        _fit();
+        _save();
+    }
+}
+
+bool EngraveTimeModel::running() const {
+    return _running;
+}
+
+qint64 EngraveTimeModel::planned() const {
+    return _planned;
+}
+
+qint64 EngraveTimeModel::elapsed() const {
+    return _clock.isValid() ? _clock.elapsed() : 0;
+}
+
+qint64 EngraveTimeModel::remaining() const {
+    if(!_running) {
+        return 0;
+    }
+
+    EngraveFeatures left{};
+    left.pixels = std::max(0, _total.pixels - _done.pixels);
+    left.runs = std::max(0, _total.runs - _done.runs);
+    left.gaps = std::max(0, _total.gaps - _done.gaps);
+    left.rows = std::max(0, _total.rows - _done.rows);
+    return predict(left, _burnTime);
+}
+
+int EngraveTimeModel::engraved() const {
+    return _done.pixels;
+}
+
+int EngraveTimeModel::samples() const {
+    return static_cast<int>(_samples);
+}
+
+void EngraveTimeModel::_addSample(double const (&step)[Coefficients], double time) {
+    if(_samples >= MaximumSamples) {
+        for(int row{0}; row < Coefficients; ++row) {
+            for(int column{0}; column < Coefficients; ++column) {
+                _normal[row][column] /= 2;
+            }
+            _target[row] /= 2;
+        }
+        _samples /= 2;
+    }
+
+    for(int row{0}; row < Coefficients; ++row) {
+        for(int column{0}; column < Coefficients; ++column) {
+            _normal[row][column] += step[row] * step[column];
+        }
+        _target[row] += step[row] * time;
+    }
+    _samples += 1;
+
+    if(++_unfitted >= FitInterval) {
+        _fit();
+        _save();
+    }
+}
+
+void EngraveTimeModel::_fit() {
+    // Solves the normal equations regularized towards the prior by Gaussian elimination.
+    double system[Coefficients][Coefficients + 1];
+    for(int row{0}; row < Coefficients; ++row) {
+        for(int column{0}; column < Coefficients; ++column) {
+            system[row][column] = _normal[row][column] + (row == column ? PriorWeight : 0.0);
+        }
+        system[row][Coefficients] = _target[row] + PriorWeight * PriorCoefficients[row];
+    }
+
+    for(int pivot{0}; pivot < Coefficients; ++pivot) {
+        auto best = pivot;
+        for(int row{pivot + 1}; row < Coefficients; ++row) {
+            if(std::abs(system[row][pivot]) > std::abs(system[best][pivot])) {
+                best = row;
+            }
+        }
+        if(std::abs(system[best][pivot]) < 1e-12) {
+            return;
+        }
+        std::swap(system[pivot], system[best]);
+
+        for(int row{pivot + 1}; row < Coefficients; ++row) {
+            auto factor = system[row][pivot] / system[pivot][pivot];
+            for(int column{pivot}; column <= Coefficients; ++column) {
+                system[row][column] -= factor * system[pivot][column];
+            }
+        }
+    }
+
+    for(int row{Coefficients - 1}; row >= 0; --row) {
+        auto value = system[row][Coefficients];
+        for(int column{row + 1}; column < Coefficients; ++column) {
+            value -= system[row][column] * _coefficients[column];
+        }
+        _coefficients[row] = value / system[row][row];
+    }
+    _unfitted = 0;
+}
+
+void EngraveTimeModel::_load() {
+    QSettings settings{"EzGraver", "EzGraver"};
+    settings.beginGroup(_settingsGroup);
+    auto normal = settings.value("normal").toList();
+    auto target = settings.value("target").toList();
+    if(normal.size() != Coefficients * Coefficients || target.size() != Coefficients) {
+        return;
+    }
+
+    for(int row{0}; row < Coefficients; ++row) {
+        for(int column{0}; column < Coefficients; ++column) {
+            _normal[row][column] = normal[row * Coefficients + column].toDouble();
+        }
+        _target[row] = target[row].toDouble();
+    }
+    _samples = settings.value("samples", 0).toDouble();
+}
+
+void EngraveTimeModel::_save() const {
+    QVariantList normal{};
+    QVariantList target{};
+    for(int row{0}; row < Coefficients; ++row) {
+        for(int column{0}; column < Coefficients; ++column) {
+            normal.append(_normal[row][column]);
+        }
+        target.append(_target[row]);
+    }
+
+    QSettings settings{"EzGraver", "EzGraver"};
+    settings.beginGroup(_settingsGroup);
+    settings.setValue("normal", normal);
+    settings.setValue("target", target);
+    settings.setValue("samples", _samples);
+}
+
+}
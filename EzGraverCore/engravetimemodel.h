@@ -0,0 +1,183 @@
+#ifndef EZGRAVER_ENGRAVETIMEMODEL_H
+#define EZGRAVER_ENGRAVETIMEMODEL_H
+
+#include "ezgravercore_global.h"
+
+#include <QString>
+#include <QByteArray>
+#include <QImage>
+#include <QPoint>
+#include <QElapsedTimer>
+
+#include "imagepacker.h"
+
+namespace Ez {
+
+/*!
+ * The properties of a bitmap determining how long it takes to engrave.
+ */
+struct EZGRAVERCORESHARED_EXPORT EngraveFeatures {
+    /*! The number of pixels burnt. */
+    int pixels{0};
+
+    /*! The number of runs of adjacent burnt pixels within the rows. */
+    int runs{0};
+
+    /*! The number of blank pixels crossed between the first and the last burnt pixel of each row. */
+    int gaps{0};
+
+    /*! The number of rows containing any pixel to burn. */
+    int rows{0};
+};
+
+/*!
+ * Extracts the features of a packed payload without unpacking it.
+ *
+ * \param payload The payload as sent to the engraver.
+ * \param format The layout of the payload.
+ * \return The features of the payload.
+ */
+EZGRAVERCORESHARED_EXPORT EngraveFeatures engraveFeatures(QByteArray const& payload, PayloadFormat format);
+
+/*!
+ * Extracts the features of the given \a image as it would be engraved.
+ *
+ * \param image The image to engrave.
+ * \return The features of the image.
+ */
+EZGRAVERCORESHARED_EXPORT EngraveFeatures engraveFeatures(QImage const& image);
+
+/*!
+ * Predicts the time it takes a device to engrave a bitmap. The time is modelled as a linear
+ * combination of the burn time of every pixel, a fixed time per pixel, per run, per blank
+ * pixel crossed and per row.
+ *
+ * The coefficients are calibrated per device from the progress reports of the engraver:
+ * every reported pixel is a sample of the time taken since the previous one, fitted by
+ * least squares. A rough prior keeps predictions sensible until enough samples have been
+ * collected and separates the coefficients the samples cannot tell apart, e.g. the burn
+ * time and the time per pixel as long as a single burn time is used. The calibration is
+ * shared by all front-ends and kept across sessions.
+ *
+ * Tracking an engraving also provides the time remaining. Must be used by a single thread.
+ */
+class EZGRAVERCORESHARED_EXPORT EngraveTimeModel {
+public:
+    /*! The longest time in milliseconds between two reports taken as a sample, longer ones include pauses. */
+    static int const MaximumStep{2000};
+
+    /*! The number of samples after which the coefficients are fitted and stored again. */
+    static int const FitInterval{256};
+
+    /*!
+     * Creates a new model loading the calibration of the given device.
+     *
+     * \param deviceId The identifier of the device, see \a EzGraver::deviceId.
+     */
+    explicit EngraveTimeModel(QString const& deviceId);
+
+    /*!
+     * Stores the calibration upon deconstruction.
+     */
+    ~EngraveTimeModel();
+
+    /*!
+     * Predicts the time it takes to engrave a bitmap.
+     *
+     * \param features The features of the bitmap.
+     * \param burnTime The burn time passed to \a EzGraver::start.
+     * \return The expected time in milliseconds.
+     */
+    qint64 predict(EngraveFeatures const& features, unsigned char burnTime) const;
+
+    /*!
+     * Starts tracking an engraving which has just been started.
+     *
+     * \param features The features of the bitmap being engraved.
+     * \param burnTime The burn time the engraving has been started with.
+     */
+    void begin(EngraveFeatures const& features, unsigned char burnTime);
+
+    /*!
+     * Processes a pixel reported as engraved and calibrates the model with the time it took.
+     *
+     * \param position The engraved pixel.
+     */
+    void progress(QPoint const& position);
+
+    /*!
+     * Stops tracking the engraving and stores the calibration.
+     */
+    void finish();
+
+    /*!
+     * Gets if an engraving is tracked.
+     *
+     * \return \c true if \a begin has been called without calling \a finish.
+     */
+    bool running() const;
+
+    /*!
+     * Gets the time the tracked engraving was expected to take when it began.
+     *
+     * \return The expected time in milliseconds.
+     */
+    qint64 planned() const;
+
+    /*!
+     * Gets the time since the tracked engraving began.
+     *
+     * \return The elapsed time in milliseconds.
+     */
+    qint64 elapsed() const;
+
+    /*!
+     * Predicts the time left until the tracked engraving is done.
+     *
+     * \return The remaining time in milliseconds, 0 if nothing is tracked.
+     */
+    qint64 remaining() const;
+
+    /*!
+     * Gets the number of pixels of the tracked engraving reported so far.
+     *
+     * \return The number of engraved pixels.
+     */
+    int engraved() const;
+
+    /*!
+     * Gets the number of samples the calibration is based on.
+     *
+     * \return The number of samples.
+     */
+    int samples() const;
+
+private:
+    static int const Coefficients{5};
+
+    QString _settingsGroup;
+    double _coefficients[Coefficients];
+    double _normal[Coefficients][Coefficients];
+    double _target[Coefficients];
+    double _samples{0};
+    int _unfitted{0};
+
+    bool _running{false};
+    EngraveFeatures _total{};
+    EngraveFeatures _done{};
+    unsigned char _burnTime{0};
+    qint64 _planned{0};
+    QElapsedTimer _clock{};
+    QPoint _last{};
+    qint64 _lastReport{0};
+
+    static void _vector(EngraveFeatures const& features, unsigned char burnTime, double (&vector)[Coefficients]);
+    void _addSample(double const (&step)[Coefficients], double time);
+    void _fit();
+    void _load();
+    void _save() const;
+};
+
+}
+
+#endif // EZGRAVER_ENGRAVETIMEMODEL_H
@@ -0,0 +1,168 @@
+#include "eraseoperation.h"
+
+#include <QSettings>
+#include <QUrl>
+#include <QDebug>
+
+#include <algorithm>
+
+#include "ezgraver.h"
+#include "serialworker.h"
+
+namespace Ez {
+
+namespace {
+
+/*! The number of complete engravings required before a shorter wait is tried. */
+constexpr int ConfirmationsPerStep{3};
+
+}
+
+EraseOperation::EraseOperation(std::shared_ptr<EzGraver> engraver, QObject* parent)
+        : QObject{parent}, _engraver{engraver},
+          _settingsGroup{"EraseCalibration/" + QString::fromLatin1(QUrl::toPercentEncoding(engraver->deviceId()))} {
+    _timer.setSingleShot(true);
+    connect(&_timer, &QTimer::timeout, this, &EraseOperation::_timeout);
+    connect(&_transmission, &QFutureWatcherBase::finished, this, &EraseOperation::_transmitted);
+    _load();
+}
+
+int EraseOperation::expectedTime() const {
+    return _wait;
+}
+
+bool EraseOperation::running() const {
+    return _phase != Phase::Idle;
+}
+
+void EraseOperation::setCalibrating(bool calibrating) {
+    _calibrating = calibrating;
+}
+
+bool EraseOperation::calibrating() const {
+    return _calibrating;
+}
+
+void EraseOperation::confirm(bool complete) {
+    if(!_unconfirmed) {
+        return;
+    }
+    _unconfirmed = false;
+
+    if(complete) {
+        if(_wait < _safeWait) {
+            qDebug() << "erase wait of" << _wait << "ms sufficed, lowered from" << _safeWait << "ms";
+            _safeWait = _wait;
+            _streak = 1;
+        } else {
+            ++_streak;
+        }
+    } else if(_wait < _safeWait) {
+        qDebug() << "erase wait of" << _wait << "ms was too short, staying with" << _safeWait << "ms";
+        _failedWait = std::max(_failedWait, _wait);
+        _streak = 0;
+    } else {
+        qDebug() << "erase wait of" << _wait << "ms was too short, backing off";
+        _failedWait = _wait;
+        _safeWait = std::min(_recommended, _safeWait + _safeWait / 2);
+        _streak = 0;
+    }
+    _save();
+}
+
+void EraseOperation::start() {
+    if(running()) {
+        return;
+    }
+
+    _unconfirmed = false;
+    _clock.start();
+    _recommended = _engraver->erase();
+    if(_engraver->reportsErased()) {
+        _wait = _recommended;
+        _phase = Phase::AwaitingReady;
+        _timer.start(ReadyTimeout);
+        return;
+    }
+
+    if(_safeWait <= 0 || _safeWait > _recommended) {
+        _safeWait = _recommended;
+    }
+    _wait = _safeWait;
+    if(_calibrating && _streak >= ConfirmationsPerStep) {
+        // Never probe within a quarter of a wait known to be too short.
+        auto lowerBound = std::max(MinimumWait, _failedWait + _failedWait / 4);
+        auto probe = std::max(lowerBound, _safeWait * 4 / 5);
+        _wait = std::min(_safeWait, probe);
+    }
+
+    // The device starts erasing once the command has left the host.
+    _phase = Phase::Transmitting;
+    _transmission.setFuture(_engraver->serialWorker()->transmitted());
+}
+
+void EraseOperation::cancel() {
+    _timer.stop();
+    _phase = Phase::Idle;
+}
+
+void EraseOperation::processFrame(Frame const& frame) {
+    if(_phase == Phase::AwaitingReady && frame.type == Frame::Type::UploadReady) {
+        _finish();
+    }
+}
+
+void EraseOperation::_transmitted() {
+    if(_phase != Phase::Transmitting) {
+        return;
+    }
+    if(_transmission.isCanceled()) {
+        _phase = Phase::Idle;
+        emit failed("transmission failed");
+        return;
+    }
+
+    _phase = Phase::Waiting;
+    _timer.start(_wait);
+}
+
+void EraseOperation::_timeout() {
+    switch(_phase) {
+    case Phase::Waiting:
+        _unconfirmed = true;
+        _finish();
+        break;
+    case Phase::AwaitingReady:
+        _phase = Phase::Idle;
+        emit failed("engraver did not report the end of the erase");
+        break;
+    default:
+        break;
+    }
+}
+
+void EraseOperation::_finish() {
+    _timer.stop();
+    _phase = Phase::Idle;
+    qDebug() << "EEPROM erased after" << _clock.elapsed() << "ms";
+    emit erased(_clock.elapsed());
+}
+
+void EraseOperation::_load() {
+    QSettings settings{"EzGraver", "EzGraver"};
+    settings.beginGroup(_settingsGroup);
+    _safeWait = settings.value("safeWait", 0).toInt();
+    _failedWait = settings.value("failedWait", 0).toInt();
+    _streak = settings.value("streak", 0).toInt();
+    _wait = _safeWait;
+}
+
+void EraseOperation::_save() const {
+    QSettings settings{"EzGraver", "EzGraver"};
+    settings.beginGroup(_settingsGroup);
+    settings.setValue("safeWait", _safeWait);
+    settings.setValue("failedWait", _failedWait);
+    settings.setValue("streak", _streak);
+}
+
+}
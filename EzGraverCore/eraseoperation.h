@@ -0,0 +1,154 @@
+#ifndef EZGRAVER_ERASEOPERATION_H
+#define EZGRAVER_ERASEOPERATION_H
+
+#include "ezgravercore_global.h"
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+
+#include <memory>
+
+#include "framedecoder.h"
+
+namespace Ez {
+
+struct EzGraver;
+
+/*!
+ * Erases the EEPROM of an engraver and signals as soon as it is ready to receive an image.
+ *
+ * Engravers reporting the end of the erase are awaited until they do so. For all others, the
+ * time to wait is learnt per device by dedicated calibration runs, see \a setCalibrating: it
+ * starts with the time recommended by the protocol and is lowered step by step as long as the
+ * uploads following it are engraved completely. An incomplete engraving, i.e. leading pixels
+ * lost during the erase, restores the last wait known to be sufficient. Regular erases never
+ * probe a shorter wait, they use the recommended one until a shorter one has been confirmed
+ * by calibration runs. The calibration is shared by all front-ends and kept across sessions.
+ *
+ * The owner of the connection has to connect \a EzGraver::frameDecoded to \a processFrame.
+ */
+class EZGRAVERCORESHARED_EXPORT EraseOperation : public QObject {
+    Q_OBJECT
+
+public:
+    /*! The time in milliseconds to await the engraver reporting the end of the erase. */
+    static int const ReadyTimeout{10000};
+
+    /*! The shortest wait the calibration may settle on, in milliseconds. */
+    static int const MinimumWait{20};
+
+    /*!
+     * Creates a new operation for the given \a engraver.
+     *
+     * \param engraver The engraver to erase.
+     * \param parent The parent of the operation.
+     */
+    explicit EraseOperation(std::shared_ptr<EzGraver> engraver, QObject* parent=NULL);
+
+    /*!
+     * Gets the time the next or currently running erase is expected to take.
+     *
+     * \return The expected time in milliseconds.
+     */
+    int expectedTime() const;
+
+    /*!
+     * Gets if an erase is in progress.
+     *
+     * \return \c true if the engraver is not ready yet.
+     */
+    bool running() const;
+
+    /*!
+     * Enables probing shorter waits with the subsequent erases. Only erases followed by an
+     * engraving whose result does not matter, e.g. a calibration pattern burnt into scrap
+     * material, may probe as the leading pixels of the upload are lost if the wait is too short.
+     *
+     * \param calibrating \c true if the subsequent erases are calibration runs.
+     */
+    void setCalibrating(bool calibrating);
+
+    /*!
+     * Gets if the subsequent erases probe shorter waits.
+     *
+     * \return \c true if the erases are calibration runs.
+     */
+    bool calibrating() const;
+
+    /*!
+     * Reports whether the image uploaded after the last erase has been engraved completely.
+     * Calibrates the wait of engravers not reporting the end of the erase, ignored otherwise.
+     *
+     * \param complete \c true if no pixel was lost.
+     */
+    void confirm(bool complete);
+
+public slots:
+    /*!
+     * Erases the EEPROM.
+     */
+    void start();
+
+    /*!
+     * Stops waiting for the erase to complete.
+     */
+    void cancel();
+
+    /*!
+     * Processes a frame received from the engraver.
+     *
+     * \param frame The decoded frame.
+     */
+    void processFrame(Ez::Frame const& frame);
+
+signals:
+    /*!
+     * Fired as soon as the engraver is ready to receive an image.
+     *
+     * \param elapsed The time in milliseconds the erase took.
+     */
+    void erased(qint64 elapsed);
+
+    /*!
+     * Fired if the engraver did not become ready.
+     *
+     * \param reason The reason of the failure.
+     */
+    void failed(QString const& reason);
+
+private:
+    enum class Phase {
+        Idle,
+        Transmitting,
+        Waiting,
+        AwaitingReady
+    };
+
+    std::shared_ptr<EzGraver> _engraver;
+    QString _settingsGroup;
+    Phase _phase{Phase::Idle};
+    QTimer _timer{this};
+    QFutureWatcher<void> _transmission{this};
+    QElapsedTimer _clock{};
+
+    int _recommended{0};
+    int _wait{0};
+    int _safeWait{0};
+    int _failedWait{0};
+    int _streak{0};
+    bool _unconfirmed{false};
+    bool _calibrating{false};
+
+    void _transmitted();
+    void _timeout();
+    void _finish();
+    void _load();
+    void _save() const;
+};
+
+}
+
+#endif // EZGRAVER_ERASEOPERATION_H
@@ -2,129 +2,234 @@
 
 #include <QSerialPort>
 #include <QSerialPortInfo>
+#include <QThread>
 #include <QDebug>
-#include <QBitmap>
-#include <QBuffer>
+#include <QMutexLocker>
+#include <QCryptographicHash>
 
 #include <iterator>
 #include <algorithm>
 #include <functional>
 
-#include "specifications.h"
+#include "imagepacker.h"
+#include "serialworker.h"
+#include "wiretrace.h"
+#include "factory.h"
 
 namespace Ez {
 
-EzGraver::EzGraver(std::shared_ptr<QSerialPort> serial) : _serial{serial} {}
-
-void EzGraver::start(unsigned char const& burnTime) {
-    _setBurnTime(burnTime);
-    qDebug() << "starting engrave process";
-    _transmit(0xF1);
+EzGraver::EzGraver(std::shared_ptr<QSerialPort> serial, int protocol)
+        : _spec(protocolSpec(protocol)), _serial{serial}, _worker{new SerialWorker{serial}} {
+    // Queued onto the thread of the instance, the only one using the decoder.
+    connect(_worker.get(), &SerialWorker::dataReceived, this, [this](QByteArray const& data) {
+        frameDecoder().feed(data, [this](Frame const& frame) { emit frameDecoded(frame); });
+        dataRecieved(data);
+    });
 }
 
-void EzGraver::_setBurnTime(unsigned char const& burnTime) {
-    if(burnTime < 0x01 || burnTime > 0xF0) {
-        throw new std::out_of_range("burntime out of range");
-    }
-    qDebug() << "setting burn time to:" << static_cast<int>(burnTime);
-    _transmit(burnTime);
+QFuture<void> EzGraver::start(unsigned char const& burnTime) {
+    qDebug() << "starting engrave process with burn time" << static_cast<int>(burnTime);
+    return _transmit(Command::Start, burnTime);
 }
 
-void EzGraver::pause() {
+QFuture<void> EzGraver::pause() {
     qDebug() << "pausing engrave process";
-    _transmit(0xF2);
+    return _transmit(Command::Pause);
 }
 
-void EzGraver::reset() {
+QFuture<void> EzGraver::reset() {
     qDebug() << "resetting";
-    _transmit(0xF9);
+    _invalidatePayload();
+    return _transmit(Command::Reset);
 }
 
-void EzGraver::home() {
+QFuture<void> EzGraver::home() {
     qDebug() << "moving to home";
-    _transmit(0xF3);
+    return _transmit(Command::Home);
 }
 
-void EzGraver::center() {
+QFuture<void> EzGraver::center() {
     qDebug() << "moving to center";
-    _transmit(0xFB);
+    return _transmit(Command::Center);
 }
 
-void EzGraver::preview() {
+QFuture<void> EzGraver::preview() {
     qDebug() << "drawing image preview";
-    _transmit(0xF4);
+    return _transmit(Command::Preview);
+}
+
+QFuture<void> EzGraver::up() {
+    qDebug() << "moving up";
+    return _transmit(Command::Up);
+}
+
+QFuture<void> EzGraver::down() {
+    qDebug() << "moving down";
+    return _transmit(Command::Down);
+}
+
+QFuture<void> EzGraver::left() {
+    qDebug() << "moving left";
+    return _transmit(Command::Left);
+}
+
+QFuture<void> EzGraver::right() {
+    qDebug() << "moving right";
+    return _transmit(Command::Right);
+}
+
+int EzGraver::protocol() const {
+    return _spec.protocol;
 }
 
 int EzGraver::erase() {
     qDebug() << "erasing EEPROM";
-    _transmit(QByteArray{8, '\xFE'});
-    return 6000;
+    _invalidatePayload();
+    _transmit(Command::Erase);
+    return _spec.eraseTime;
 }
 
 int EzGraver::uploadImage(QImage const& originalImage) {
     qDebug() << "converting image to bitmap";
-    QImage image{originalImage
-            .scaled(Ez::Specifications::ImageWidth, Ez::Specifications::ImageHeight)
-            .mirrored()
-            .convertToFormat(QImage::Format_Mono)};
-    image.invertPixels();
-
-    QByteArray bytes{};
-    QBuffer buffer{&bytes};
-    image.save(&buffer, "BMP");
-    return uploadImage(bytes);
+    return uploadImage(packImage(originalImage, payloadFormat()));
 }
 
 int EzGraver::uploadImage(QByteArray const& image) {
+    auto digest = QCryptographicHash::hash(image, QCryptographicHash::Sha1);
+    quint64 generation{0};
+    {
+        QMutexLocker lock{&_payloadMutex};
+        if(_payloadDigest == digest) {
+            qDebug() << "image already uploaded";
+            return 0;
+        }
+        _payloadDigest.clear();
+        generation = ++_payloadGeneration;
+    }
+
     qDebug() << "uploading image";
-    // Data is chunked in order to get at least some progress updates
+    // Data is chunked in order to only hand over as much as the line drains
     _transmit(image, 8192);
+
+    // The payload only counts as held once it has been transmitted without being invalidated meanwhile.
+    _worker->post([this, digest, generation](QSerialPort&) {
+        QMutexLocker lock{&_payloadMutex};
+        if(_payloadGeneration == generation) {
+            _payloadDigest = digest;
+        }
+    });
     return image.size();
 }
 
+bool EzGraver::holdsPayload(QByteArray const& payload) const {
+    QMutexLocker lock{&_payloadMutex};
+    return !_payloadDigest.isEmpty() && _payloadDigest == QCryptographicHash::hash(payload, QCryptographicHash::Sha1);
+}
+
+void EzGraver::_invalidatePayload() {
+    QMutexLocker lock{&_payloadMutex};
+    _payloadDigest.clear();
+    ++_payloadGeneration;
+}
+
+PayloadFormat EzGraver::payloadFormat() const {
+    return _spec.payloadFormat;
+}
+
+bool EzGraver::engravesAfterUpload() const {
+    return _spec.engravesAfterUpload;
+}
+
+bool EzGraver::reportsErased() const {
+    return _spec.reportsErased;
+}
+
+bool EzGraver::appliesBurnTime() const {
+    return _spec.appliesBurnTime;
+}
+
+QString EzGraver::deviceId() const {
+    return Ez::deviceId(_serial->portName());
+}
+
+NegotiationMetrics EzGraver::negotiationMetrics() const {
+    return NegotiationMetrics{};
+}
+
 void EzGraver::awaitTransmission(int msecs) {
-    _serial->waitForBytesWritten(msecs);
+    _worker->waitForIdle(msecs);
+}
+
+QFuture<void> EzGraver::setBaudRate(qint32 baudRate) {
+    qDebug() << "changing baud rate to" << baudRate;
+    return _worker->post([baudRate](QSerialPort& serial) {
+        serial.setBaudRate(baudRate, QSerialPort::AllDirections);
+    });
 }
 
 std::shared_ptr<QSerialPort> EzGraver::serialPort() {
     return _serial;
 }
 
-void EzGraver::_transmit(unsigned char const& data) {
-    _transmit(QByteArray{1, static_cast<char>(data)});
+SerialWorker* EzGraver::serialWorker() {
+    return _worker.get();
 }
 
-void EzGraver::_transmit(QByteArray const& data) {
-    qDebug() << "transmitting" << data.size() << "bytes:" << data.toHex();
-    _serial->write(data);
-    _serial->flush();
+FrameDecoder& EzGraver::frameDecoder() {
+    // Created lazily as the frame table depends on the protocol version.
+    if(!_decoder) {
+        _decoder.reset(new FrameDecoder{frameTable(protocol())});
+    }
+    return *_decoder;
 }
 
-void EzGraver::_transmit(QByteArray const& data, int chunkSize) {
-    qDebug() << "transmitting" << data.size() << "bytes in chunks of size" << chunkSize;
-    for(int i{0}; i < data.size(); i += chunkSize) {
-        _serial->write(data.mid(i, chunkSize));
-        _serial->flush();
-    }
+QFuture<void> EzGraver::_transmit(Command command, unsigned char burnTime) {
+    // Encoded on the stack, the only copy is the one handed over to the I/O thread.
+    unsigned char buffer[MaximumCommandSize];
+    auto size = encodeCommand(_spec, command, burnTime, buffer);
+    return _transmit(QByteArray{reinterpret_cast<char const*>(buffer), size});
+}
+
+QFuture<void> EzGraver::_transmit(QByteArray const& data) {
+    qDebug() << "transmitting" << data.size() << "bytes";
+    return _worker->write(data);
+}
+
+QFuture<void> EzGraver::_transmit(QByteArray const& data, int chunkSize) {
+    qDebug() << "transmitting" << data.size() << "bytes in chunks of at most" << chunkSize << "bytes";
+    return _worker->write(data, chunkSize);
 }
 
 void EzGraver::dataRecieved(QByteArray const& data) {
-    qDebug() << "EzGraver::received" << data.size() << "bytes:" << data.toHex();
+    Trace::rx(data);
+
+    // The protocols v1 to v3 share their frames, thus a valid answer merely supports a guess.
+    if(!_protocolGuessed && frameDecoder().decodedFrames() > 0) {
+        _protocolGuessed = true;
+        if(!_protocolConfirmed) {
+            guessProtocol(deviceId(), protocol());
+        }
+    }
+}
+
+void EzGraver::_confirmProtocol() {
+    if(!_protocolConfirmed) {
+        _protocolConfirmed = true;
+        rememberProtocol(deviceId(), protocol());
+    }
 }
 
-void EzGraver::sleep(int ms)
-{
-    struct timespec ts = { ms / 1000, (ms % 1000) * 1000 * 1000 };
-    nanosleep(&ts, NULL);
+QFuture<void> EzGraver::sleep(int ms) {
+    // Delays the subsequent commands only, the caller is not blocked.
+    return _worker->post([ms](QSerialPort&) { QThread::msleep(ms); });
 }
 
-void EzGraver::setBaudRate(qint32 baudRate){
-    _serial->setBaudRate(baudRate, QSerialPort::AllDirections);
+ProtocolSpec const& EzGraver::_protocolSpec() const {
+    return _spec;
 }
 
 EzGraver::~EzGraver() {
     qDebug() << "EzGraver is being destroyed, closing serial port";
-    _serial->close();
 }
 
 }
@@ -3,68 +3,131 @@
 
 #include "ezgravercore_global.h"
 
+#include <QObject>
 #include <QImage>
 #include <QSerialPort>
 #include <QSize>
+#include <QFuture>
+#include <QByteArray>
+#include <QString>
+#include <QMutex>
 
 #include <memory>
 
+#include "framedecoder.h"
+#include "imagepacker.h"
+#include "baudnegotiator.h"
+#include "protocolspec.h"
+
 namespace Ez {
+
+class SerialWorker;
+
 /*!
  * Allows accessing a NEJE engraver using the serial port it was instantiated with.
- * The connection is closed as soon as the object is destroyed.
+ * All communication happens on a dedicated I/O thread, none of the commands block.
+ * The connection is closed as soon as the object is destroyed. The commands are encoded
+ * according to the \a ProtocolSpec of the protocol version. The data received from the
+ * engraver is decoded on the thread the instance lives in and published by \a frameDecoded.
  */
-struct EZGRAVERCORESHARED_EXPORT EzGraver {
+struct EZGRAVERCORESHARED_EXPORT EzGraver : QObject {
+    Q_OBJECT
+
+public:
     /*!
      * Creates an instance of the EzGraver.
      *
      * \param serial The serial port to use.
+     * \param protocol The protocol version spoken by the engraver.
+     * \throws std::invalid_argument Thrown if the provided protocol code is unknown.
      */
-    explicit EzGraver(std::shared_ptr<QSerialPort> serial);
+    explicit EzGraver(std::shared_ptr<QSerialPort> serial, int protocol);
 
     /*!
      * Starts the engraving process with the given \a burnTime.
      *
      * \param burnTime The burn time to use in milliseconds.
+     * \return A future which finishes as soon as the command has been transmitted.
      */
-    virtual void start(unsigned char const& burnTime);
+    virtual QFuture<void> start(unsigned char const& burnTime);
 
     /*!
      * Pauses the engraving process at the given location. The process
      * can be continued by invoking start.
+     *
+     * \return A future which finishes as soon as the command has been transmitted.
      */
-    virtual void pause();
+    virtual QFuture<void> pause();
 
-    /*! Resets the engraver. */
-    virtual void reset();
+    /*!
+     * Resets the engraver.
+     *
+     * \return A future which finishes as soon as the command has been transmitted.
+     */
+    virtual QFuture<void> reset();
 
-    /*! Moves the engraver to the home position. */
-    virtual void home();
+    /*!
+     * Moves the engraver to the home position.
+     *
+     * \return A future which finishes as soon as the command has been transmitted.
+     */
+    virtual QFuture<void> home();
 
-    /*! Moves the engraver to the center. */
-    virtual void center();
+    /*!
+     * Moves the engraver to the center.
+     *
+     * \return A future which finishes as soon as the command has been transmitted.
+     */
+    virtual QFuture<void> center();
+
+    /*!
+     * Draws a preview of the currently loaded image.
+     *
+     * \return A future which finishes as soon as the command has been transmitted.
+     */
+    virtual QFuture<void> preview();
 
-    /*! Draws a preview of the currently loaded image. */
-    virtual void preview();
+    /*!
+     * Moves the engraver up.
+     *
+     * \return A future which finishes as soon as the command has been transmitted.
+     */
+    virtual QFuture<void> up();
 
-    /*! Moves the engraver up. */
-    virtual void up() = 0;
+    /*!
+     * Moves the engraver down.
+     *
+     * \return A future which finishes as soon as the command has been transmitted.
+     */
+    virtual QFuture<void> down();
 
-    /*! Moves the engraver down. */
-    virtual void down() = 0;
+    /*!
+     * Moves the engraver left.
+     *
+     * \return A future which finishes as soon as the command has been transmitted.
+     */
+    virtual QFuture<void> left();
 
-    /*! Moves the engraver left. */
-    virtual void left() = 0;
+    /*!
+     * Moves the engraver right.
+     *
+     * \return A future which finishes as soon as the command has been transmitted.
+     */
+    virtual QFuture<void> right();
 
-    /*! Moves the engraver right. */
-    virtual void right() = 0;
+    /*!
+     * Gets the protocol version spoken by the engraver.
+     *
+     * \return The protocol version.
+     */
+    int protocol() const;
 
     /*!
      * Erases the EEPROM of the engraver. This is necessary before uploading
      * any new image to it.
      * Erasing the EEPROM takes a while. Sending image data to early causes
      * that some of the leading pixels are lost. Waiting for about 5 seconds
-     * seems to be sufficient.
+     * seems to be sufficient. \a EraseOperation learns a shorter wait per device.
      *
      * \return The recommended time in ms to wait until uploading the image.
      */
@@ -83,6 +146,7 @@ struct EZGRAVERCORESHARED_EXPORT EzGraver {
     /*!
      * Uploads any given \a image byte array to the EEPROM. It has to be a monochrome
      * bitmap of the dimensions 512x512. Every white pixel is being engraved.
+     * Nothing is sent if the EEPROM already holds the very same payload, see \a holdsPayload.
      *
      * \param image The image byte array to upload to the EEPROM.
      * \return The number of bytes being sent to the device.
@@ -90,41 +154,147 @@ struct EZGRAVERCORESHARED_EXPORT EzGraver {
     int uploadImage(QByteArray const& image);
 
     /*!
-     * Waits until the current serial port buffer is fully written to the device.
+     * Gets if the EEPROM holds the given \a payload. A payload is held as soon as it has been
+     * fully transmitted, until the EEPROM is erased, the engraver is reset or anything else is
+     * uploaded. The state is tracked per instance, thus a new connection never holds a payload.
+     * If the payload is held, erasing and uploading can be skipped and the engraver started right away.
+     *
+     * \param payload The payload in the format of the engraver.
+     * \return \c true if the payload has been uploaded already.
+     */
+    bool holdsPayload(QByteArray const& payload) const;
+
+    /*!
+     * Gets the layout in which the engraver expects the image data.
+     *
+     * \return The payload format used by \a uploadImage.
+     */
+    virtual PayloadFormat payloadFormat() const;
+
+    /*!
+     * Gets if the engraver starts engraving on its own as soon as an image has been uploaded.
+     * Such engravers are prepared for an upload using \a start instead of \a erase.
+     *
+     * \return \c true if no separate start command is required after the upload.
+     */
+    virtual bool engravesAfterUpload() const;
+
+    /*!
+     * Gets if the engraver announces the end of an erase with an \a Frame::Type::UploadReady frame.
+     * Otherwise the time returned by \a erase has to be awaited, see \a EraseOperation.
+     *
+     * \return \c true if the engraver reports being ready to receive an image.
+     */
+    virtual bool reportsErased() const;
+
+    /*!
+     * Gets if the burn time passed to \a start is applied. Otherwise the engraver engraves with
+     * the burn time set on the device, e.g. all layers of a \a LayerJob share it.
+     *
+     * \return \c true if the engraver uses the burn time passed to \a start.
+     */
+    virtual bool appliesBurnTime() const;
+
+    /*!
+     * Gets an identifier of the connected device, stable across sessions, see \a Ez::deviceId.
+     *
+     * \return The identifier of the device.
+     */
+    QString deviceId() const;
+
+    /*!
+     * Gets the outcome of the last baud rate negotiation.
+     *
+     * \return The negotiation metrics, empty if the protocol uses a fixed baud rate.
+     */
+    virtual NegotiationMetrics negotiationMetrics() const;
+
+    /*!
+     * Waits until all commands issued so far have been fully written to the device.
      *
      * \param msecs The time in milliseconds to await the transmission to complete.
      */
     void awaitTransmission(int msecs=-1);
 
     /*!
-     * Gets the serialport used by the EzGraver instance.
+     * Changes the baud rate of the connection as soon as all previously issued
+     * commands have been transmitted.
+     *
+     * \param baudRate The baud rate to use.
+     * \return A future which finishes as soon as the baud rate has been changed.
+     */
+    QFuture<void> setBaudRate(qint32 baudRate);
+
+    /*!
+     * Gets the serialport used by the EzGraver instance. The port is owned by the
+     * I/O thread and must only be accessed through tasks posted to the serial worker.
      *
      * \return The serial port used.
      */
     std::shared_ptr<QSerialPort> serialPort();
 
     /*!
-     * Callback function to process data recieved from engraver.
+     * Gets the worker performing all I/O. It provides the received data, the data
+     * actually leaving the host and the measured throughput.
      *
-     * \param data Bytes read from serial.
+     * \return The serial worker used.
      */
-    virtual void dataRecieved(QByteArray const& data);
+    SerialWorker* serialWorker();
+
+    /*!
+     * Gets the decoder for the data received from the engraver. It must only be used
+     * by the thread the instance lives in, which feeds it with all received data.
+     *
+     * \return The frame decoder matching the protocol version.
+     */
+    FrameDecoder& frameDecoder();
 
 
     EzGraver() = delete;
     virtual ~EzGraver();
 
+signals:
+    /*!
+     * Fired for every frame decoded from the data received from the engraver.
+     *
+     * \param frame The decoded frame.
+     */
+    void frameDecoded(Ez::Frame const& frame);
+
 protected:
-    void _transmit(unsigned char const& data);
-    void _transmit(QByteArray const& data);
-    void _transmit(QByteArray const& data, int chunkSize);
-    void sleep(int ms);
-    void setBaudRate(qint32 baudRate);
+    /*!
+     * Callback function to process data recieved from engraver. Invoked after the data has
+     * been decoded and all of its frames have been published. The first decoded frame makes
+     * the protocol version a guess for the device, see \a guessProtocol.
+     *
+     * \param data Bytes read from serial.
+     */
+    virtual void dataRecieved(QByteArray const& data);
+
+    QFuture<void> _transmit(Command command, unsigned char burnTime=0);
+    QFuture<void> _transmit(QByteArray const& data);
+    QFuture<void> _transmit(QByteArray const& data, int chunkSize);
+    QFuture<void> sleep(int ms);
+    ProtocolSpec const& _protocolSpec() const;
+    void _invalidatePayload();
+
+    /*!
+     * Confirms the protocol version for the device, see \a rememberProtocol. To be invoked
+     * upon a frame only a device speaking the version sends.
+     */
+    void _confirmProtocol();
 
 private:
+    ProtocolSpec const& _spec;
     std::shared_ptr<QSerialPort> _serial;
+    std::unique_ptr<SerialWorker> _worker;
+    std::unique_ptr<FrameDecoder> _decoder;
 
-    void _setBurnTime(unsigned char const& burnTime);
+    mutable QMutex _payloadMutex{};
+    QByteArray _payloadDigest{};
+    quint64 _payloadGeneration{0};
+    bool _protocolGuessed{false};
+    bool _protocolConfirmed{false};
 };
 
 }
@@ -1,30 +0,0 @@
-#ifndef EZGRAVERV1_H
-#define EZGRAVERV1_H
-
-#include <QSerialPort>
-
-#include <memory>
-
-#include "ezgraver.h"
-
-namespace Ez {
-
-struct EzGraverV1 : EzGraver {
-    using EzGraver::EzGraver;
-
-    /*! Moves the engraver up. */
-    void up() override;
-
-    /*! Moves the engraver down. */
-    void down() override;
-
-    /*! Moves the engraver left. */
-    void left() override;
-
-    /*! Moves the engraver right. */
-    void right() override;
-};
-
-}
-
-#endif // EZGRAVERV1_H
@@ -2,111 +2,68 @@
 
 #include <QDebug>
 #include <QByteArray>
-#include <QBuffer>
-
-#include "specifications.h"
 
 namespace Ez {
 
-    void EzGraverV4::reset() {
-        qDebug() << "resetting";
-        _transmit(QByteArray::fromRawData("\xFF\x04\x01\x00", 4));
-    }
-
-    void EzGraverV4::pause() {
-        qDebug() << "pausing engrave process";
-        _transmit(QByteArray::fromRawData("\xFF\x01\x02\x00", 4));
+    EzGraverV4::EzGraverV4(std::shared_ptr<QSerialPort> serial) : EzGraver{serial, 4} {
+        // Only decoded after an erase request, no other protocol answers it with this frame.
+        connect(this, &EzGraver::frameDecoded, this, [this](Frame const& frame) {
+            if(frame.type == Frame::Type::UploadReady) {
+                _confirmProtocol();
+            }
+        });
     }
 
-    void EzGraverV4::home() {
-        qDebug() << "moving to home";
-        _transmit(QByteArray::fromRawData("\xFF\x0A\x00\x00", 4));
-        _transmit(QByteArray::fromRawData("\xFF\x0B\x00\x00", 4));
-    }
-
-
-    void EzGraverV4::center() {
-        qDebug() << "moving to center";
-        _transmit(QByteArray::fromRawData("\xFF\x02\x01\x00", 4));
-    }
-
-    void EzGraverV4::preview() {
-        qDebug() << "drawing image preview";
-        _transmit(QByteArray::fromRawData("\xFF\x02\x02\x00", 4));
-    }
-
-    void EzGraverV4::up() {
-        qDebug() << "moving up";
-        _transmit(QByteArray::fromRawData("\xFF\x03\x01\x00", 4));
-    }
-
-    void EzGraverV4::down() {
-        qDebug() << "moving down";
-        _transmit(QByteArray::fromRawData("\xFF\x03\x02\x00", 4));
-    }
-
-    void EzGraverV4::left() {
-        qDebug() << "moving left";
-        _transmit(QByteArray::fromRawData("\xFF\x03\x03\x00", 4));
-    }
-
-    void EzGraverV4::right() {
-        qDebug() << "moving right";
-        _transmit(QByteArray::fromRawData("\xFF\x03\x04\x00", 4));
-    }
-
-
-    void EzGraverV4::_setBurnTime(unsigned char const& burnTime) {
-        if(burnTime < 0x01 || burnTime > 0xF0) {
-            throw new std::out_of_range("burntime out of range");
+    QFuture<void> EzGraverV4::reset() {
+        if(_negotiator) {
+            _negotiator->cancel();
         }
-        qDebug() << "setting burn time to:" << static_cast<int>(burnTime);
-
-        QByteArray payload{"\xFF\x05?\x00", 4};
-        payload[2] = burnTime;
-        _transmit(payload);
+        return EzGraver::reset();
     }
 
-    // ============================================================
+    QFuture<void> EzGraverV4::start(unsigned char const& burnTime) {
+        qDebug() << "requesting upload mode";
+        // Entering the upload mode discards the image held so far.
+        _invalidatePayload();
 
-    void EzGraverV4::start(unsigned char const& burnTime) {
-        if (true) {
-            //@@ _setBurnTime(burnTime);
-            qDebug() << "requesting double speed";
-            _transmit(QByteArray::fromRawData("\xFF\x0E\x00\x01", 4));
-            sleep(10);
-            setBaudRate(QSerialPort::Baud115200);
-            sleep(10);
-            qDebug() << "requesting upload mode";
-            _transmit(QByteArray::fromRawData("\xFF\x06\x01\x01", 4));
-        } else {
-            qDebug() << "starting engrave process";
-            _transmit(QByteArray::fromRawData("\xFF\x01\x01\x00", 4));
+        if(appliesBurnTime()) {
+            // The device only understands the burn time with the rate it starts with.
+            setBaudRate(QSerialPort::Baud57600);
+            _transmit(Command::Start, burnTime);
         }
+        return _baudNegotiator().negotiate();
     }
 
     int EzGraverV4::erase() {
-        qDebug() << "erasing EEPROM";
-        _transmit(QByteArray::fromRawData("\xFF\x06\x01\x01", 4));
-        return 50;
+        frameDecoder().expect(Frame::Type::UploadReady);
+        return EzGraver::erase();
     }
 
-    int EzGraverV4::uploadImage(QImage const& originalImage) {
-        qDebug() << "converting image to bitmap";
-        QImage image{originalImage
-                .scaled(Ez::Specifications::ImageWidth, Ez::Specifications::ImageHeight)
-                .mirrored()
-                .convertToFormat(QImage::Format_Mono)};
-        QByteArray bytes{};
-        QBuffer buffer{&bytes};
-        image.save(&buffer, "BMP");
-
-        // protocol v4 neither needs the BMP header nor the invertion of the pixels.
-        return EzGraver::uploadImage(bytes.mid(62));
+    NegotiationMetrics EzGraverV4::negotiationMetrics() const {
+        return _negotiator ? _negotiator->metrics() : NegotiationMetrics{};
     }
 
     void EzGraverV4::dataRecieved(QByteArray const& data) {
-        //qDebug() << "EzGraverV4::received" << data.size() << "bytes:" << data.toHex();
+        EzGraver::dataRecieved(data);
+        if(_negotiator) {
+            _negotiator->dataReceived();
+        }
+    }
+
+    BaudNegotiator& EzGraverV4::_baudNegotiator() {
+        if(!_negotiator) {
+            // The device answers the upload mode request once it is ready, which confirms the requested speed.
+            auto transmit = [this](QByteArray const& data) { return _transmit(data); };
+            QVector<BaudRate> rates{
+                BaudRate{QSerialPort::Baud115200, QByteArray{"\xFF\x0E\x00\x01", 4}, QByteArray{"\xFF\x0E\x00\x00", 4}},
+                BaudRate{QSerialPort::Baud57600, QByteArray{}, QByteArray{}}
+            };
+            unsigned char erase[MaximumCommandSize];
+            auto size = encodeCommand(_protocolSpec(), Command::Erase, 0, erase);
+            _negotiator.reset(new BaudNegotiator{*this, transmit, rates, QByteArray{reinterpret_cast<char const*>(erase), size},
+                                                 Frame::Type::UploadReady, HandshakeTimeout});
+        }
+        return *_negotiator;
     }
 
 }
@@ -9,71 +9,61 @@
 
 namespace Ez {
 
+/*!
+ * Protocol v4 switches to a faster baud rate for the upload and starts engraving on its own
+ * once the image has been received. The remaining commands are described by its \a ProtocolSpec.
+ */
 struct EzGraverV4 : EzGraver {
-    using EzGraver::EzGraver;
-
     /*!
-     * Starts the engraving process with the given \a burnTime.
+     * Creates an instance speaking protocol v4.
      *
-     * \param burnTime The burn time to use in milliseconds.
+     * \param serial The serial port to use.
      */
-    void start(unsigned char const& burnTime) override;
+    explicit EzGraverV4(std::shared_ptr<QSerialPort> serial);
 
     /*!
-     * Pauses the engraving process at the given location. The process
-     * can be continued by invoking start.
+     * Requests the upload mode, the engraver starts engraving as soon as an image has been
+     * uploaded. Protocol v4 engraves with the burn time set on the device, the given one is
+     * ignored, see \a appliesBurnTime.
+     *
+     * \param burnTime The burn time, ignored by protocol v4.
+     * \return A future which finishes as soon as the upload mode has been requested.
      */
-    void pause() override;
-
-    /*! Resets the engraver. */
-    void reset() override;
-
-    /*! Moves the engraver to the home position. */
-    void home() override;
-
-    /*! Moves the engraver to the center. */
-    void center() override;
-
-    /*! Draws a preview of the currently loaded image. */
-    void preview() override;
-
-    /*! Moves the engraver up. */
-    void up() override;
+    QFuture<void> start(unsigned char const& burnTime) override;
 
-    /*! Moves the engraver down. */
-    void down() override;
-
-    /*! Moves the engraver left. */
-    void left() override;
-
-    /*! Moves the engraver right. */
-    void right() override;
+    /*!
+     * Resets the engraver and cancels a pending baud rate negotiation.
+     *
+     * \return A future which finishes as soon as the command has been transmitted.
+     */
+    QFuture<void> reset() override;
 
     /*!
      * Erases the EEPROM of the engraver. This is necessary before uploading
-     * any new image to it.
-     * Erasing the EEPROM takes a while. Sending image data to early causes
-     * that some of the leading pixels are lost. Waiting for about 5 seconds
-     * seems to be sufficient.
+     * any new image to it. The engraver answers with an \a Frame::Type::UploadReady
+     * frame as soon as it is ready to receive the image.
      *
      * \return The recommended time in ms to wait until uploading the image.
      */
     int erase() override;
 
     /*!
-     * Uploads the given \a image to the EEPROM. It is mandatory to use \a erase()
-     * it prior uploading an image. The image will automatically be scaled, inverted,
-     * mirrored and converted to a monochrome bitmap.
+     * Gets the outcome of the last baud rate negotiation performed when requesting the upload mode.
      *
-     * \param image The image to upload to the EEPROM for engraving.
-     * \return The number of bytes being sent to the device.
+     * \return The negotiation metrics.
      */
-    int uploadImage(QImage const& image) override;
+    NegotiationMetrics negotiationMetrics() const override;
 
+protected:
     void dataRecieved(QByteArray const& data) override;
 
 private:
-    void _setBurnTime(unsigned char const& burnTime);
+    /*! The time in ms to await the upload mode being acknowledged before falling back to a slower baud rate. */
+    static int const HandshakeTimeout{1000};
+
+    std::unique_ptr<BaudNegotiator> _negotiator{};
+
+    BaudNegotiator& _baudNegotiator();
 };
 
 }
@@ -3,19 +3,56 @@
 #include <QString>
 #include <QSerialPort>
 #include <QSerialPortInfo>
+#include <QSettings>
+#include <QUrl>
 #include <QDebug>
 
 #include <stdexcept>
 
 #include "ezgraver.h"
-#include "ezgraver_v1.h"
-#include "ezgraver_v2.h"
-#include "ezgraver_v3.h"
 #include "ezgraver_v4.h"
 
 namespace Ez {
 
+namespace {
+
+QString const ProtocolCacheGroup{"DetectedProtocols"};
+QString const GuessCacheGroup{"GuessedProtocols"};
+
+QString portId(QSerialPortInfo const& port, QString const& portName) {
+    if(!port.serialNumber().isEmpty()) {
+        return port.serialNumber();
+    }
+    if(port.hasVendorIdentifier() && port.hasProductIdentifier()) {
+        return QString{"%1:%2@%3"}.arg(port.vendorIdentifier(), 4, 16, QChar{'0'})
+                .arg(port.productIdentifier(), 4, 16, QChar{'0'}).arg(portName);
+    }
+    return portName;
+}
+
+QString settingsKey(QString const& deviceId, QString const& group = ProtocolCacheGroup) {
+    return group + "/" + QString::fromLatin1(QUrl::toPercentEncoding(deviceId));
+}
+
+int cachedProtocol(QSettings const& settings, QString const& deviceId, QString const& group) {
+    auto protocol = settings.value(settingsKey(deviceId, group), AutoDetect).toInt();
+    return protocols().contains(protocol) ? protocol : AutoDetect;
+}
+
+}
+
 std::shared_ptr<EzGraver> create(QString const& portName, int protocol) {
+    if(protocol == AutoDetect) {
+        protocol = detectProtocol(portName);
+        if(protocol == AutoDetect) {
+            protocol = guessedProtocol(portName);
+        }
+        if(protocol == AutoDetect) {
+            qDebug() << "protocol of the device on port" << portName << "is unknown, using version" << DefaultProtocol;
+            protocol = DefaultProtocol;
+        }
+    }
+
     qDebug() << "instantiating EzGraver on port" << portName << "with protocol version" << protocol;
 
     std::shared_ptr<QSerialPort> serial{new QSerialPort(portName)};
@@ -30,18 +67,71 @@ std::shared_ptr<EzGraver> create(QString const& portName, int protocol) {
         throw std::runtime_error{QString{"failed to connect to port %1 (%2)"}.arg(portName, serial->errorString()).toStdString()};
     }
 
-    switch(protocol) {
-    case 1:
-        return std::make_shared<EzGraverV1>(serial);
-    case 2:
-        return std::make_shared<EzGraverV2>(serial);
-    case 3:
-        return std::make_shared<EzGraverV3>(serial);
-    case 4:
-        return std::make_shared<EzGraverV4>(serial);    
-    default:
-        throw std::invalid_argument{QString{"unsupported protocol '%1' selected"}.arg(protocol).toStdString()};
+    // Only protocol v4 needs more than its protocol description, see ProtocolSpec.
+    if(protocol == 4) {
+        return std::make_shared<EzGraverV4>(serial);
     }
+    return std::make_shared<EzGraver>(serial, protocol);
+}
+
+QString deviceId(QString const& portName) {
+    return portId(QSerialPortInfo{portName}, portName);
+}
+
+int detectProtocol(QString const& portName) {
+    return detectProtocols(QStringList{portName}).value(portName, AutoDetect);
+}
+
+QHash<QString, int> detectProtocols(QStringList const& portNames) {
+    QHash<QString, QSerialPortInfo> attached{};
+    for(auto const& port : QSerialPortInfo::availablePorts()) {
+        attached.insert(port.portName(), port);
+        attached.insert(port.systemLocation(), port);
+    }
+
+    QSettings settings{"EzGraver", "EzGraver"};
+    QHash<QString, int> result{};
+    for(auto const& portName : portNames) {
+        auto id = portId(attached.value(portName), portName);
+        result.insert(portName, cachedProtocol(settings, id, ProtocolCacheGroup));
+        qDebug() << "detected protocol" << result.value(portName) << "for device" << id << "on port" << portName;
+    }
+    return result;
+}
+
+int guessedProtocol(QString const& portName) {
+    QSettings settings{"EzGraver", "EzGraver"};
+    auto id = deviceId(portName);
+    auto protocol = cachedProtocol(settings, id, GuessCacheGroup);
+    qDebug() << "guessed protocol" << protocol << "for device" << id << "on port" << portName;
+    return protocol;
+}
+
+void rememberProtocol(QString const& deviceId, int protocol) {
+    QSettings settings{"EzGraver", "EzGraver"};
+    settings.remove(settingsKey(deviceId, GuessCacheGroup));
+    if(settings.value(settingsKey(deviceId)).toInt() != protocol) {
+        qDebug() << "remembering protocol" << protocol << "for device" << deviceId;
+        settings.setValue(settingsKey(deviceId), protocol);
+    }
+}
+
+void guessProtocol(QString const& deviceId, int protocol) {
+    QSettings settings{"EzGraver", "EzGraver"};
+    if(settings.contains(settingsKey(deviceId))) {
+        return;
+    }
+    if(settings.value(settingsKey(deviceId, GuessCacheGroup)).toInt() != protocol) {
+        qDebug() << "guessing protocol" << protocol << "for device" << deviceId;
+        settings.setValue(settingsKey(deviceId, GuessCacheGroup), protocol);
+    }
+}
+
+void forgetProtocol(QString const& deviceId) {
+    qDebug() << "forgetting the protocol of device" << deviceId;
+    QSettings settings{"EzGraver", "EzGraver"};
+    settings.remove(settingsKey(deviceId));
+    settings.remove(settingsKey(deviceId, GuessCacheGroup));
 }
 
 QList<int> protocols() {
@@ -6,6 +6,7 @@
 #include <QString>
 #include <QList>
 #include <QStringList>
+#include <QHash>
 
 #include <memory>
 
@@ -13,16 +14,89 @@
 
 namespace Ez {
 
+/*! Selects the protocol version of the connected device, see \a detectProtocol. */
+int const AutoDetect{0};
+
+/*! The protocol version used if the one of the device is unknown. */
+int const DefaultProtocol{1};
+
 /*!
  * Creates an instance and connects to the given \a portName.
  *
  * \param portName The port the connection should be established to.
- * \param protocol The protocol version to use.
+ * \param protocol The protocol version to use, or \a AutoDetect to use the one detected for the
+ *        device. Devices not detected use the version guessed for them, see \a guessedProtocol,
+ *        and fall back to \a DefaultProtocol.
  * \return An instance of the EzGraver as a shared pointer.
  * \throws std::runtime_error Thrown if no connection to the specified port could be established.
  * \throws std::invalid_argument Thrown if the provided protocol code is unknown.
  */
-EZGRAVERCORESHARED_EXPORT std::shared_ptr<EzGraver> create(QString const& portName, int protocol = 1);
+EZGRAVERCORESHARED_EXPORT std::shared_ptr<EzGraver> create(QString const& portName, int protocol = AutoDetect);
+
+/*!
+ * Gets an identifier of the device attached to the given \a portName, stable across sessions.
+ * It is the USB serial number if available, the vendor and product identifiers along with the
+ * port otherwise.
+ *
+ * \param portName The port of the device.
+ * \return The identifier of the device.
+ */
+EZGRAVERCORESHARED_EXPORT QString deviceId(QString const& portName);
+
+/*!
+ * Detects the protocol version of the device attached to the given \a portName. None of the
+ * protocols provides a query answered without side effects, thus the version is the one that
+ * has been confirmed for the device before, see \a rememberProtocol. The port is not opened.
+ *
+ * \param portName The port of the device.
+ * \return The protocol version, or \a AutoDetect if it is unknown.
+ */
+EZGRAVERCORESHARED_EXPORT int detectProtocol(QString const& portName);
+
+/*!
+ * Detects the protocol versions of the devices attached to all given \a portNames at once.
+ * The attached devices are enumerated a single time regardless of the number of ports.
+ *
+ * \param portNames The ports of the devices.
+ * \return The protocol version of every port, \a AutoDetect if it is unknown.
+ */
+EZGRAVERCORESHARED_EXPORT QHash<QString, int> detectProtocols(QStringList const& portNames);
+
+/*!
+ * Gets the protocol version guessed for the device attached to the given \a portName. Unlike
+ * a detected version, the guess has not been proven by an answer only the version provokes.
+ *
+ * \param portName The port of the device.
+ * \return The protocol version, or \a AutoDetect if there is no guess.
+ */
+EZGRAVERCORESHARED_EXPORT int guessedProtocol(QString const& portName);
+
+/*!
+ * Records the protocol version confirmed for a device. Engravers do so on their own as soon
+ * as the device sent a frame specific to their version, which only protocol v4 provides.
+ *
+ * \param deviceId The identifier of the device as returned by \a deviceId.
+ * \param protocol The protocol version spoken by the device.
+ */
+EZGRAVERCORESHARED_EXPORT void rememberProtocol(QString const& deviceId, int protocol);
+
+/*!
+ * Records a protocol version the device answered with a valid frame. The protocols v1 to v3
+ * share their frames, thus an answer does not prove the version, see \a guessedProtocol.
+ * Versions confirmed for the device before are kept.
+ *
+ * \param deviceId The identifier of the device as returned by \a deviceId.
+ * \param protocol The protocol version the device answered.
+ */
+EZGRAVERCORESHARED_EXPORT void guessProtocol(QString const& deviceId, int protocol);
+
+/*!
+ * Forgets the confirmed and guessed protocol versions of a device, to be invoked once the user
+ * picked the version manually.
+ *
+ * \param deviceId The identifier of the device as returned by \a deviceId.
+ */
+EZGRAVERCORESHARED_EXPORT void forgetProtocol(QString const& deviceId);
 
 /*!
  * Gets the available protocols.
@@ -0,0 +1,220 @@
+#include "farm.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "imagepacker.h"
+#include "serialworker.h"
+
+namespace Ez {
+
+Farm::Farm(QObject* parent) : QObject{parent} {}
+
+Farm::~Farm() {}
+
+int Farm::addEngraver(std::shared_ptr<EzGraver> engraver, QString const& name) {
+    auto index = static_cast<int>(_engravers.size());
+    std::unique_ptr<Engraver> entry{new Engraver{name, engraver, std::unique_ptr<LayerJob>{new LayerJob{engraver}}, QList<Entry>{}, nullptr}};
+    auto layerJob = entry->layerJob.get();
+    _engravers.push_back(std::move(entry));
+
+    connect(layerJob, &LayerJob::layerFinished, this, [this, index](LayerTiming const& timing) {
+        auto const& current = _engravers[index]->current;
+        if(!timing.skipped) {
+            _statistics.engravedPixels += timing.pixels;
+        }
+        emit layerFinished(current ? current->id : -1, index, timing);
+    });
+    connect(layerJob, &LayerJob::finished, this, [this, index] { _finished(index, false); });
+    connect(layerJob, &LayerJob::failed, this, [this, index](QString const& reason) {
+        qDebug() << "engraver" << _engravers[index]->name << "failed:" << reason;
+        _finished(index, true);
+    });
+
+    // Every engraver decodes its frames on its own as the protocol versions may differ.
+    connect(engraver.get(), &EzGraver::frameDecoded, this, [this, index](Frame const& frame) {
+        _engravers[index]->layerJob->processFrame(frame);
+    });
+    connect(engraver->serialWorker(), &SerialWorker::drained, this, [this](qint64 bytes) {
+        _statistics.uploadedBytes += bytes;
+    });
+
+    // A new engraver starts off by stealing queued work from the others.
+    _steal(index);
+    return index;
+}
+
+int Farm::engraverCount() const {
+    return static_cast<int>(_engravers.size());
+}
+
+QString Farm::engraverName(int engraver) const {
+    return _engravers.at(engraver)->name;
+}
+
+int Farm::submit(QVector<JobLayer> const& layers, QList<int> const& engravers) {
+    if(_engravers.empty()) {
+        throw std::runtime_error{"no engraver available"};
+    }
+    for(auto engraver : engravers) {
+        if(engraver < 0 || engraver >= engraverCount()) {
+            throw std::invalid_argument{QString{"unknown engraver '%1'"}.arg(engraver).toStdString()};
+        }
+    }
+    if(!_clock.isValid()) {
+        _clock.start();
+    }
+
+    std::shared_ptr<SharedJob> job{new SharedJob{_nextJob++, layers, QHash<int, QVector<QByteArray>>{}}};
+    if(engravers.isEmpty()) {
+        _engravers[_shortestQueue()]->queue.append(Entry{job, false});
+    } else {
+        for(auto engraver : engravers) {
+            _engravers[engraver]->queue.append(Entry{job, true});
+        }
+    }
+
+    // Idle engravers pick up the job right away, even if it was queued behind a busy one.
+    for(int engraver{0}; engraver < engraverCount(); ++engraver) {
+        _dispatch(engraver);
+    }
+    return job->id;
+}
+
+void Farm::cancel() {
+    for(auto& engraver : _engravers) {
+        engraver->queue.clear();
+    }
+    for(auto& engraver : _engravers) {
+        engraver->layerJob->cancel();
+    }
+}
+
+FarmStatistics Farm::statistics() const {
+    auto statistics = _statistics;
+    statistics.engravers = engraverCount();
+    statistics.elapsed = _clock.isValid() ? _clock.elapsed() : 0;
+    for(auto const& engraver : _engravers) {
+        statistics.busyEngravers += engraver->current ? 1 : 0;
+        statistics.queuedJobs += engraver->queue.size();
+        statistics.throughput += engraver->engraver->serialWorker()->throughput();
+    }
+    return statistics;
+}
+
+void Farm::_dispatch(int engraver) {
+    auto& entry = _engravers[engraver];
+    if(entry->current) {
+        return;
+    }
+
+    if(!entry->queue.isEmpty()) {
+        _run(engraver, entry->queue.takeFirst());
+    } else {
+        _steal(engraver);
+    }
+}
+
+bool Farm::_steal(int engraver) {
+    // The victim is the engraver with the most jobs which may be run by anyone.
+    int victim{-1};
+    int victimLoad{0};
+    for(int other{0}; other < engraverCount(); ++other) {
+        auto const& queue = _engravers[other]->queue;
+        auto load = static_cast<int>(std::count_if(queue.cbegin(), queue.cend(), [](Entry const& entry) { return !entry.pinned; }));
+        if(other != engraver && load > victimLoad) {
+            victim = other;
+            victimLoad = load;
+        }
+    }
+    if(victim < 0) {
+        return false;
+    }
+
+    // Taking from the back leaves the jobs the victim gets to next untouched.
+    auto& queue = _engravers[victim]->queue;
+    for(int i{queue.size() - 1}; i >= 0; --i) {
+        if(!queue[i].pinned) {
+            auto entry = queue.takeAt(i);
+            ++_statistics.stolenJobs;
+            qDebug() << "engraver" << _engravers[engraver]->name << "stole job" << entry.job->id << "from" << _engravers[victim]->name;
+            _run(engraver, entry);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Farm::_run(int engraver, Entry const& entry) {
+    auto& target = _engravers[engraver];
+    target->current = entry.job;
+
+    auto layers = entry.job->layers;
+    auto const& payloads = _payloads(*entry.job, target->engraver->payloadFormat());
+    for(int i{0}; i < layers.size(); ++i) {
+        layers[i].payload = payloads[i];
+    }
+
+    emit jobStarted(entry.job->id, engraver);
+    target->layerJob->setLayers(layers);
+    target->layerJob->start();
+}
+
+void Farm::_finished(int engraver, bool failed) {
+    auto& entry = _engravers[engraver];
+    if(!entry->current) {
+        return;
+    }
+
+    auto id = entry->current->id;
+    entry->current.reset();
+    if(failed) {
+        ++_statistics.failedJobs;
+    } else {
+        ++_statistics.finishedJobs;
+    }
+    emit jobFinished(id, engraver, failed);
+    _dispatch(engraver);
+    if(_idle()) {
+        emit idle();
+    }
+}
+
+QVector<QByteArray> const& Farm::_payloads(SharedJob& job, PayloadFormat format) {
+    // Payloads are implicitly shared, every engraver of the same format uploads the same buffers.
+    auto& payloads = job.payloads[static_cast<int>(format)];
+    if(payloads.size() != job.layers.size()) {
+        payloads.clear();
+        for(auto const& layer : job.layers) {
+            payloads.append(LayerJob::engravedPixels(layer.image) > 0 ? packImage(layer.image, format) : QByteArray{});
+        }
+        ++_statistics.packedPayloads;
+    }
+    return payloads;
+}
+
+int Farm::_shortestQueue() const {
+    int shortest{-1};
+    int shortestLoad{0};
+    for(int engraver{0}; engraver < engraverCount(); ++engraver) {
+        auto load = _engravers[engraver]->queue.size() + (_engravers[engraver]->current ? 1 : 0);
+        if(shortest < 0 || load < shortestLoad) {
+            shortest = engraver;
+            shortestLoad = load;
+        }
+    }
+    return shortest;
+}
+
+bool Farm::_idle() const {
+    for(auto const& engraver : _engravers) {
+        if(engraver->current || !engraver->queue.isEmpty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,198 @@
+#ifndef EZGRAVER_FARM_H
+#define EZGRAVER_FARM_H
+
+#include "ezgravercore_global.h"
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include <memory>
+#include <vector>
+
+#include "ezgraver.h"
+#include "layerjob.h"
+
+namespace Ez {
+
+/*!
+ * Aggregated figures of all engravers of a farm.
+ */
+struct EZGRAVERCORESHARED_EXPORT FarmStatistics {
+    /*! The number of engravers. */
+    int engravers{0};
+
+    /*! The number of engravers currently running a job. */
+    int busyEngravers{0};
+
+    /*! The number of jobs waiting for an engraver. */
+    int queuedJobs{0};
+
+    /*! The number of jobs done. */
+    int finishedJobs{0};
+
+    /*! The number of jobs aborted. */
+    int failedJobs{0};
+
+    /*! The number of jobs run by an engraver other than the one they were queued for. */
+    int stolenJobs{0};
+
+    /*! The number of times a job has been packed, engravers sharing a payload format share the packed job. */
+    int packedPayloads{0};
+
+    /*! The number of bytes sent to all engravers. */
+    qint64 uploadedBytes{0};
+
+    /*! The number of pixels engraved by all engravers. */
+    qint64 engravedPixels{0};
+
+    /*! The current throughput on the wire of all engravers in bytes per second. */
+    double throughput{0};
+
+    /*! The time in milliseconds since the first job has been submitted. */
+    qint64 elapsed{0};
+};
+
+/*!
+ * Drives several engravers from a single process. Every engraver keeps its own I/O thread,
+ * thus the ports are served concurrently. Jobs are queued per engraver, an engraver running
+ * out of work steals jobs from the back of the longest queue. A job submitted to several
+ * engravers is packed once per payload format and the payload is shared among them.
+ */
+class EZGRAVERCORESHARED_EXPORT Farm : public QObject {
+    Q_OBJECT
+
+public:
+    /*!
+     * Creates a new farm without any engraver.
+     *
+     * \param parent The parent of the farm.
+     */
+    explicit Farm(QObject* parent=NULL);
+
+    /*!
+     * Frees all required resources upon deconstruction.
+     */
+    virtual ~Farm();
+
+    /*!
+     * Adds the given \a engraver to the farm. It immediately takes part in processing the queued jobs.
+     *
+     * \param engraver The engraver to add.
+     * \param name The name used to identify the engraver, e.g. its port.
+     * \return The index of the engraver.
+     */
+    int addEngraver(std::shared_ptr<EzGraver> engraver, QString const& name=QString{});
+
+    /*!
+     * Gets the number of engravers.
+     *
+     * \return The number of engravers.
+     */
+    int engraverCount() const;
+
+    /*!
+     * Gets the name of the given \a engraver.
+     *
+     * \param engraver The index of the engraver.
+     * \return The name given when adding the engraver.
+     */
+    QString engraverName(int engraver) const;
+
+    /*!
+     * Queues a job. Without any \a engravers, the job is run once by whichever engraver gets
+     * to it first. Otherwise every listed engraver runs it, and these copies cannot be stolen.
+     *
+     * \param layers The layers of the job.
+     * \param engravers The indices of the engravers which have to run the job.
+     * \return The identifier of the job, identifiers are assigned consecutively starting at 0.
+     * \throws std::runtime_error Thrown if the farm does not have any engraver.
+     * \throws std::invalid_argument Thrown if an engraver index is unknown.
+     */
+    int submit(QVector<JobLayer> const& layers, QList<int> const& engravers=QList<int>{});
+
+    /*!
+     * Drops all queued jobs and aborts the running ones.
+     */
+    void cancel();
+
+    /*!
+     * Gets the aggregated figures of all engravers.
+     *
+     * \return The statistics of the farm.
+     */
+    FarmStatistics statistics() const;
+
+signals:
+    /*!
+     * Fired as soon as an engraver starts a job.
+     *
+     * \param job The identifier of the job.
+     * \param engraver The index of the engraver.
+     */
+    void jobStarted(int job, int engraver);
+
+    /*!
+     * Fired as soon as an engraver is done with a layer of a job.
+     *
+     * \param job The identifier of the job.
+     * \param engraver The index of the engraver.
+     * \param timing The time spent on the layer.
+     */
+    void layerFinished(int job, int engraver, Ez::LayerTiming const& timing);
+
+    /*!
+     * Fired as soon as an engraver is done with a job.
+     *
+     * \param job The identifier of the job.
+     * \param engraver The index of the engraver.
+     * \param failed \c true if the job has been aborted.
+     */
+    void jobFinished(int job, int engraver, bool failed);
+
+    /*!
+     * Fired as soon as all queues are empty and no engraver is busy anymore.
+     */
+    void idle();
+
+private:
+    struct SharedJob {
+        int id;
+        QVector<JobLayer> layers;
+        QHash<int, QVector<QByteArray>> payloads;
+    };
+
+    struct Entry {
+        std::shared_ptr<SharedJob> job;
+        bool pinned;
+    };
+
+    struct Engraver {
+        QString name;
+        std::shared_ptr<EzGraver> engraver;
+        std::unique_ptr<LayerJob> layerJob;
+        QList<Entry> queue;
+        std::shared_ptr<SharedJob> current;
+    };
+
+    std::vector<std::unique_ptr<Engraver>> _engravers{};
+    int _nextJob{0};
+    FarmStatistics _statistics{};
+    QElapsedTimer _clock{};
+
+    void _dispatch(int engraver);
+    bool _steal(int engraver);
+    void _run(int engraver, Entry const& entry);
+    void _finished(int engraver, bool failed);
+    QVector<QByteArray> const& _payloads(SharedJob& job, PayloadFormat format);
+    int _shortestQueue() const;
+    bool _idle() const;
+};
+
+}
+
+#endif // EZGRAVER_FARM_H
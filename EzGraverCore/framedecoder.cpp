@@ -0,0 +1,110 @@
+#include "framedecoder.h"
+
+#include <QString>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Ez {
+
+int const FrameDecoder::MaximumFrameSize;
+
+namespace {
+
+// Each coordinate is sent as two decimal digits, hence no payload byte exceeds 99.
+FrameSpec const ProgressFrame{Frame::Type::Progress, 5, {0xFF}, 1, 100, false};
+
+// Shares its prefix with a progress report of the pixels x=501..511 and y=100..199.
+FrameSpec const UploadReadyFrame{Frame::Type::UploadReady, 4, {0xFF, 0x05, 0x01, 0x01}, 4, 0, true};
+
+FrameSpec const ProgressFrames[]{ProgressFrame};
+FrameSpec const V4Frames[]{UploadReadyFrame, ProgressFrame};
+
+}
+
+FrameTable frameTable(int protocol) {
+    switch(protocol) {
+    case 1:
+    case 2:
+    case 3:
+        return FrameTable{ProgressFrames, 1};
+    case 4:
+        return FrameTable{V4Frames, 2};
+    default:
+        throw std::invalid_argument{QString{"unsupported protocol '%1' selected"}.arg(protocol).toStdString()};
+    }
+}
+
+FrameDecoder::FrameDecoder(FrameTable const& table) : _table(table) {}
+
+bool FrameDecoder::push(unsigned char byte, Frame& frame) {
+    _buffer[_size++] = byte;
+
+    forever {
+        bool partial{false};
+        for(int i{0}; i < _table.size; ++i) {
+            auto const& spec = _table.specs[i];
+            auto match = _match(spec);
+            if(match == Match::Partial) {
+                partial = true;
+            } else if(match == Match::Complete) {
+                frame.type = spec.type;
+                if(spec.type == Frame::Type::Progress) {
+                    frame.position = QPoint{_buffer[1] * 100 + _buffer[2], _buffer[3] * 100 + _buffer[4]};
+                }
+                _announced &= ~(1u << static_cast<int>(spec.type));
+                ++_decoded;
+                _size = 0;
+                return true;
+            }
+        }
+
+        if(partial || _size == 0) {
+            return false;
+        }
+
+        // Out of sync, retry starting with the next byte.
+        std::copy(_buffer + 1, _buffer + _size, _buffer);
+        --_size;
+    }
+}
+
+void FrameDecoder::expect(Frame::Type type) {
+    _announced |= 1u << static_cast<int>(type);
+}
+
+bool FrameDecoder::expecting(Frame::Type type) const {
+    return _isAnnounced(type);
+}
+
+void FrameDecoder::reset() {
+    _size = 0;
+    _announced = 0;
+}
+
+quint64 FrameDecoder::decodedFrames() const {
+    return _decoded;
+}
+
+FrameDecoder::Match FrameDecoder::_match(FrameSpec const& spec) const {
+    if(spec.announced && !_isAnnounced(spec.type)) {
+        return Match::None;
+    }
+    if(_size > spec.size) {
+        return Match::None;
+    }
+
+    for(int i{0}; i < _size; ++i) {
+        auto valid = i < spec.prefixSize ? _buffer[i] == spec.prefix[i] : _buffer[i] < spec.payloadLimit;
+        if(!valid) {
+            return Match::None;
+        }
+    }
+    return _size == spec.size ? Match::Complete : Match::Partial;
+}
+
+bool FrameDecoder::_isAnnounced(Frame::Type type) const {
+    return (_announced & (1u << static_cast<int>(type))) != 0;
+}
+
+}
@@ -0,0 +1,167 @@
+#ifndef EZGRAVER_FRAMEDECODER_H
+#define EZGRAVER_FRAMEDECODER_H
+
+#include "ezgravercore_global.h"
+
+#include <QByteArray>
+#include <QPoint>
+#include <QMetaType>
+
+namespace Ez {
+
+/*!
+ * A packet received from the engraver.
+ */
+struct EZGRAVERCORESHARED_EXPORT Frame {
+    /*! The kinds of packets sent by the engravers. */
+    enum class Type : quint8 {
+        /*! A pixel has been engraved (FF x/100 x%100 y/100 y%100). */
+        Progress,
+
+        /*! The device is ready to receive an image (FF 05 01 01, protocol v4). */
+        UploadReady
+    };
+
+    /*! The kind of the packet. */
+    Type type{Type::Progress};
+
+    /*! The engraved pixel of a progress packet. */
+    QPoint position{};
+};
+
+/*!
+ * Describes the layout of a single frame type.
+ */
+struct EZGRAVERCORESHARED_EXPORT FrameSpec {
+    /*! The type of the frame described. */
+    Frame::Type type;
+
+    /*! The total size of the frame in bytes. */
+    quint8 size;
+
+    /*! The fixed leading bytes of the frame. */
+    quint8 prefix[4];
+
+    /*! The number of fixed leading bytes. */
+    quint8 prefixSize;
+
+    /*! The upper bound (exclusive) of every byte following the prefix. */
+    quint16 payloadLimit;
+
+    /*! Only matched while the frame has been announced by \a FrameDecoder::expect. */
+    bool announced;
+};
+
+/*!
+ * The frames a protocol version may send, ordered by precedence.
+ */
+struct EZGRAVERCORESHARED_EXPORT FrameTable {
+    /*! The first frame specification. */
+    FrameSpec const* specs;
+
+    /*! The number of frame specifications. */
+    int size;
+};
+
+/*!
+ * Gets the frames sent by the given \a protocol version.
+ *
+ * \param protocol The protocol version.
+ * \return The frame table of the protocol.
+ * \throws std::invalid_argument Thrown if the provided protocol code is unknown.
+ */
+EZGRAVERCORESHARED_EXPORT FrameTable frameTable(int protocol);
+
+/*!
+ * Decodes the byte stream received from an engraver into frames. The stream may be split
+ * or coalesced arbitrarily, incomplete frames are completed by subsequently pushed bytes.
+ * Bytes not belonging to any frame are skipped until the stream is in sync again.
+ * Decoding does not allocate any memory.
+ */
+class EZGRAVERCORESHARED_EXPORT FrameDecoder {
+public:
+    /*! The size of the largest frame supported. */
+    static int const MaximumFrameSize{8};
+
+    /*!
+     * Creates a new instance decoding the frames of the given \a table.
+     *
+     * \param table The frames to decode.
+     */
+    explicit FrameDecoder(FrameTable const& table);
+
+    /*!
+     * Pushes a single received byte.
+     *
+     * \param byte The received byte.
+     * \param frame Receives the completed frame, if any.
+     * \return \c true if the byte completed a frame.
+     */
+    bool push(unsigned char byte, Frame& frame);
+
+    /*!
+     * Decodes the given \a data and invokes the \a handler for every completed frame.
+     *
+     * \param data The received bytes.
+     * \param handler The callable invoked with every \a Frame.
+     */
+    template<typename Handler>
+    void feed(QByteArray const& data, Handler handler) {
+        Frame frame{};
+        for(auto byte : data) {
+            if(push(static_cast<unsigned char>(byte), frame)) {
+                handler(frame);
+            }
+        }
+    }
+
+    /*!
+     * Announces that the device has been asked to send the given frame \a type. Announced
+     * frames take precedence over others with a common prefix until they have been received.
+     *
+     * \param type The type of the announced frame.
+     */
+    void expect(Frame::Type type);
+
+    /*!
+     * Gets if the given frame \a type has been announced and not been received yet.
+     *
+     * \param type The type of the frame.
+     * \return \c true if the frame is still awaited.
+     */
+    bool expecting(Frame::Type type) const;
+
+    /*!
+     * Drops any partially received frame and all announcements.
+     */
+    void reset();
+
+    /*!
+     * Gets the number of frames decoded so far.
+     *
+     * \return The number of completed frames.
+     */
+    quint64 decodedFrames() const;
+
+private:
+    enum class Match {
+        None,
+        Partial,
+        Complete
+    };
+
+    FrameTable _table;
+    unsigned char _buffer[MaximumFrameSize];
+    int _size{0};
+    quint32 _announced{0};
+    quint64 _decoded{0};
+
+    Match _match(FrameSpec const& spec) const;
+    bool _isAnnounced(Frame::Type type) const;
+};
+
+}
+
+Q_DECLARE_METATYPE(Ez::Frame)
+
+#endif // EZGRAVER_FRAMEDECODER_H
@@ -0,0 +1,215 @@
+#include "grayscalelayers.h"
+
+#include <QString>
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EZ_LAYERS_SSE2
+#endif
+
+namespace Ez {
+
+namespace {
+
+/*! The number of distinct values of a color channel. */
+constexpr int ChannelValues{256};
+
+/*! The maximum number of thresholds compared by the vectorized kernel. */
+constexpr int MaximumVectorThresholds{32};
+
+int pixelDistance(QRgb lhv, QRgb rhv) {
+    return std::abs(qRed(lhv) - qRed(rhv)) + std::abs(qGreen(lhv) - qGreen(rhv))
+            + std::abs(qBlue(lhv) - qBlue(rhv)) + std::abs(qAlpha(lhv) - qAlpha(rhv));
+}
+
+/*! Finds the closest color the same way QImage does when converting to an indexed image, by the L1 distance. */
+int closestMatch(QRgb pixel, QVector<QRgb> const& colorTable) {
+    int index{0};
+    int distance{INT_MAX};
+    for(int i{0}; i < colorTable.size(); ++i) {
+        auto current = pixelDistance(pixel, colorTable[i]);
+        if(current < distance) {
+            distance = current;
+            index = i;
+        }
+    }
+    return index;
+}
+
+/*!
+ * Maps opaque pixels to their gray level. As all levels are opaque grays, the level of a gray
+ * pixel only depends on its value, thus grays are looked up or compared against thresholds.
+ *
+ * The distance of a colored pixel to the levels is convex in the gray of the level and lowest
+ * at the median of its channels. Given ascending levels, the closest one is thus one of the two
+ * levels enclosing the median, which spares comparing the pixel with every level.
+ */
+struct LevelLookup {
+    uchar levels[ChannelValues];
+    uchar floors[ChannelValues];
+    int thresholds[MaximumVectorThresholds];
+    int thresholdCount;
+    bool thresholdable;
+    bool ascending;
+
+    explicit LevelLookup(QVector<QRgb> const& colorTable)
+            : levels{}, floors{}, thresholds{}, thresholdCount{0}, thresholdable{true}, ascending{true} {
+        for(int value{0}; value < ChannelValues; ++value) {
+            levels[value] = static_cast<uchar>(closestMatch(qRgb(value, value, value), colorTable));
+        }
+
+        for(int i{0}; i < colorTable.size(); ++i) {
+            auto color = colorTable[i];
+            auto gray = qRed(color) == qGreen(color) && qGreen(color) == qBlue(color) && qAlpha(color) == 255;
+            ascending = ascending && gray && (i == 0 ? qRed(color) == 0 : qRed(color) > qRed(colorTable[i - 1]));
+        }
+        for(int value{0}, level{0}; ascending && value < ChannelValues; ++value) {
+            while(level + 1 < colorTable.size() && qRed(colorTable[level + 1]) <= value) {
+                ++level;
+            }
+            floors[value] = static_cast<uchar>(level);
+        }
+
+        // The levels are the number of thresholds exceeded if they increase one by one.
+        thresholdCount = colorTable.size() - 1;
+        thresholdable = levels[0] == 0 && levels[ChannelValues - 1] == thresholdCount && thresholdCount <= MaximumVectorThresholds;
+        for(int value{1}; thresholdable && value < ChannelValues; ++value) {
+            auto step = levels[value] - levels[value - 1];
+            if(step < 0 || step > 1) {
+                thresholdable = false;
+            } else if(step == 1) {
+                thresholds[levels[value] - 1] = value - 1;
+            }
+        }
+    }
+
+    uchar level(QRgb pixel, QVector<QRgb> const& colorTable) const {
+        auto red = qRed(pixel);
+        auto green = qGreen(pixel);
+        auto blue = qBlue(pixel);
+        if(qAlpha(pixel) != 255 || !ascending) {
+            return static_cast<uchar>(closestMatch(pixel, colorTable));
+        }
+        if(red == green && green == blue) {
+            return levels[red];
+        }
+
+        // Ties are resolved in favor of the darker level, just like closestMatch does.
+        auto median = std::max(std::min(red, green), std::min(std::max(red, green), blue));
+        int lower{floors[median]};
+        if(lower + 1 < colorTable.size()
+                && pixelDistance(pixel, colorTable[lower + 1]) < pixelDistance(pixel, colorTable[lower])) {
+            return static_cast<uchar>(lower + 1);
+        }
+        return static_cast<uchar>(lower);
+    }
+};
+
+/*! Writes the gray levels of \a count pixels of a 32 bit scanline. */
+void quantizeRow(QRgb const* pixels, uchar* levels, int count, LevelLookup const& lookup, QVector<QRgb> const& colorTable) {
+    int x{0};
+#if defined(EZ_LAYERS_SSE2)
+    if(lookup.thresholdable) {
+        __m128i const channel{_mm_set1_epi32(0xFF)};
+        __m128i const opaque{_mm_set1_epi32(static_cast<int>(0xFF000000))};
+        for(; x + 4 <= count; x += 4) {
+            // Only quads of opaque grays are compared against the thresholds.
+            auto quad = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + x));
+            auto blue = _mm_and_si128(quad, channel);
+            auto green = _mm_and_si128(_mm_srli_epi32(quad, 8), channel);
+            auto red = _mm_and_si128(_mm_srli_epi32(quad, 16), channel);
+            auto gray = _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(quad, opaque), opaque),
+                                      _mm_and_si128(_mm_cmpeq_epi32(red, green), _mm_cmpeq_epi32(green, blue)));
+            if(_mm_movemask_epi8(gray) != 0xFFFF) {
+                for(int i{0}; i < 4; ++i) {
+                    levels[x + i] = lookup.level(pixels[x + i], colorTable);
+                }
+                continue;
+            }
+
+            auto level = _mm_setzero_si128();
+            for(int i{0}; i < lookup.thresholdCount; ++i) {
+                // Comparisons yield -1 for every exceeded threshold.
+                level = _mm_sub_epi32(level, _mm_cmpgt_epi32(blue, _mm_set1_epi32(lookup.thresholds[i])));
+            }
+
+            auto words = _mm_packs_epi32(level, level);
+            auto packed = _mm_packus_epi16(words, words);
+            auto bytes = static_cast<quint32>(_mm_cvtsi128_si32(packed));
+            std::memcpy(levels + x, &bytes, 4);
+        }
+    }
+#endif
+    for(; x < count; ++x) {
+        levels[x] = lookup.level(pixels[x], colorTable);
+    }
+}
+
+}
+
+QVector<QRgb> layerColorTable(int layerCount) {
+    QVector<QRgb> colorTable(layerCount - 1);
+
+    int i{0};
+    std::generate(colorTable.begin(), colorTable.end(), [layerCount, &i] {
+      int gray = (256 / (layerCount-1)) * (i++);
+      return qRgb(gray, gray, gray);
+    });
+    colorTable.push_back(qRgb(255, 255, 255));
+
+    return colorTable;
+}
+
+GrayscaleLayers quantizeLayers(QImage const& image, int layerCount, Qt::ImageConversionFlags) {
+    if(layerCount < 2 || layerCount > 256) {
+        throw std::invalid_argument{QString{"unsupported number of layers '%1'"}.arg(layerCount).toStdString()};
+    }
+
+    // The levels only consist of pure black and white once split into layers, which every
+    // dither mode maps to black and white again. Thus the flags do not affect the result.
+    auto source = image.format() == QImage::Format_ARGB32 || image.format() == QImage::Format_RGB32
+            ? image : image.convertToFormat(QImage::Format_ARGB32);
+    auto colorTable = layerColorTable(layerCount);
+    LevelLookup const lookup{colorTable};
+
+    GrayscaleLayers result{};
+    result.levels = QImage{source.size(), QImage::Format_Indexed8};
+    result.levels.setColorTable(colorTable);
+    result.levels.setDotsPerMeterX(source.dotsPerMeterX());
+    result.levels.setDotsPerMeterY(source.dotsPerMeterY());
+
+    QVector<QRgb> const monoColorTable{qRgb(255, 255, 255), qRgb(0, 0, 0)};
+    QVector<uchar*> layerBits(layerCount);
+    for(int layer{0}; layer < layerCount; ++layer) {
+        QImage bitmap{source.size(), QImage::Format_Mono};
+        bitmap.setColorTable(monoColorTable);
+        bitmap.setDotsPerMeterX(source.dotsPerMeterX());
+        bitmap.setDotsPerMeterY(source.dotsPerMeterY());
+        bitmap.fill(0);
+        result.layers.append(bitmap);
+    }
+
+    auto width = source.width();
+    for(int y{0}; y < source.height(); ++y) {
+        auto levels = result.levels.scanLine(y);
+        quantizeRow(reinterpret_cast<QRgb const*>(source.constScanLine(y)), levels, width, lookup, colorTable);
+
+        // Every pixel is black in exactly one layer.
+        for(int layer{0}; layer < layerCount; ++layer) {
+            layerBits[layer] = result.layers[layer].scanLine(y);
+        }
+        for(int x{0}; x < width; ++x) {
+            layerBits[levels[x]][x >> 3] |= static_cast<uchar>(0x80 >> (x & 7));
+        }
+    }
+
+    return result;
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef EZGRAVER_GRAYSCALELAYERS_H
+#define EZGRAVER_GRAYSCALELAYERS_H
+
+#include "ezgravercore_global.h"
+
+#include <QImage>
+#include <QVector>
+
+namespace Ez {
+
+/*!
+ * An image split into gray levels, each of which can be engraved as a separate layer.
+ */
+struct EZGRAVERCORESHARED_EXPORT GrayscaleLayers {
+    /*! The gray level of every pixel as indexed image using the layer color table. */
+    QImage levels{};
+
+    /*! One monochrome bitmap per gray level, the black pixels are the ones to engrave. */
+    QVector<QImage> layers{};
+};
+
+/*!
+ * Creates the color table of the given number of gray levels. The darkest level is black,
+ * the brightest one white.
+ *
+ * \param layerCount The number of gray levels.
+ * \return The color table with \a layerCount entries.
+ */
+EZGRAVERCORESHARED_EXPORT QVector<QRgb> layerColorTable(int layerCount);
+
+/*!
+ * Quantizes the given \a image to \a layerCount gray levels and extracts the bitmaps of all
+ * levels in a single pass. The result is bit-exact with converting the image to an indexed
+ * image using \a layerColorTable, replacing its color table with black for the extracted
+ * level and white for the others, and converting it to a monochrome image using \a flags.
+ *
+ * \param image The image to quantize.
+ * \param layerCount The number of gray levels, between 2 and 256.
+ * \param flags The conversion flags used for the monochrome conversion.
+ * \return The gray levels along with the bitmap of every level.
+ * \throws std::invalid_argument Thrown if the number of gray levels is not supported.
+ */
+EZGRAVERCORESHARED_EXPORT GrayscaleLayers quantizeLayers(QImage const& image, int layerCount, Qt::ImageConversionFlags flags);
+
+}
+
+#endif // EZGRAVER_GRAYSCALELAYERS_H
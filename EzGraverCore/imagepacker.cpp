@@ -0,0 +1,166 @@
+#include "imagepacker.h"
+
+#include <QSize>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EZ_PACK_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define EZ_PACK_NEON
+#endif
+
+#include "specifications.h"
+
+namespace Ez {
+
+namespace {
+
+constexpr int RowBytes{((Specifications::ImageWidth + 31) / 32) * 4};
+constexpr int PixelBytes{RowBytes * Specifications::ImageHeight};
+constexpr int PaletteOffset{14 + 40};
+constexpr int HeaderSize{PaletteOffset + 2 * 4};
+
+/*! Resolution written by the BMP encoder if the image does not provide one (72 dpi). */
+constexpr int DefaultDotsPerMeter{2834};
+
+constexpr char le(quint32 value, int byte) {
+    return static_cast<char>((value >> (8 * byte)) & 0xFF);
+}
+
+// BITMAPFILEHEADER and BITMAPINFOHEADER of a two color bitmap covering the engraving area.
+// Resolution and palette are taken from the image when writing the header.
+constexpr char BitmapHeader[PaletteOffset] = {
+    'B', 'M',
+    le(HeaderSize + PixelBytes, 0), le(HeaderSize + PixelBytes, 1), le(HeaderSize + PixelBytes, 2), le(HeaderSize + PixelBytes, 3),
+    0, 0, 0, 0,
+    le(HeaderSize, 0), le(HeaderSize, 1), le(HeaderSize, 2), le(HeaderSize, 3),
+    40, 0, 0, 0,
+    le(Specifications::ImageWidth, 0), le(Specifications::ImageWidth, 1), le(Specifications::ImageWidth, 2), le(Specifications::ImageWidth, 3),
+    le(Specifications::ImageHeight, 0), le(Specifications::ImageHeight, 1), le(Specifications::ImageHeight, 2), le(Specifications::ImageHeight, 3),
+    1, 0,
+    1, 0,
+    0, 0, 0, 0,
+    le(PixelBytes, 0), le(PixelBytes, 1), le(PixelBytes, 2), le(PixelBytes, 3),
+    0, 0, 0, 0,
+    0, 0, 0, 0,
+    2, 0, 0, 0,
+    2, 0, 0, 0
+};
+
+void writeLittleEndian(uchar* out, quint32 value) {
+    for(int i{0}; i < 4; ++i) {
+        out[i] = static_cast<uchar>(le(value, i));
+    }
+}
+
+void writeHeader(uchar* out, QImage const& image) {
+    std::memcpy(out, BitmapHeader, sizeof(BitmapHeader));
+    writeLittleEndian(out + 38, image.dotsPerMeterX() ? image.dotsPerMeterX() : DefaultDotsPerMeter);
+    writeLittleEndian(out + 42, image.dotsPerMeterY() ? image.dotsPerMeterY() : DefaultDotsPerMeter);
+
+    auto palette = out + PaletteOffset;
+    for(int i{0}; i < 2; ++i) {
+        QRgb color{i < image.colorCount() ? image.color(i) : (i == 0 ? qRgb(255, 255, 255) : qRgb(0, 0, 0))};
+        *palette++ = static_cast<uchar>(qBlue(color));
+        *palette++ = static_cast<uchar>(qGreen(color));
+        *palette++ = static_cast<uchar>(qRed(color));
+        *palette++ = 0;
+    }
+}
+
+/*! Copies \a count bytes of MSB first pixel data, applying the given invert \a mask. */
+void packRow(uchar const* source, uchar* target, int count, uchar mask) {
+    if(!mask) {
+        std::memcpy(target, source, count);
+        return;
+    }
+
+    int i{0};
+#if defined(EZ_PACK_SSE2)
+    __m128i const ones{_mm_set1_epi8(static_cast<char>(mask))};
+    for(; i + 16 <= count; i += 16) {
+        auto pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(source + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), _mm_xor_si128(pixels, ones));
+    }
+#elif defined(EZ_PACK_NEON)
+    uint8x16_t const ones{vdupq_n_u8(mask)};
+    for(; i + 16 <= count; i += 16) {
+        vst1q_u8(target + i, veorq_u8(vld1q_u8(source + i), ones));
+    }
+#endif
+    for(; i < count; ++i) {
+        target[i] = source[i] ^ mask;
+    }
+}
+
+struct BitReversal {
+    uchar bits[256];
+
+    BitReversal() : bits{} {
+        for(int i{0}; i < 256; ++i) {
+            for(int bit{0}; bit < 8; ++bit) {
+                bits[i] |= ((i >> bit) & 1) << (7 - bit);
+            }
+        }
+    }
+};
+
+/*! Copies \a count bytes of LSB first pixel data, reversing the bit order on the way. */
+void packRowLsb(uchar const* source, uchar* target, int count, uchar mask) {
+    static BitReversal const reversed{};
+    for(int i{0}; i < count; ++i) {
+        target[i] = reversed.bits[source[i]] ^ mask;
+    }
+}
+
+}
+
+QByteArray packImage(QImage const& originalImage, PayloadFormat format) {
+    QImage image{originalImage.scaled(Specifications::ImageWidth, Specifications::ImageHeight)};
+
+    // The device expects the rows top-down, which matches mirroring the image and storing it
+    // bottom-up as the BMP encoder does. Dithering has to see the mirrored image in order to
+    // stay bit-exact, monochrome images are simply read in their natural order.
+    bool bottomUp{false};
+    if(image.format() != QImage::Format_Mono && image.format() != QImage::Format_MonoLSB) {
+        image = image.mirrored().convertToFormat(QImage::Format_Mono);
+        bottomUp = true;
+    }
+    if(image.isNull()) {
+        return QByteArray{};
+    }
+
+    bool const bitmap{format == PayloadFormat::Bitmap};
+    QByteArray payload{payloadSize(format), Qt::Uninitialized};
+    auto out = reinterpret_cast<uchar*>(payload.data());
+    if(bitmap) {
+        writeHeader(out, image);
+        out += HeaderSize;
+    }
+
+    // Protocol v1 and v2 engrave the white pixels and therefore require inverted data.
+    uchar const mask{static_cast<uchar>(bitmap ? 0xFF : 0x00)};
+    bool const lsb{image.format() == QImage::Format_MonoLSB};
+    int const lineBytes{(image.width() + 7) / 8};
+    for(int row{0}; row < image.height(); ++row, out += RowBytes) {
+        auto line = image.constScanLine(bottomUp ? image.height() - 1 - row : row);
+        if(lsb) {
+            packRowLsb(line, out, lineBytes, mask);
+        } else {
+            packRow(line, out, lineBytes, mask);
+        }
+        std::fill(out + lineBytes, out + RowBytes, 0);
+    }
+
+    return payload;
+}
+
+int payloadSize(PayloadFormat format) {
+    return format == PayloadFormat::Bitmap ? HeaderSize + PixelBytes : PixelBytes;
+}
+
+}
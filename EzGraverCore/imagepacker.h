@@ -0,0 +1,47 @@
+#ifndef EZGRAVER_IMAGEPACKER_H
+#define EZGRAVER_IMAGEPACKER_H
+
+#include "ezgravercore_global.h"
+
+#include <QByteArray>
+#include <QImage>
+
+namespace Ez {
+
+/*!
+ * The layouts in which the different protocol versions expect the image data.
+ */
+enum class PayloadFormat {
+    /*! A complete monochrome BMP file with inverted pixels (protocol v1 and v2). */
+    Bitmap,
+
+    /*! The raw monochrome pixel rows without any header (protocol v3 and v4). */
+    Raw
+};
+
+/*!
+ * Converts the given \a image into the byte stream expected by the engraver. The image
+ * is scaled to the engraving area and converted to a monochrome bitmap if necessary.
+ * Monochrome images of the correct size are packed straight from their scanlines without
+ * any intermediate image or encoder.
+ *
+ * The result is bit-exact with encoding the mirrored image as BMP.
+ *
+ * \param image The image to pack.
+ * \param format The layout to produce.
+ * \return The payload ready to be sent to the device, or an empty array if the image is null
+ *         or cannot be converted.
+ */
+EZGRAVERCORESHARED_EXPORT QByteArray packImage(QImage const& image, PayloadFormat format);
+
+/*!
+ * Gets the size of a payload of the given \a format.
+ *
+ * \param format The layout of the payload.
+ * \return The number of bytes of the payload.
+ */
+EZGRAVERCORESHARED_EXPORT int payloadSize(PayloadFormat format);
+
+}
+
+#endif // EZGRAVER_IMAGEPACKER_H
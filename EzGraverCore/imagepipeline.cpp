@@ -0,0 +1,203 @@
+#include "imagepipeline.h"
+
+#include <QPainter>
+#include <QTransform>
+#include <QColor>
+#include <QDataStream>
+
+#include "specifications.h"
+
+namespace Ez {
+
+void ImagePipeline::setSource(QImage const& source) {
+    // Modifying an image changes its cache key, thus unchanged sources keep the caches.
+    if(source.cacheKey() != _source.cacheKey()) {
+        _source = source;
+        _sourceGeneration = ++_generation;
+    }
+}
+
+void ImagePipeline::setFlip(bool horizontally, bool vertically) {
+    _flipHorizontally = horizontally;
+    _flipVertically = vertically;
+}
+
+void ImagePipeline::setKeepAspectRatio(bool keepAspectRatio) {
+    _keepAspectRatio = keepAspectRatio;
+}
+
+void ImagePipeline::setTransformation(bool enabled, float scale, int rotation) {
+    _transformed = enabled;
+    _scale = scale;
+    _rotation = rotation;
+}
+
+void ImagePipeline::setConversionFlags(Qt::ImageConversionFlags flags) {
+    _flags = flags;
+}
+
+void ImagePipeline::setDitherMethod(DitherMethod method) {
+    _ditherMethod = method;
+}
+
+void ImagePipeline::setLayers(bool grayscale, int layerCount, int layer) {
+    _grayscale = grayscale;
+    _layerCount = layerCount;
+    _layer = layer;
+}
+
+QByteArray ImagePipeline::settings() const {
+    QByteArray settings{};
+    QDataStream stream{&settings, QIODevice::WriteOnly};
+    stream.setVersion(QDataStream::Qt_5_4);
+    stream << _flipHorizontally << _flipVertically << _keepAspectRatio << _transformed << _scale << _rotation
+           << static_cast<int>(_flags) << static_cast<int>(_ditherMethod) << _grayscale << _layerCount << _layer;
+    return settings;
+}
+
+QImage ImagePipeline::result() {
+    return result(std::function<bool()>{});
+}
+
+QImage ImagePipeline::result(std::function<bool()> const& canceled) {
+    if(_source.isNull()) {
+        return QImage{};
+    }
+
+    void (ImagePipeline::*stages[])() {
+        &ImagePipeline::_runFlip,
+        &ImagePipeline::_runTransform,
+        &ImagePipeline::_runComposite,
+        &ImagePipeline::_runQuantize,
+        &ImagePipeline::_runLayer
+    };
+    for(auto stage : stages) {
+        if(canceled && canceled()) {
+            return QImage{};
+        }
+        (this->*stage)();
+    }
+    return _layerStage.output;
+}
+
+void ImagePipeline::clear() {
+    _flip.valid = false;
+    _flip.output = QImage{};
+    _transform.valid = false;
+    _transform.output = QImage{};
+    _composite.valid = false;
+    _composite.output = QImage{};
+    _quantize.valid = false;
+    _quantize.output = QImage{};
+    _grayscaleLayers = GrayscaleLayers{};
+    _layerStage.valid = false;
+    _layerStage.output = QImage{};
+}
+
+void ImagePipeline::_runFlip() {
+    FlipParameters parameters{_flipHorizontally, _flipVertically};
+    if(_flip.current(_sourceGeneration, parameters)) {
+        return;
+    }
+
+    _flip.output = _source.mirrored(_flipHorizontally, _flipVertically);
+    _flip.input = _sourceGeneration;
+    _flip.parameters = parameters;
+    _flip.generation = ++_generation;
+    _flip.valid = true;
+}
+
+void ImagePipeline::_runTransform() {
+    // The aspect ratio is irrelevant as long as the image is transformed freely.
+    TransformParameters parameters{_transformed, _keepAspectRatio && !_transformed,
+                                   _transformed ? _scale : 1.0f, _transformed ? _rotation : 0};
+    if(_transform.current(_flip.generation, parameters)) {
+        return;
+    }
+
+    QSize canvas{Specifications::ImageWidth, Specifications::ImageHeight};
+    auto const& flipped = _flip.output;
+    if(_transformed) {
+        QTransform rotation{};
+        rotation.rotate(_rotation);
+        auto rotated = flipped.transformed(rotation);
+
+        _transform.output = rotated.scaled(rotated.width() * _scale, rotated.height() * _scale);
+        _transformPosition = QPoint{(canvas.width() - _transform.output.width()) / 2, (canvas.height() - _transform.output.height()) / 2};
+    } else if(_keepAspectRatio) {
+        // As at this time, the target image is quadratic, scaling according the larger dimension is sufficient.
+        auto wide = flipped.width() > flipped.height();
+        _transform.output = wide ? flipped.scaledToWidth(canvas.width()) : flipped.scaledToHeight(canvas.height());
+        _transformPosition = wide ? QPoint{0, (canvas.height() - _transform.output.height()) / 2}
+                                  : QPoint{(canvas.width() - _transform.output.width()) / 2, 0};
+    } else {
+        _transform.output = flipped.scaled(canvas);
+        _transformPosition = QPoint{};
+    }
+
+    _transform.input = _flip.generation;
+    _transform.parameters = parameters;
+    _transform.generation = ++_generation;
+    _transform.valid = true;
+}
+
+void ImagePipeline::_runComposite() {
+    CompositeParameters parameters{};
+    if(_composite.current(_transform.generation, parameters)) {
+        return;
+    }
+
+    // Draw white background, otherwise transparency is converted to black.
+    QImage image{QSize{Specifications::ImageWidth, Specifications::ImageHeight}, QImage::Format_ARGB32};
+    image.fill(QColor{Qt::white});
+    QPainter painter{&image};
+    painter.drawImage(_transformPosition, _transform.output);
+    painter.end();
+
+    _composite.output = image;
+    _composite.input = _transform.generation;
+    _composite.generation = ++_generation;
+    _composite.valid = true;
+}
+
+void ImagePipeline::_runQuantize() {
+    // All grayscale layers are extracted at once, the dither mode does not affect them.
+    auto ignoresFlags = _grayscale || _ditherMethod != DitherMethod::ConversionFlags;
+    QuantizeParameters parameters{_grayscale, ignoresFlags ? 0 : static_cast<int>(_flags),
+                                  _grayscale ? 0 : static_cast<int>(_ditherMethod), _grayscale ? _layerCount : 0};
+    if(_quantize.current(_composite.generation, parameters)) {
+        return;
+    }
+
+    if(_grayscale) {
+        _grayscaleLayers = quantizeLayers(_composite.output, _layerCount, _flags);
+        _quantize.output = _grayscaleLayers.levels;
+    } else {
+        _grayscaleLayers = GrayscaleLayers{};
+        _quantize.output = _ditherMethod == DitherMethod::ConversionFlags
+                ? _composite.output.convertToFormat(QImage::Format_Mono, _flags)
+                : dither(_composite.output, _ditherMethod);
+    }
+    _quantize.input = _composite.generation;
+    _quantize.parameters = parameters;
+    _quantize.generation = ++_generation;
+    _quantize.valid = true;
+}
+
+void ImagePipeline::_runLayer() {
+    auto extract = _grayscale && _layer > 0 && _layer <= _grayscaleLayers.layers.size();
+    LayerParameters parameters{extract, extract ? _layer : 0};
+    if(_layerStage.current(_quantize.generation, parameters)) {
+        return;
+    }
+
+    // Switching layers merely picks one of the bitmaps extracted by the quantizer.
+    _layerStage.output = extract ? _grayscaleLayers.layers[_layer-1] : _quantize.output;
+
+    _layerStage.input = _quantize.generation;
+    _layerStage.parameters = parameters;
+    _layerStage.generation = ++_generation;
+    _layerStage.valid = true;
+}
+
+}
@@ -0,0 +1,164 @@
+#ifndef EZGRAVER_IMAGEPIPELINE_H
+#define EZGRAVER_IMAGEPIPELINE_H
+
+#include "ezgravercore_global.h"
+
+#include <QImage>
+#include <QPoint>
+#include <QVector>
+#include <QByteArray>
+
+#include <tuple>
+#include <functional>
+
+#include "grayscalelayers.h"
+#include "dithering.h"
+
+namespace Ez {
+
+/*!
+ * Converts a source image into the image to engrave. The conversion is split into the stages
+ * flip, geometric transformation, canvas composition, quantization and layer extraction.
+ * Every stage caches its output along with the inputs it was computed from. Only the stages
+ * affected by a changed setting and the ones downstream of them are run again.
+ */
+class EZGRAVERCORESHARED_EXPORT ImagePipeline {
+public:
+    /*!
+     * Changes the source image.
+     *
+     * \param source The image to convert.
+     */
+    void setSource(QImage const& source);
+
+    /*!
+     * Sets the directions the source is flipped in.
+     *
+     * \param horizontally \c true if the source should be flipped horizontally.
+     * \param vertically \c true if the source should be flipped vertically.
+     */
+    void setFlip(bool horizontally, bool vertically);
+
+    /*!
+     * Sets if the aspect ratio of the source is kept when fitting it onto the canvas.
+     * Ignored as long as a free transformation is enabled.
+     *
+     * \param keepAspectRatio \c true if the aspect ratio should be kept.
+     */
+    void setKeepAspectRatio(bool keepAspectRatio);
+
+    /*!
+     * Sets the free transformation of the source. The transformed source is centered on the canvas.
+     *
+     * \param enabled \c true if the transformation should be applied instead of fitting the source.
+     * \param scale The scale of the source. 1.0 equals to 100%.
+     * \param rotation The rotation of the source in degrees.
+     */
+    void setTransformation(bool enabled, float scale, int rotation);
+
+    /*!
+     * Sets the flags used to quantize the image.
+     *
+     * \param flags The conversion flags to use.
+     */
+    void setConversionFlags(Qt::ImageConversionFlags flags);
+
+    /*!
+     * Sets the algorithm used to convert the image into a monochrome bitmap. The conversion
+     * flags only apply to \a DitherMethod::ConversionFlags. Grayscale layers are not dithered.
+     *
+     * \param method The dither method to use.
+     */
+    void setDitherMethod(DitherMethod method);
+
+    /*!
+     * Sets how the image is split into grayscale layers.
+     *
+     * \param grayscale \c true if the image should be split into layers.
+     * \param layerCount The number of layers.
+     * \param layer The layer to extract, 0 returns the grayscale image itself.
+     */
+    void setLayers(bool grayscale, int layerCount, int layer);
+
+    /*!
+     * Gets a fingerprint of all settings affecting the result, not including the source.
+     *
+     * \return The serialized settings.
+     */
+    QByteArray settings() const;
+
+    /*!
+     * Runs all stages whose inputs changed and returns the final image.
+     *
+     * \return The image to engrave or a null image if no source has been set.
+     */
+    QImage result();
+
+    /*!
+     * Runs all stages whose inputs changed and returns the final image. The given \a canceled
+     * callback is checked before each stage. Stages completed so far keep their output cached.
+     *
+     * \param canceled Returns \c true if the remaining stages should be skipped.
+     * \return The image to engrave or a null image if canceled or no source has been set.
+     */
+    QImage result(std::function<bool()> const& canceled);
+
+    /*!
+     * Drops the cached output of every stage.
+     */
+    void clear();
+
+private:
+    template<typename Parameters>
+    struct Stage {
+        quint64 input{0};
+        Parameters parameters{};
+        bool valid{false};
+        quint64 generation{0};
+        QImage output{};
+
+        bool current(quint64 upstream, Parameters const& current) const {
+            return valid && input == upstream && parameters == current;
+        }
+    };
+
+    using FlipParameters = std::tuple<bool, bool>;
+    using TransformParameters = std::tuple<bool, bool, float, int>;
+    using CompositeParameters = std::tuple<>;
+    using QuantizeParameters = std::tuple<bool, int, int, int>;
+    using LayerParameters = std::tuple<bool, int>;
+
+    QImage _source{};
+    quint64 _sourceGeneration{0};
+    quint64 _generation{0};
+
+    bool _flipHorizontally{false};
+    bool _flipVertically{false};
+    bool _keepAspectRatio{false};
+    bool _transformed{false};
+    float _scale{1.0};
+    int _rotation{0};
+    Qt::ImageConversionFlags _flags{Qt::DiffuseDither};
+    DitherMethod _ditherMethod{DitherMethod::ConversionFlags};
+    bool _grayscale{false};
+    int _layerCount{3};
+    int _layer{0};
+
+    Stage<FlipParameters> _flip{};
+    Stage<TransformParameters> _transform{};
+    QPoint _transformPosition{};
+    Stage<CompositeParameters> _composite{};
+    Stage<QuantizeParameters> _quantize{};
+    GrayscaleLayers _grayscaleLayers{};
+    Stage<LayerParameters> _layerStage{};
+
+    void _runFlip();
+    void _runTransform();
+    void _runComposite();
+    void _runQuantize();
+    void _runLayer();
+};
+
+}
+
+#endif // EZGRAVER_IMAGEPIPELINE_H
@@ -0,0 +1,307 @@
+#include "layerjob.h"
+
+#include <QSerialPort>
+#include <QDebug>
+
+#include <bitset>
+#include <cmath>
+
+#include "ezgraver.h"
+#include "serialworker.h"
+#include "imagepacker.h"
+
+namespace Ez {
+
+LayerJob::LayerJob(std::shared_ptr<EzGraver> engraver, QObject* parent)
+        : QObject{parent}, _engraver{engraver}, _eraseOperation{engraver}, _timeModel{engraver->deviceId()} {
+    _timer.setSingleShot(true);
+    connect(&_timer, &QTimer::timeout, this, &LayerJob::_timeout);
+    connect(&_transmission, &QFutureWatcherBase::finished, this, &LayerJob::_transmitted);
+    connect(&_eraseOperation, &EraseOperation::erased, this, [this] {
+        if(_phase == Phase::Erasing) {
+            _upload();
+        }
+    });
+    connect(&_eraseOperation, &EraseOperation::failed, this, [this](QString const& reason) {
+        if(_phase == Phase::Erasing) {
+            _fail(reason);
+        }
+    });
+}
+
+LayerJob::~LayerJob() {}
+
+void LayerJob::setLayers(QVector<JobLayer> const& layers) {
+    _layers = layers;
+    _features.clear();
+    auto format = _engraver->payloadFormat();
+    for(auto& layer : _layers) {
+        if(layer.payload.isEmpty() && engravedPixels(layer.image) > 0) {
+            layer.payload = packImage(layer.image, format);
+        }
+        _features.append(layer.payload.isEmpty() ? EngraveFeatures{} : engraveFeatures(layer.payload, format));
+    }
+}
+
+QVector<JobLayer> LayerJob::layers() const {
+    return _layers;
+}
+
+void LayerJob::setIdleTimeout(int msecs) {
+    _idleTimeout = msecs;
+}
+
+void LayerJob::setCalibrating(bool calibrating) {
+    _eraseOperation.setCalibrating(calibrating);
+}
+
+bool LayerJob::running() const {
+    return _phase != Phase::Idle;
+}
+
+qint64 LayerJob::predictedTime() const {
+    qint64 time{0};
+    for(int layer{0}; layer < _layers.size(); ++layer) {
+        time += _predictedTime(layer);
+    }
+    return time;
+}
+
+qint64 LayerJob::remainingTime() const {
+    if(!running()) {
+        return 0;
+    }
+
+    qint64 time{0};
+    if(_phase == Phase::Engraving) {
+        time += _timeModel.remaining();
+    } else {
+        time += _predictedTime(_current);
+    }
+    for(int layer{_current + 1}; layer < _layers.size(); ++layer) {
+        time += _predictedTime(layer);
+    }
+    return time;
+}
+
+QVector<unsigned char> LayerJob::burnTimeRamp(unsigned char first, unsigned char last, int count) {
+    QVector<unsigned char> ramp{};
+    for(int i{0}; i < count; ++i) {
+        auto fraction = count > 1 ? static_cast<double>(i) / (count - 1) : 0.0;
+        ramp.append(static_cast<unsigned char>(std::lround(first + (last - first) * fraction)));
+    }
+    return ramp;
+}
+
+QVector<JobLayer> LayerJob::rampedLayers(QVector<QImage> const& images, unsigned char first, unsigned char last) {
+    auto ramp = burnTimeRamp(first, last, images.size());
+
+    QVector<JobLayer> layers{};
+    for(int i{0}; i < images.size(); ++i) {
+        JobLayer layer{};
+        layer.image = images[i];
+        layer.burnTime = ramp[i];
+        layers.append(layer);
+    }
+    return layers;
+}
+
+int LayerJob::engravedPixels(QImage const& image) {
+    if(image.isNull()) {
+        return 0;
+    }
+
+    auto bitmap = image.format() == QImage::Format_Mono ? image : image.convertToFormat(QImage::Format_Mono, Qt::ThresholdDither);
+    auto darkBit = qGray(bitmap.color(1)) < qGray(bitmap.color(0));
+
+    int pixels{0};
+    auto width = bitmap.width();
+    for(int y{0}; y < bitmap.height(); ++y) {
+        auto bits = bitmap.constScanLine(y);
+        int set{0};
+        for(int x{0}; x < width; x += 8) {
+            // Bits beyond the width are undefined, thus they are masked out of the last byte.
+            auto remaining = width - x;
+            uchar mask = remaining >= 8 ? 0xFF : static_cast<uchar>(0xFF << (8 - remaining));
+            set += static_cast<int>(std::bitset<8>(bits[x >> 3] & mask).count());
+        }
+        pixels += darkBit ? set : width - set;
+    }
+    return pixels;
+}
+
+void LayerJob::start() {
+    if(running()) {
+        return;
+    }
+
+    _current = -1;
+    _next();
+}
+
+void LayerJob::cancel() {
+    if(!running()) {
+        return;
+    }
+
+    _timer.stop();
+    _eraseOperation.cancel();
+    if(_phase == Phase::Engraving) {
+        _engraver->pause();
+    }
+    _fail("job canceled");
+}
+
+void LayerJob::processFrame(Frame const& frame) {
+    switch(frame.type) {
+    case Frame::Type::UploadReady:
+        if(_eraseOperation.running()) {
+            _eraseOperation.processFrame(frame);
+        } else if(_phase == Phase::Erasing) {
+            _timer.stop();
+            if(_engraver->engravesAfterUpload()) {
+                // Requesting the upload mode switched to double speed, the image is sent at normal speed.
+                _engraver->setBaudRate(QSerialPort::Baud57600);
+            }
+            _upload();
+        }
+        break;
+    case Frame::Type::Progress:
+        if(_phase == Phase::Engraving) {
+            ++_engraved;
+            _timeModel.progress(frame.position);
+            emit layerProgressed(_current, _engraved, _timing.pixels);
+            if(_engraved >= _timing.pixels) {
+                _finishLayer(false);
+            } else {
+                _timer.start(_idleTimeout);
+            }
+        }
+        break;
+    }
+}
+
+qint64 LayerJob::_predictedTime(int layer) const {
+    if(_features[layer].pixels == 0) {
+        return 0;
+    }
+    return _eraseOperation.expectedTime() + _timeModel.predict(_features[layer], _layers[layer].burnTime);
+}
+
+void LayerJob::_next() {
+    while(++_current < _layers.size()) {
+        _timing = LayerTiming{};
+        _timing.layer = _current;
+        _timing.pixels = engravedPixels(_layers[_current].image);
+        if(_timing.pixels > 0) {
+            qDebug() << "engraving layer" << _current << "with" << _timing.pixels << "pixels";
+            emit layerStarted(_current, _timing.pixels);
+            _erase();
+            return;
+        }
+
+        qDebug() << "skipping blank layer" << _current;
+        _timing.skipped = true;
+        emit layerFinished(_timing);
+    }
+
+    _phase = Phase::Idle;
+    emit finished();
+}
+
+void LayerJob::_erase() {
+    _phase = Phase::Erasing;
+    _engraved = 0;
+    _clock.start();
+
+    // Repeating the image already held by the engraver neither requires erasing nor uploading it.
+    auto const& layer = _layers[_current];
+    if(!_eraseOperation.calibrating() && !_engraver->engravesAfterUpload() && _engraver->holdsPayload(layer.payload)) {
+        qDebug() << "layer" << _current << "is held by the engraver already";
+        _engrave();
+        return;
+    }
+
+    if(_engraver->engravesAfterUpload()) {
+        // The burn time has to be known before the upload as engraving starts right after it.
+        _engraver->start(_layers[_current].burnTime);
+        _timer.start(UploadReadyTimeout);
+        return;
+    }
+
+    _eraseOperation.start();
+}
+
+void LayerJob::_upload() {
+    _timing.erase = _clock.restart();
+    _phase = Phase::Uploading;
+    _engraver->uploadImage(_layers[_current].payload);
+    _transmission.setFuture(_engraver->serialWorker()->transmitted());
+}
+
+void LayerJob::_engrave() {
+    _timing.upload = _clock.restart();
+    _phase = Phase::Engraving;
+    if(!_engraver->engravesAfterUpload()) {
+        _engraver->start(_layers[_current].burnTime);
+    }
+    _timeModel.begin(_features[_current], _layers[_current].burnTime);
+    _timing.planned = _timeModel.planned();
+    _timer.start(_idleTimeout);
+}
+
+void LayerJob::_finishLayer(bool incomplete) {
+    _timer.stop();
+    _timing.engrave = _clock.elapsed();
+    _timing.incomplete = incomplete;
+    _timeModel.finish();
+    _eraseOperation.confirm(!incomplete);
+    qDebug() << "layer" << _current << "done after" << (_timing.erase + _timing.upload + _timing.engrave) << "ms";
+    emit layerFinished(_timing);
+    _next();
+}
+
+void LayerJob::_fail(QString const& reason) {
+    _timer.stop();
+    _timeModel.finish();
+    _phase = Phase::Idle;
+    qDebug() << "layer job failed:" << reason;
+    emit failed(reason);
+}
+
+void LayerJob::_transmitted() {
+    if(_transmission.isCanceled()) {
+        if(_phase == Phase::Uploading) {
+            _fail("transmission failed");
+        }
+        return;
+    }
+
+    switch(_phase) {
+    case Phase::Uploading:
+        _engrave();
+        break;
+    default:
+        break;
+    }
+}
+
+void LayerJob::_timeout() {
+    switch(_phase) {
+    case Phase::Erasing:
+        _fail("engraver did not accept the upload");
+        break;
+    case Phase::Engraving:
+        // Packets may get lost, a silent engraver which made progress is considered done.
+        if(_engraved > 0) {
+            _finishLayer(true);
+        } else {
+            _fail("engraver did not report any progress");
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+}
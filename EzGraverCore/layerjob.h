@@ -0,0 +1,271 @@
+#ifndef EZGRAVER_LAYERJOB_H
+#define EZGRAVER_LAYERJOB_H
+
+#include "ezgravercore_global.h"
+
+#include <QObject>
+#include <QImage>
+#include <QByteArray>
+#include <QVector>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+
+#include <memory>
+
+#include "framedecoder.h"
+#include "eraseoperation.h"
+#include "engravetimemodel.h"
+
+namespace Ez {
+
+struct EzGraver;
+
+/*!
+ * A single layer of a job along with the burn time to engrave it with.
+ */
+struct EZGRAVERCORESHARED_EXPORT JobLayer {
+    /*! The image to engrave, its black pixels are the ones burnt. */
+    QImage image{};
+
+    /*! The burn time in milliseconds, ignored by engravers not applying it, see \a EzGraver::appliesBurnTime. */
+    unsigned char burnTime{60};
+
+    /*! The image already packed in the payload format of the engraver, uploaded instead of the image if set. */
+    QByteArray payload{};
+};
+
+/*!
+ * The time spent on the phases of a single layer.
+ */
+struct EZGRAVERCORESHARED_EXPORT LayerTiming {
+    /*! The index of the layer within the job. */
+    int layer{0};
+
+    /*! The number of pixels engraved. */
+    int pixels{0};
+
+    /*! \c true if the layer has been skipped as it does not contain any pixel to engrave. */
+    bool skipped{false};
+
+    /*! \c true if the engraver stopped reporting progress before all pixels were engraved. */
+    bool incomplete{false};
+
+    /*! The time in milliseconds until the engraver was ready to receive the image. */
+    qint64 erase{0};
+
+    /*! The time in milliseconds it took to upload the image. */
+    qint64 upload{0};
+
+    /*! The time in milliseconds it took to engrave the image. */
+    qint64 engrave{0};
+
+    /*! The time in milliseconds the engraving was expected to take, see \a EngraveTimeModel. */
+    qint64 planned{0};
+};
+
+/*!
+ * Engraves a sequence of layers one after another, e.g. the grayscale layers of an image.
+ * Each layer is erased, uploaded, started and awaited before the next one follows. Layers
+ * without any pixel to engrave are skipped. Whether a layer has been engraved completely
+ * calibrates the erase wait of the engraver, see \a EraseOperation.
+ *
+ * The end of a layer is detected from the progress frames of the engraver, thus the owner
+ * has to connect \a EzGraver::frameDecoded to \a processFrame. This leaves it to the owner
+ * whether further consumers see the frames as well.
+ */
+class EZGRAVERCORESHARED_EXPORT LayerJob : public QObject {
+    Q_OBJECT
+
+public:
+    /*!
+     * Creates a new job driving the given \a engraver.
+     *
+     * \param engraver The engraver to use.
+     * \param parent The parent of the job.
+     */
+    explicit LayerJob(std::shared_ptr<EzGraver> engraver, QObject* parent=NULL);
+
+    /*!
+     * Frees all required resources upon deconstruction.
+     */
+    virtual ~LayerJob();
+
+    /*!
+     * Sets the layers to engrave and packs the ones without a payload. Must not be changed
+     * while the job is running.
+     *
+     * \param layers The layers in the order they are engraved.
+     */
+    void setLayers(QVector<JobLayer> const& layers);
+
+    /*!
+     * Gets the layers to engrave.
+     *
+     * \return The layers in the order they are engraved.
+     */
+    QVector<JobLayer> layers() const;
+
+    /*!
+     * Sets the time in milliseconds the engraver may stay silent while engraving. If it
+     * exceeds this time without reporting any progress, the layer is considered done.
+     *
+     * \param msecs The timeout in milliseconds.
+     */
+    void setIdleTimeout(int msecs);
+
+    /*!
+     * Turns the job into a calibration of the erase wait, see \a EraseOperation::setCalibrating.
+     * Every layer is erased and uploaded, even if the engraver holds it already.
+     *
+     * \param calibrating \c true if the job calibrates the erase wait.
+     */
+    void setCalibrating(bool calibrating);
+
+    /*!
+     * Gets if the job is currently running.
+     *
+     * \return \c true if the job is running.
+     */
+    bool running() const;
+
+    /*!
+     * Predicts the time the job takes from erasing the first layer to engraving the last one.
+     * Uploads are not accounted for.
+     *
+     * \return The expected time in milliseconds.
+     */
+    qint64 predictedTime() const;
+
+    /*!
+     * Predicts the time left until the running job is done, refined by the progress of the
+     * layer being engraved.
+     *
+     * \return The remaining time in milliseconds, 0 if the job is not running.
+     */
+    qint64 remainingTime() const;
+
+    /*!
+     * Creates a linear ramp of burn times. The first layer is the darkest one and thus
+     * usually burnt longest.
+     *
+     * \param first The burn time of the first layer.
+     * \param last The burn time of the last layer.
+     * \param count The number of layers.
+     * \return The burn time of every layer.
+     */
+    static QVector<unsigned char> burnTimeRamp(unsigned char first, unsigned char last, int count);
+
+    /*!
+     * Pairs the given \a images with the burn times of the given ramp.
+     *
+     * \param images The images to engrave, usually the layers of \a quantizeLayers without the white one.
+     * \param first The burn time of the first layer.
+     * \param last The burn time of the last layer.
+     * \return The layers of the job.
+     */
+    static QVector<JobLayer> rampedLayers(QVector<QImage> const& images, unsigned char first, unsigned char last);
+
+    /*!
+     * Counts the pixels to engrave of the given \a image.
+     *
+     * \param image The image to inspect.
+     * \return The number of dark pixels.
+     */
+    static int engravedPixels(QImage const& image);
+
+public slots:
+    /*!
+     * Starts the job with the first layer.
+     */
+    void start();
+
+    /*!
+     * Stops the job. The engraver is paused if it is currently engraving.
+     */
+    void cancel();
+
+    /*!
+     * Processes a frame received from the engraver.
+     *
+     * \param frame The decoded frame.
+     */
+    void processFrame(Ez::Frame const& frame);
+
+signals:
+    /*!
+     * Fired as soon as a layer is started.
+     *
+     * \param layer The index of the layer.
+     * \param pixels The number of pixels to engrave.
+     */
+    void layerStarted(int layer, int pixels);
+
+    /*!
+     * Fired as soon as the engraver reported an engraved pixel.
+     *
+     * \param layer The index of the layer.
+     * \param engraved The number of pixels engraved so far.
+     * \param pixels The number of pixels to engrave.
+     */
+    void layerProgressed(int layer, int engraved, int pixels);
+
+    /*!
+     * Fired as soon as a layer is done or has been skipped.
+     *
+     * \param timing The time spent on the layer.
+     */
+    void layerFinished(Ez::LayerTiming const& timing);
+
+    /*!
+     * Fired as soon as all layers are done.
+     */
+    void finished();
+
+    /*!
+     * Fired if the job has been aborted.
+     *
+     * \param reason The reason of the abort.
+     */
+    void failed(QString const& reason);
+
+private:
+    enum class Phase {
+        Idle,
+        Erasing,
+        Uploading,
+        Engraving
+    };
+
+    /*! The time in milliseconds to wait for the engraver to accept an upload. */
+    static int const UploadReadyTimeout{10000};
+
+    std::shared_ptr<EzGraver> _engraver;
+    QVector<JobLayer> _layers{};
+    QVector<EngraveFeatures> _features{};
+    int _idleTimeout{30000};
+
+    Phase _phase{Phase::Idle};
+    int _current{-1};
+    EraseOperation _eraseOperation;
+    EngraveTimeModel _timeModel;
+    int _engraved{0};
+    LayerTiming _timing{};
+    QElapsedTimer _clock{};
+    QTimer _timer{this};
+    QFutureWatcher<void> _transmission{this};
+
+    qint64 _predictedTime(int layer) const;
+    void _next();
+    void _erase();
+    void _upload();
+    void _engrave();
+    void _finishLayer(bool incomplete);
+    void _fail(QString const& reason);
+    void _transmitted();
+    void _timeout();
+};
+
+}
+
+#endif // EZGRAVER_LAYERJOB_H
@@ -0,0 +1,283 @@
+#include "payloadcache.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QtEndian>
+#include <QDebug>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace Ez {
+
+namespace {
+
+/*! Identifies an entry file, "EZPC". */
+constexpr quint32 Magic{0x455A5043};
+constexpr quint8 Version{1};
+constexpr quint8 CompressedFlag{0x01};
+
+// magic, version, flags, reserved, last use, payload size, stored size
+constexpr int MagicOffset{0};
+constexpr int VersionOffset{4};
+constexpr int FlagsOffset{5};
+constexpr int LastUseOffset{8};
+constexpr int PayloadSizeOffset{16};
+constexpr int StoredSizeOffset{20};
+constexpr int HeaderSize{24};
+
+/*! The maximum length of a run or literal sequence of the PackBits encoding. */
+constexpr int MaximumRun{128};
+
+QString const EntrySuffix{".ezp"};
+
+struct Header {
+    quint8 flags;
+    qint64 lastUse;
+    quint32 payloadSize;
+    quint32 storedSize;
+};
+
+bool readHeader(QFile& file, Header& header) {
+    uchar raw[HeaderSize];
+    if(!file.seek(0) || file.read(reinterpret_cast<char*>(raw), HeaderSize) != HeaderSize) {
+        return false;
+    }
+    if(qFromBigEndian<quint32>(raw + MagicOffset) != Magic || raw[VersionOffset] != Version) {
+        return false;
+    }
+
+    header.flags = raw[FlagsOffset];
+    header.lastUse = qFromBigEndian<qint64>(raw + LastUseOffset);
+    header.payloadSize = qFromBigEndian<quint32>(raw + PayloadSizeOffset);
+    header.storedSize = qFromBigEndian<quint32>(raw + StoredSizeOffset);
+    return file.size() == HeaderSize + static_cast<qint64>(header.storedSize);
+}
+
+QByteArray writeHeader(Header const& header) {
+    QByteArray raw{HeaderSize, '\0'};
+    auto out = reinterpret_cast<uchar*>(raw.data());
+    qToBigEndian<quint32>(Magic, out + MagicOffset);
+    out[VersionOffset] = Version;
+    out[FlagsOffset] = header.flags;
+    qToBigEndian<qint64>(header.lastUse, out + LastUseOffset);
+    qToBigEndian<quint32>(header.payloadSize, out + PayloadSizeOffset);
+    qToBigEndian<quint32>(header.storedSize, out + StoredSizeOffset);
+    return raw;
+}
+
+void touch(QFile& file) {
+    uchar raw[sizeof(qint64)];
+    qToBigEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), raw);
+    if((file.openMode() & QIODevice::WriteOnly) && file.seek(LastUseOffset)) {
+        file.write(reinterpret_cast<char const*>(raw), sizeof(raw));
+        file.flush();
+    }
+}
+
+/*! Encodes the given data using PackBits. Payloads mostly consist of long runs of blank pixels. */
+QByteArray compress(QByteArray const& data) {
+    QByteArray result{};
+    result.reserve(data.size() / 4);
+
+    auto size = data.size();
+    int i{0};
+    while(i < size) {
+        int run{1};
+        while(i + run < size && run < MaximumRun && data[i + run] == data[i]) {
+            ++run;
+        }
+        if(run > 1) {
+            result.append(static_cast<char>(1 - run));
+            result.append(data[i]);
+            i += run;
+            continue;
+        }
+
+        // Literals last until the next run of at least two bytes.
+        int literal{1};
+        while(i + literal < size && literal < MaximumRun
+              && !(i + literal + 1 < size && data[i + literal] == data[i + literal + 1])) {
+            ++literal;
+        }
+        result.append(static_cast<char>(literal - 1));
+        result.append(data.constData() + i, literal);
+        i += literal;
+    }
+    return result;
+}
+
+bool decompress(QByteArray const& data, int payloadSize, QByteArray& result) {
+    result = QByteArray{payloadSize, Qt::Uninitialized};
+    auto out = result.data();
+    int written{0};
+    int i{0};
+    while(i < data.size()) {
+        auto control = static_cast<signed char>(data[i++]);
+        if(control >= 0) {
+            int literal{control + 1};
+            if(i + literal > data.size() || written + literal > payloadSize) {
+                return false;
+            }
+            std::copy(data.constData() + i, data.constData() + i + literal, out + written);
+            i += literal;
+            written += literal;
+        } else if(control != -128) {
+            int run{1 - control};
+            if(i >= data.size() || written + run > payloadSize) {
+                return false;
+            }
+            std::fill(out + written, out + written + run, data[i++]);
+            written += run;
+        }
+    }
+    return written == payloadSize;
+}
+
+}
+
+bool CachedPayload::isNull() const {
+    return data.isEmpty();
+}
+
+PayloadCache::PayloadCache(QString const& directory, qint64 maximumSize) : _directory{directory}, _maximumSize{maximumSize} {
+    QDir{}.mkpath(_directory);
+}
+
+QString PayloadCache::defaultDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/EzGraver/payloads";
+}
+
+QByteArray PayloadCache::sourceDigest(QByteArray const& source) {
+    return QCryptographicHash::hash(source, QCryptographicHash::Sha1);
+}
+
+QByteArray PayloadCache::key(QByteArray const& sourceDigest, QByteArray const& settings, PayloadFormat format) {
+    QCryptographicHash hash{QCryptographicHash::Sha1};
+    hash.addData(sourceDigest);
+    hash.addData(settings);
+    hash.addData(QByteArray{1, static_cast<char>(format)});
+    return hash.result().toHex();
+}
+
+void PayloadCache::setCompressed(bool compressed) {
+    _compressed = compressed;
+}
+
+CachedPayload PayloadCache::find(QByteArray const& key) {
+    std::shared_ptr<QFile> file{new QFile{_path(key)}};
+    if(!file->exists() || !(file->open(QIODevice::ReadWrite) || file->open(QIODevice::ReadOnly))) {
+        return CachedPayload{};
+    }
+
+    Header header{};
+    if(!readHeader(*file, header)) {
+        qDebug() << "dropping corrupt cache entry" << file->fileName();
+        file->close();
+        file->remove();
+        return CachedPayload{};
+    }
+    touch(*file);
+
+    CachedPayload payload{};
+    if(header.flags & CompressedFlag) {
+        if(!decompress(file->read(header.storedSize), static_cast<int>(header.payloadSize), payload.data)) {
+            qDebug() << "dropping corrupt cache entry" << file->fileName();
+            file->close();
+            file->remove();
+            return CachedPayload{};
+        }
+        return payload;
+    }
+
+    // The mapping lives as long as the file, which is kept open by the payload.
+    auto mapped = file->map(HeaderSize, header.storedSize);
+    if(mapped) {
+        payload.data = QByteArray::fromRawData(reinterpret_cast<char const*>(mapped), static_cast<int>(header.storedSize));
+        payload.file = file;
+    } else {
+        payload.data = file->read(header.storedSize);
+    }
+    return payload;
+}
+
+bool PayloadCache::insert(QByteArray const& key, QByteArray const& payload) {
+    auto path = _path(key);
+    if(QFileInfo{path}.exists()) {
+        return true;
+    }
+
+    auto compressed = _compressed ? compress(payload) : QByteArray{};
+    auto stored = _compressed && compressed.size() < payload.size() ? compressed : payload;
+    Header header{static_cast<quint8>(_compressed && compressed.size() < payload.size() ? CompressedFlag : 0),
+                  QDateTime::currentMSecsSinceEpoch(), static_cast<quint32>(payload.size()), static_cast<quint32>(stored.size())};
+
+    // Entries appear atomically, readers in other processes never see partial files.
+    QSaveFile file{path};
+    if(!file.open(QIODevice::WriteOnly) || file.write(writeHeader(header)) != HeaderSize
+            || file.write(stored) != stored.size() || !file.commit()) {
+        qDebug() << "unable to store cache entry" << path;
+        return false;
+    }
+
+    _evict(path);
+    return true;
+}
+
+void PayloadCache::clear() {
+    QDir directory{_directory};
+    for(auto const& entry : directory.entryList(QStringList{"*" + EntrySuffix}, QDir::Files)) {
+        directory.remove(entry);
+    }
+}
+
+qint64 PayloadCache::size() const {
+    qint64 size{0};
+    for(auto const& entry : QDir{_directory}.entryInfoList(QStringList{"*" + EntrySuffix}, QDir::Files)) {
+        size += entry.size();
+    }
+    return size;
+}
+
+QString PayloadCache::_path(QByteArray const& key) const {
+    return _directory + "/" + QString::fromLatin1(key) + EntrySuffix;
+}
+
+void PayloadCache::_evict(QString const& keep) {
+    auto entries = QDir{_directory}.entryInfoList(QStringList{"*" + EntrySuffix}, QDir::Files);
+    qint64 size{0};
+    for(auto const& entry : entries) {
+        size += entry.size();
+    }
+    if(size <= _maximumSize) {
+        return;
+    }
+
+    std::vector<std::pair<qint64, QFileInfo>> lastUses{};
+    for(auto const& entry : entries) {
+        QFile file{entry.absoluteFilePath()};
+        Header header{};
+        auto lastUse = file.open(QIODevice::ReadOnly) && readHeader(file, header) ? header.lastUse : 0;
+        lastUses.emplace_back(lastUse, entry);
+    }
+    std::sort(lastUses.begin(), lastUses.end(), [](std::pair<qint64, QFileInfo> const& lhv, std::pair<qint64, QFileInfo> const& rhv) {
+        return lhv.first < rhv.first;
+    });
+
+    // Entries mapped by another process may not be removable on every platform, they are skipped.
+    for(auto const& entry : lastUses) {
+        if(size <= _maximumSize) {
+            break;
+        }
+        if(entry.second.absoluteFilePath() != QFileInfo{keep}.absoluteFilePath() && QFile::remove(entry.second.absoluteFilePath())) {
+            size -= entry.second.size();
+        }
+    }
+}
+
+}
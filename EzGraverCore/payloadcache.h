@@ -0,0 +1,128 @@
+#ifndef EZGRAVER_PAYLOADCACHE_H
+#define EZGRAVER_PAYLOADCACHE_H
+
+#include "ezgravercore_global.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QFile>
+
+#include <memory>
+
+#include "imagepacker.h"
+
+namespace Ez {
+
+/*!
+ * A payload read from the cache. Payloads stored uncompressed are mapped into memory,
+ * thus the data is only valid as long as the payload is kept alive. It has to be kept
+ * until the upload has been transmitted.
+ */
+struct EZGRAVERCORESHARED_EXPORT CachedPayload {
+    /*! The payload ready to be sent to the device. */
+    QByteArray data{};
+
+    /*! The mapped file backing \a data, if any. */
+    std::shared_ptr<QFile> file{};
+
+    /*!
+     * Gets if no payload has been found.
+     *
+     * \return \c true if the payload is empty.
+     */
+    bool isNull() const;
+};
+
+/*!
+ * A content-addressed on-disk cache of payloads ready to be sent to the device. Entries are
+ * keyed by the source image, the conversion settings and the payload format. Each entry is
+ * a single file which is mapped into memory on a hit. The least recently used entries are
+ * evicted as soon as the cache exceeds its maximum size. The cache may be shared by several
+ * processes, entries are written atomically.
+ */
+class EZGRAVERCORESHARED_EXPORT PayloadCache {
+public:
+    /*!
+     * Creates a cache in the given \a directory.
+     *
+     * \param directory The directory holding the entries, created if missing.
+     * \param maximumSize The maximum size of all entries in bytes.
+     */
+    explicit PayloadCache(QString const& directory=defaultDirectory(), qint64 maximumSize=64 * 1024 * 1024);
+
+    /*!
+     * Gets the directory shared by all EzGraver front-ends.
+     *
+     * \return The default cache directory.
+     */
+    static QString defaultDirectory();
+
+    /*!
+     * Computes the digest identifying a source image within a key. Computed once per source,
+     * the source does not have to be kept to compute keys for other settings.
+     *
+     * \param source The bytes of the source image as read from its file.
+     * \return The digest of the source.
+     */
+    static QByteArray sourceDigest(QByteArray const& source);
+
+    /*!
+     * Computes the key of a payload.
+     *
+     * \param sourceDigest The digest of the source image, see \a sourceDigest.
+     * \param settings A fingerprint of all settings affecting the conversion.
+     * \param format The layout of the payload.
+     * \return The key of the payload.
+     */
+    static QByteArray key(QByteArray const& sourceDigest, QByteArray const& settings, PayloadFormat format);
+
+    /*!
+     * Sets if new entries are stored run-length encoded. Compressed entries are smaller but
+     * have to be decompressed instead of being mapped on a hit.
+     *
+     * \param compressed \c true if entries should be compressed.
+     */
+    void setCompressed(bool compressed);
+
+    /*!
+     * Looks up the payload with the given \a key and marks it as used.
+     *
+     * \param key The key of the payload.
+     * \return The payload or a null payload if it is not cached.
+     */
+    CachedPayload find(QByteArray const& key);
+
+    /*!
+     * Stores the given \a payload and evicts the least recently used entries if the
+     * cache grew too large.
+     *
+     * \param key The key of the payload.
+     * \param payload The payload to store.
+     * \return \c true if the payload has been stored.
+     */
+    bool insert(QByteArray const& key, QByteArray const& payload);
+
+    /*!
+     * Removes all entries.
+     */
+    void clear();
+
+    /*!
+     * Gets the size of all entries.
+     *
+     * \return The size in bytes.
+     */
+    qint64 size() const;
+
+private:
+    QString _directory;
+    qint64 _maximumSize;
+    bool _compressed{false};
+
+    QString _path(QByteArray const& key) const;
+    void _evict(QString const& keep);
+};
+
+}
+
+#endif // EZGRAVER_PAYLOADCACHE_H
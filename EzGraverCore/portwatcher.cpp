@@ -0,0 +1,179 @@
+#include "portwatcher.h"
+
+#include <QTimer>
+#include <QSocketNotifier>
+#include <QSerialPortInfo>
+#include <QMutexLocker>
+#include <QByteArray>
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace Ez {
+
+int const PortWatcher::PollInterval;
+int const PortWatcher::SettleDelay;
+
+namespace {
+
+PortInfo toPortInfo(QSerialPortInfo const& port) {
+    PortInfo info{};
+    info.portName = port.portName();
+    info.systemLocation = port.systemLocation();
+    info.description = port.description();
+    info.manufacturer = port.manufacturer();
+    info.serialNumber = port.serialNumber();
+    info.vendorIdentifier = port.hasVendorIdentifier() ? port.vendorIdentifier() : 0;
+    info.productIdentifier = port.hasProductIdentifier() ? port.productIdentifier() : 0;
+    return info;
+}
+
+/*! Checks if a kernel uevent concerns a serial port, i.e. its SUBSYSTEM is tty or usb-serial. */
+bool concernsSerialPorts(QByteArray const& message) {
+    for(auto const& field : message.split('\0')) {
+        if(field == "SUBSYSTEM=tty" || field == "SUBSYSTEM=usb-serial") {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+bool PortInfo::operator==(PortInfo const& other) const {
+    return systemLocation == other.systemLocation && serialNumber == other.serialNumber
+            && vendorIdentifier == other.vendorIdentifier && productIdentifier == other.productIdentifier;
+}
+
+PortWatcher::PortWatcher(QObject* parent) : QObject{parent}, _context{new QObject{}}, _timer{new QTimer{_context}}, _polling{false} {
+    qRegisterMetaType<Ez::PortInfo>();
+
+    // A burst of events, e.g. a hub being plugged in, results in a single enumeration.
+    _timer->setSingleShot(true);
+    connect(_timer, &QTimer::timeout, _context, [this] { _scan(); });
+    connect(&_thread, &QThread::started, _context, [this] { _watch(); });
+    // The notifier has to be destroyed by the thread it is registered with.
+    connect(&_thread, &QThread::finished, _context, &QObject::deleteLater);
+    _context->moveToThread(&_thread);
+}
+
+PortWatcher::~PortWatcher() {
+    if(_thread.isRunning()) {
+        _thread.quit();
+        _thread.wait();
+    } else {
+        delete _context;
+    }
+
+#ifdef Q_OS_LINUX
+    if(_socket >= 0) {
+        ::close(_socket);
+    }
+#endif
+}
+
+QList<PortInfo> PortWatcher::ports() const {
+    QMutexLocker lock{&_mutex};
+    return _ports;
+}
+
+bool PortWatcher::polling() const {
+    return _polling.load();
+}
+
+void PortWatcher::start() {
+    if(!_thread.isRunning()) {
+        _thread.start();
+    }
+}
+
+void PortWatcher::_watch() {
+    if(_openUevents()) {
+        _notifier = new QSocketNotifier{_socket, QSocketNotifier::Read, _context};
+        connect(_notifier, &QSocketNotifier::activated, _context, [this] { _readUevents(); });
+    } else {
+        qDebug() << "no port change notifications available, polling the ports";
+        _polling.store(true);
+        _timer->setSingleShot(false);
+        _timer->start(PollInterval);
+    }
+    _scan();
+}
+
+bool PortWatcher::_openUevents() {
+#ifdef Q_OS_LINUX
+    _socket = ::socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if(_socket < 0) {
+        return false;
+    }
+
+    // Group 1 receives the events of the kernel itself, no udev daemon is required.
+    sockaddr_nl address{};
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = 1;
+    if(::bind(_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        ::close(_socket);
+        _socket = -1;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PortWatcher::_readUevents() {
+#ifdef Q_OS_LINUX
+    char buffer[8192];
+    auto relevant = false;
+    forever {
+        auto size = ::recv(_socket, buffer, sizeof(buffer), 0);
+        if(size < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        relevant = relevant || concernsSerialPorts(QByteArray::fromRawData(buffer, static_cast<int>(size)));
+    }
+
+    if(relevant && !_timer->isActive()) {
+        _timer->start(SettleDelay);
+    }
+#endif
+}
+
+void PortWatcher::_scan() {
+    // Enumerating the ports is slow on hosts with many serial devices, it never blocks the caller.
+    QList<PortInfo> current{};
+    for(auto const& port : QSerialPortInfo::availablePorts()) {
+        current.append(toPortInfo(port));
+    }
+
+    QList<PortInfo> previous{};
+    {
+        QMutexLocker lock{&_mutex};
+        previous = _ports;
+        _ports = current;
+    }
+
+    for(auto const& port : previous) {
+        if(!current.contains(port)) {
+            qDebug() << "port removed:" << port.portName;
+            emit portRemoved(port);
+        }
+    }
+    for(auto const& port : current) {
+        if(!previous.contains(port)) {
+            qDebug() << "port added:" << port.portName << port.description;
+            emit portAdded(port);
+        }
+    }
+}
+
+}
@@ -0,0 +1,139 @@
+#ifndef EZGRAVER_PORTWATCHER_H
+#define EZGRAVER_PORTWATCHER_H
+
+#include "ezgravercore_global.h"
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QMetaType>
+
+#include <atomic>
+
+class QTimer;
+class QSocketNotifier;
+
+namespace Ez {
+
+/*!
+ * Describes a serial port along with the device attached to it.
+ */
+struct EZGRAVERCORESHARED_EXPORT PortInfo {
+    /*! The name of the port, as accepted by \a create. */
+    QString portName{};
+
+    /*! The path of the port, e.g. /dev/ttyUSB0. */
+    QString systemLocation{};
+
+    /*! The description of the attached device. */
+    QString description{};
+
+    /*! The manufacturer of the attached device. */
+    QString manufacturer{};
+
+    /*! The USB serial number of the attached device, if any. */
+    QString serialNumber{};
+
+    /*! The USB vendor identifier, 0 if unknown. */
+    quint16 vendorIdentifier{0};
+
+    /*! The USB product identifier, 0 if unknown. */
+    quint16 productIdentifier{0};
+
+    /*!
+     * Gets if both describe the same device on the same port.
+     *
+     * \param other The port to compare with.
+     * \return \c true if both are equal.
+     */
+    bool operator==(PortInfo const& other) const;
+};
+
+/*!
+ * Watches the serial ports of the system on a dedicated thread and reports the ports being
+ * added or removed. On Linux, the kernel announces devices through a netlink socket, thus the
+ * ports are only enumerated once something has changed. Elsewhere, or if the socket cannot be
+ * opened, the ports are polled. The signals are emitted from the watcher thread.
+ */
+class EZGRAVERCORESHARED_EXPORT PortWatcher : public QObject {
+    Q_OBJECT
+
+public:
+    /*! The interval in milliseconds to enumerate the ports at if they are polled. */
+    static int const PollInterval{1000};
+
+    /*! The time in milliseconds granted to a device to settle after it has been announced. */
+    static int const SettleDelay{250};
+
+    /*!
+     * Creates a new watcher. Watching starts with \a start.
+     *
+     * \param parent The parent of the watcher.
+     */
+    explicit PortWatcher(QObject* parent=NULL);
+
+    /*!
+     * Stops watching and the watcher thread.
+     */
+    virtual ~PortWatcher();
+
+    /*!
+     * Gets the ports known so far.
+     *
+     * \return The ports of the last enumeration.
+     */
+    QList<PortInfo> ports() const;
+
+    /*!
+     * Gets if the ports are polled as no change notifications are available.
+     *
+     * \return \c true if the ports are polled.
+     */
+    bool polling() const;
+
+public slots:
+    /*!
+     * Starts watching. All ports present are reported as added first.
+     */
+    void start();
+
+signals:
+    /*!
+     * Fired as soon as a port appeared.
+     *
+     * \param port The added port.
+     */
+    void portAdded(Ez::PortInfo const& port);
+
+    /*!
+     * Fired as soon as a port disappeared.
+     *
+     * \param port The removed port.
+     */
+    void portRemoved(Ez::PortInfo const& port);
+
+private:
+    QThread _thread{};
+    QObject* _context;
+    QTimer* _timer;
+    QSocketNotifier* _notifier{nullptr};
+    int _socket{-1};
+    std::atomic<bool> _polling;
+
+    // Written by the watcher thread, guarded by the mutex.
+    mutable QMutex _mutex{};
+    QList<PortInfo> _ports{};
+
+    void _watch();
+    bool _openUevents();
+    void _readUevents();
+    void _scan();
+};
+
+}
+
+Q_DECLARE_METATYPE(Ez::PortInfo)
+
+#endif // EZGRAVER_PORTWATCHER_H
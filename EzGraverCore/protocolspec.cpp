@@ -0,0 +1,132 @@
+#include "protocolspec.h"
+
+#include <QString>
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace Ez {
+
+namespace {
+
+/*! The highest burn time accepted by the engravers. */
+constexpr int MaximumBurnTime{0xF0};
+
+// Protocol v1 and v2 send single byte commands, the burn time is sent on its own before starting.
+constexpr CommandSpec V1Commands[]{
+    {Command::Start, 2, {0x00, 0xF1}, 0},
+    {Command::Pause, 1, {0xF2}, -1},
+    {Command::Reset, 1, {0xF9}, -1},
+    {Command::Home, 1, {0xF3}, -1},
+    {Command::Center, 1, {0xFB}, -1},
+    {Command::Preview, 1, {0xF4}, -1},
+    {Command::Up, 1, {0xF5}, -1},
+    {Command::Down, 1, {0xF6}, -1},
+    {Command::Left, 1, {0xF7}, -1},
+    {Command::Right, 1, {0xF8}, -1},
+    {Command::Erase, 8, {0xFE, 0xFE, 0xFE, 0xFE, 0xFE, 0xFE, 0xFE, 0xFE}, -1}
+};
+
+constexpr CommandSpec V2Commands[]{
+    {Command::Start, 2, {0x00, 0xF1}, 0},
+    {Command::Pause, 1, {0xF2}, -1},
+    {Command::Reset, 1, {0xF9}, -1},
+    {Command::Home, 1, {0xF3}, -1},
+    {Command::Center, 1, {0xFB}, -1},
+    {Command::Preview, 1, {0xF4}, -1},
+    {Command::Up, 2, {0xF5, 0x01}, -1},
+    {Command::Down, 2, {0xF5, 0x02}, -1},
+    {Command::Left, 2, {0xF5, 0x03}, -1},
+    {Command::Right, 2, {0xF5, 0x04}, -1},
+    {Command::Erase, 8, {0xFE, 0xFE, 0xFE, 0xFE, 0xFE, 0xFE, 0xFE, 0xFE}, -1}
+};
+
+// Protocol v3 and v4 send four byte commands, the burn time is set right before starting.
+constexpr CommandSpec V3Commands[]{
+    {Command::Start, 8, {0xFF, 0x05, 0x00, 0x00, 0xFF, 0x01, 0x01, 0x00}, 2},
+    {Command::Pause, 4, {0xFF, 0x01, 0x02, 0x00}, -1},
+    {Command::Reset, 4, {0xFF, 0x04, 0x01, 0x00}, -1},
+    {Command::Home, 1, {0xF3}, -1},
+    {Command::Center, 4, {0xFF, 0x02, 0x01, 0x00}, -1},
+    {Command::Preview, 4, {0xFF, 0x02, 0x02, 0x00}, -1},
+    {Command::Up, 4, {0xFF, 0x03, 0x01, 0x00}, -1},
+    {Command::Down, 4, {0xFF, 0x03, 0x02, 0x00}, -1},
+    {Command::Left, 4, {0xFF, 0x03, 0x03, 0x00}, -1},
+    {Command::Right, 4, {0xFF, 0x03, 0x04, 0x00}, -1},
+    {Command::Erase, 4, {0xFF, 0x06, 0x01, 0x00}, -1}
+};
+
+// Protocol v4 starts on its own after the upload, which is requested by the baud rate negotiation.
+// Setting the burn time has not been verified on v4 hardware and shares its prefix with the
+// UploadReady answer, thus it is not sent, see ProtocolSpec::appliesBurnTime.
+constexpr CommandSpec V4Commands[]{
+    {Command::Start, 4, {0xFF, 0x05, 0x00, 0x00}, 2},
+    {Command::Pause, 4, {0xFF, 0x01, 0x02, 0x00}, -1},
+    {Command::Reset, 4, {0xFF, 0x04, 0x01, 0x00}, -1},
+    {Command::Home, 8, {0xFF, 0x0A, 0x00, 0x00, 0xFF, 0x0B, 0x00, 0x00}, -1},
+    {Command::Center, 4, {0xFF, 0x02, 0x01, 0x00}, -1},
+    {Command::Preview, 4, {0xFF, 0x02, 0x02, 0x00}, -1},
+    {Command::Up, 4, {0xFF, 0x03, 0x01, 0x00}, -1},
+    {Command::Down, 4, {0xFF, 0x03, 0x02, 0x00}, -1},
+    {Command::Left, 4, {0xFF, 0x03, 0x03, 0x00}, -1},
+    {Command::Right, 4, {0xFF, 0x03, 0x04, 0x00}, -1},
+    {Command::Erase, 4, {0xFF, 0x06, 0x01, 0x01}, -1}
+};
+
+/*!
+ * Checks at compile time that a table holds every command at its index and that the burn
+ * time lies within the bytes sent.
+ */
+template<std::size_t Size>
+constexpr bool isComplete(CommandSpec const (&specs)[Size], std::size_t index=0) {
+    return Size == static_cast<std::size_t>(CommandCount) && (index == Size
+            || (static_cast<std::size_t>(specs[index].command) == index
+                && specs[index].size <= MaximumCommandSize
+                && specs[index].burnTimeOffset < static_cast<int>(specs[index].size)
+                && (specs[index].command == Command::Start || specs[index].burnTimeOffset < 0)
+                && isComplete(specs, index + 1)));
+}
+
+static_assert(isComplete(V1Commands), "incomplete command table of protocol v1");
+static_assert(isComplete(V2Commands), "incomplete command table of protocol v2");
+static_assert(isComplete(V3Commands), "incomplete command table of protocol v3");
+static_assert(isComplete(V4Commands), "incomplete command table of protocol v4");
+
+constexpr ProtocolSpec Protocols[]{
+    {1, V1Commands, PayloadFormat::Bitmap, 6000, false, false, true},
+    {2, V2Commands, PayloadFormat::Bitmap, 6000, false, false, true},
+    {3, V3Commands, PayloadFormat::Raw, 50, false, false, true},
+    {4, V4Commands, PayloadFormat::Raw, 50, true, true, false}
+};
+
+}
+
+ProtocolSpec const& protocolSpec(int protocol) {
+    auto spec = std::find_if(std::begin(Protocols), std::end(Protocols), [protocol](ProtocolSpec const& spec) {
+        return spec.protocol == protocol;
+    });
+    if(spec == std::end(Protocols)) {
+        throw std::invalid_argument{QString{"unsupported protocol '%1' selected"}.arg(protocol).toStdString()};
+    }
+    return *spec;
+}
+
+int encodeCommand(ProtocolSpec const& spec, Command command, unsigned char burnTime, unsigned char* buffer) {
+    auto const& commandSpec = spec.commands[static_cast<int>(command)];
+    if(commandSpec.size == 0) {
+        throw std::invalid_argument{QString{"command %1 not supported by protocol v%2"}
+                .arg(static_cast<int>(command)).arg(spec.protocol).toStdString()};
+    }
+
+    std::copy(commandSpec.bytes, commandSpec.bytes + commandSpec.size, buffer);
+    if(commandSpec.burnTimeOffset >= 0) {
+        if(burnTime < 0x01 || burnTime > MaximumBurnTime) {
+            throw std::out_of_range{"burntime out of range"};
+        }
+        buffer[commandSpec.burnTimeOffset] = burnTime;
+    }
+    return commandSpec.size;
+}
+
+}
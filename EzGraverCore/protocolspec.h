@@ -0,0 +1,143 @@
+#ifndef EZGRAVER_PROTOCOLSPEC_H
+#define EZGRAVER_PROTOCOLSPEC_H
+
+#include "ezgravercore_global.h"
+
+#include <cstddef>
+
+#include "imagepacker.h"
+
+namespace Ez {
+
+/*!
+ * The commands understood by the engravers.
+ */
+enum class Command : quint8 {
+    /*! Starts the engraving process with a burn time. Protocol v4 only sets the burn time of the next upload. */
+    Start,
+
+    /*! Pauses the engraving process. */
+    Pause,
+
+    /*! Resets the engraver. */
+    Reset,
+
+    /*! Moves the engraver to the home position. */
+    Home,
+
+    /*! Moves the engraver to the center. */
+    Center,
+
+    /*! Draws a preview of the loaded image. */
+    Preview,
+
+    /*! Moves the engraver up. */
+    Up,
+
+    /*! Moves the engraver down. */
+    Down,
+
+    /*! Moves the engraver left. */
+    Left,
+
+    /*! Moves the engraver right. */
+    Right,
+
+    /*! Erases the EEPROM. */
+    Erase
+};
+
+/*! The number of commands, every command table holds one entry per command. */
+int const CommandCount{static_cast<int>(Command::Erase) + 1};
+
+/*! The size of the longest command of any protocol version. */
+int const MaximumCommandSize{8};
+
+/*!
+ * Describes the bytes sent for a single command.
+ */
+struct EZGRAVERCORESHARED_EXPORT CommandSpec {
+    /*! The command described, equal to the index within its table. */
+    Command command;
+
+    /*! The number of bytes sent, 0 if the protocol does not support the command. */
+    quint8 size;
+
+    /*! The bytes sent. */
+    quint8 bytes[MaximumCommandSize];
+
+    /*! The offset of the byte replaced by the burn time, -1 if the command has no argument. */
+    qint8 burnTimeOffset;
+};
+
+/*!
+ * Describes everything differing between the protocol versions except for the baud rate
+ * negotiation of protocol v4. The frames received are described by \a frameTable.
+ */
+struct EZGRAVERCORESHARED_EXPORT ProtocolSpec {
+    /*! The protocol version. */
+    int protocol;
+
+    /*! The commands, indexed by \a Command. */
+    CommandSpec const* commands;
+
+    /*! The layout of the uploaded images. */
+    PayloadFormat payloadFormat;
+
+    /*! The recommended time in ms to wait after erasing the EEPROM. */
+    int eraseTime;
+
+    /*! Whether the engraver starts engraving on its own as soon as an image has been uploaded. */
+    bool engravesAfterUpload;
+
+    /*! Whether the engraver announces the end of an erase with an \a Frame::Type::UploadReady frame. */
+    bool reportsErased;
+
+    /*! Whether the burn time is sent when starting, otherwise the engraver uses the one set on the device. */
+    bool appliesBurnTime;
+};
+
+/*!
+ * Gets the description of the given \a protocol version.
+ *
+ * \param protocol The protocol version.
+ * \return The description of the protocol.
+ * \throws std::invalid_argument Thrown if the provided protocol code is unknown.
+ */
+EZGRAVERCORESHARED_EXPORT ProtocolSpec const& protocolSpec(int protocol);
+
+/*!
+ * Encodes a command into the given \a buffer, which has to hold at least \a MaximumCommandSize
+ * bytes. No memory is allocated.
+ *
+ * \param spec The protocol to encode the command for.
+ * \param command The command to encode.
+ * \param burnTime The burn time of \a Command::Start, ignored by any other command.
+ * \param buffer Receives the encoded command.
+ * \return The number of bytes written to the buffer.
+ * \throws std::out_of_range Thrown if the burn time is not within 1 and 240.
+ * \throws std::invalid_argument Thrown if the protocol does not support the command.
+ */
+EZGRAVERCORESHARED_EXPORT int encodeCommand(ProtocolSpec const& spec, Command command, unsigned char burnTime, unsigned char* buffer);
+
+/*!
+ * Encodes a command into the given fixed size \a buffer, rejecting buffers too small for
+ * any command at compile time.
+ *
+ * \param spec The protocol to encode the command for.
+ * \param command The command to encode.
+ * \param burnTime The burn time of \a Command::Start, ignored by any other command.
+ * \param buffer Receives the encoded command.
+ * \return The number of bytes written to the buffer.
+ * \throws std::out_of_range Thrown if the burn time is not within 1 and 240.
+ * \throws std::invalid_argument Thrown if the protocol does not support the command.
+ */
+template<std::size_t Size>
+int encodeCommand(ProtocolSpec const& spec, Command command, unsigned char burnTime, unsigned char (&buffer)[Size]) {
+    static_assert(Size >= MaximumCommandSize, "buffer too small for the longest command");
+    return encodeCommand(spec, command, burnTime, static_cast<unsigned char*>(buffer));
+}
+
+}
+
+#endif // EZGRAVER_PROTOCOLSPEC_H
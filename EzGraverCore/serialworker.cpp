@@ -0,0 +1,180 @@
+#include "serialworker.h"
+
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include "streamwriter.h"
+
+namespace Ez {
+
+SerialWorker::SerialWorker(std::shared_ptr<QSerialPort> serial, QObject* parent)
+        : QObject{parent}, _serial{serial}, _context{new QObject{}}, _writer{new StreamWriter{serial}}, _throughput{0} {
+    _throughput.store(static_cast<qint64>(_writer->throughput()));
+
+    _serial->moveToThread(&_thread);
+    _context->moveToThread(&_thread);
+    _writer->moveToThread(&_thread);
+
+    // All handlers run on the I/O thread as they use the context object living there.
+    connect(this, &SerialWorker::commandQueued, _context, [this] { _process(); }, Qt::QueuedConnection);
+    connect(_writer, &StreamWriter::drained, _context, [this](qint64 bytes) { _written(bytes); });
+    connect(_writer, &StreamWriter::finished, _context, [this] { _finished(); });
+    connect(_writer, &StreamWriter::throughputChanged, _context, [this](double bytesPerSecond) {
+        _throughput.store(static_cast<qint64>(bytesPerSecond));
+        emit throughputChanged(bytesPerSecond);
+    });
+    connect(_serial.get(), &QSerialPort::readyRead, _context, [this] { _read(); });
+
+    _thread.start();
+}
+
+SerialWorker::~SerialWorker() {
+    QQueue<Command> dropped{};
+    {
+        QMutexLocker lock{&_mutex};
+        dropped.swap(_commands);
+        _closing = true;
+    }
+    for(auto& command : dropped) {
+        _complete(command.result, false);
+    }
+
+    post([](QSerialPort& serial) { serial.close(); }).waitForFinished();
+    _thread.quit();
+    _thread.wait();
+
+    delete _writer;
+    delete _context;
+}
+
+QFuture<void> SerialWorker::write(QByteArray const& data, int maximumChunkSize) {
+    return _enqueue(Command{data, maximumChunkSize, Task{}, QFutureInterface<void>{}});
+}
+
+QFuture<void> SerialWorker::post(Task const& task) {
+    return _enqueue(Command{QByteArray{}, 0, task, QFutureInterface<void>{}});
+}
+
+QFuture<void> SerialWorker::transmitted() {
+    return post([](QSerialPort&) {});
+}
+
+bool SerialWorker::waitForIdle(int msecs) {
+    QElapsedTimer timer{};
+    timer.start();
+
+    QMutexLocker lock{&_mutex};
+    while(_outstanding > 0) {
+        if(msecs < 0) {
+            _idle.wait(&_mutex);
+            continue;
+        }
+
+        auto remaining = msecs - timer.elapsed();
+        if(remaining <= 0 || !_idle.wait(&_mutex, static_cast<unsigned long>(remaining))) {
+            break;
+        }
+    }
+    return _outstanding == 0;
+}
+
+double SerialWorker::throughput() const {
+    return static_cast<double>(_throughput.load());
+}
+
+QFuture<void> SerialWorker::_enqueue(Command command) {
+    command.result.reportStarted();
+    auto future = command.result.future();
+    {
+        QMutexLocker lock{&_mutex};
+        _commands.enqueue(command);
+        ++_outstanding;
+    }
+    emit commandQueued(QPrivateSignal{});
+    return future;
+}
+
+void SerialWorker::_process() {
+    forever {
+        Command command{};
+        bool closing{false};
+        {
+            QMutexLocker lock{&_mutex};
+            if(_commands.isEmpty()) {
+                return;
+            }
+
+            // Tasks may depend on the data sent before them (e.g. changing the baud rate).
+            closing = _closing;
+            if(_commands.head().task && _writer->busy() && !closing) {
+                return;
+            }
+            command = _commands.dequeue();
+        }
+
+        if(closing) {
+            _writer->cancel();
+            _dropWrites();
+        }
+
+        if(command.task) {
+            command.task(*_serial);
+            _complete(command.result, true);
+        } else if(command.data.isEmpty()) {
+            _complete(command.result, true);
+        } else {
+            if(command.maximumChunkSize > 0) {
+                _writer->setMaximumChunkSize(command.maximumChunkSize);
+            }
+            _queued += command.data.size();
+            _writes.append(PendingWrite{_queued, command.result});
+            _writer->write(command.data);
+        }
+    }
+}
+
+void SerialWorker::_written(qint64 bytes) {
+    _drained += bytes;
+    while(!_writes.isEmpty() && _writes.first().end <= _drained) {
+        _complete(_writes.first().result, true);
+        _writes.removeFirst();
+    }
+    emit drained(bytes);
+}
+
+void SerialWorker::_finished() {
+    _dropWrites();
+    _process();
+}
+
+void SerialWorker::_dropWrites() {
+    // Whatever is left once the writer stopped will never be transmitted.
+    for(auto& write : _writes) {
+        _complete(write.result, write.end <= _drained);
+    }
+    _writes.clear();
+    _queued = _drained;
+}
+
+void SerialWorker::_read() {
+    auto data = _serial->readAll();
+    if(!data.isEmpty()) {
+        emit dataReceived(data);
+    }
+}
+
+void SerialWorker::_complete(QFutureInterface<void>& result, bool success) {
+    if(!success) {
+        qDebug() << "command has not been transmitted";
+        result.reportCanceled();
+    }
+    result.reportFinished();
+
+    QMutexLocker lock{&_mutex};
+    if(--_outstanding == 0) {
+        _idle.wakeAll();
+    }
+}
+
+}
@@ -0,0 +1,160 @@
+#ifndef EZGRAVER_SERIALWORKER_H
+#define EZGRAVER_SERIALWORKER_H
+
+#include "ezgravercore_global.h"
+
+#include <QObject>
+#include <QByteArray>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QList>
+#include <QSerialPort>
+#include <QThread>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace Ez {
+
+class StreamWriter;
+
+/*!
+ * Performs all I/O of a serial port on a dedicated thread. The port is moved to the thread
+ * upon construction and must not be accessed directly anymore. Commands are queued from any
+ * thread and executed in order. Every command returns a future which finishes as soon as the
+ * command has been transmitted, or is canceled if the transmission failed.
+ */
+class EZGRAVERCORESHARED_EXPORT SerialWorker : public QObject {
+    Q_OBJECT
+
+public:
+    /*! A task executed on the I/O thread with exclusive access to the serial port. */
+    using Task = std::function<void(QSerialPort&)>;
+
+    /*!
+     * Creates a new instance and starts the I/O thread for the given \a serial port.
+     *
+     * \param serial The serial port to take over.
+     * \param parent The parent of the worker.
+     */
+    explicit SerialWorker(std::shared_ptr<QSerialPort> serial, QObject* parent=NULL);
+
+    /*!
+     * Drops all pending commands, closes the serial port and stops the I/O thread.
+     */
+    virtual ~SerialWorker();
+
+    /*!
+     * Queues the given \a data for transmission.
+     *
+     * \param data The data to transmit.
+     * \param maximumChunkSize The maximum number of bytes handed to the port at once, 0 keeps the current limit.
+     * \return A future which finishes as soon as the data has left the host.
+     */
+    QFuture<void> write(QByteArray const& data, int maximumChunkSize=0);
+
+    /*!
+     * Queues the given \a task. Tasks are barriers: they only run after all previously queued
+     * data has been transmitted, and subsequent commands wait for them to complete.
+     *
+     * \param task The task to run on the I/O thread.
+     * \return A future which finishes as soon as the task has been executed.
+     */
+    QFuture<void> post(Task const& task);
+
+    /*!
+     * Gets a future which finishes as soon as all commands queued so far are done.
+     *
+     * \return A future for the transmission of all queued commands.
+     */
+    QFuture<void> transmitted();
+
+    /*!
+     * Blocks until all queued commands are done.
+     *
+     * \param msecs The maximum time to wait in milliseconds. -1 waits without a timeout.
+     * \return \c true if no commands are pending anymore.
+     */
+    bool waitForIdle(int msecs=-1);
+
+    /*!
+     * Gets the measured throughput on the wire.
+     *
+     * \return The throughput in bytes per second.
+     */
+    double throughput() const;
+
+signals:
+    /*!
+     * Fired as soon as data has been received from the device.
+     *
+     * \param data The received bytes.
+     */
+    void dataReceived(QByteArray const& data);
+
+    /*!
+     * Fired as soon as data has left the host.
+     *
+     * \param bytes The number of bytes drained since the last notification.
+     */
+    void drained(qint64 bytes);
+
+    /*!
+     * Fired as soon as the measured throughput changed.
+     *
+     * \param bytesPerSecond The throughput on the wire in bytes per second.
+     */
+    void throughputChanged(double bytesPerSecond);
+
+    /*!
+     * Wakes up the I/O thread to process newly queued commands.
+     */
+    void commandQueued(QPrivateSignal);
+
+private:
+    struct Command {
+        QByteArray data;
+        int maximumChunkSize;
+        Task task;
+        QFutureInterface<void> result;
+    };
+
+    struct PendingWrite {
+        qint64 end;
+        QFutureInterface<void> result;
+    };
+
+    std::shared_ptr<QSerialPort> _serial;
+    QThread _thread{};
+    QObject* _context;
+    StreamWriter* _writer;
+
+    // Shared between the threads, guarded by the mutex.
+    QMutex _mutex{};
+    QWaitCondition _idle{};
+    QQueue<Command> _commands{};
+    int _outstanding{0};
+    bool _closing{false};
+    std::atomic<qint64> _throughput;
+
+    // Only accessed by the I/O thread.
+    QList<PendingWrite> _writes{};
+    qint64 _queued{0};
+    qint64 _drained{0};
+
+    QFuture<void> _enqueue(Command command);
+    void _process();
+    void _written(qint64 bytes);
+    void _finished();
+    void _dropWrites();
+    void _read();
+    void _complete(QFutureInterface<void>& result, bool success);
+};
+
+}
+
+#endif // EZGRAVER_SERIALWORKER_H
@@ -0,0 +1,200 @@
+#include "streamwriter.h"
+
+#include <QThread>
+#include <QDebug>
+
+#include <algorithm>
+
+#if defined(Q_OS_UNIX)
+#include <sys/ioctl.h>
+#include <termios.h>
+#endif
+
+#include "wiretrace.h"
+
+namespace Ez {
+
+int const StreamWriter::MinimumChunkSize;
+int const StreamWriter::ChunkDuration;
+int const StreamWriter::DriverLowWatermark;
+
+StreamWriter::StreamWriter(std::shared_ptr<QSerialPort> serial, QObject* parent) : QObject{parent}, _serial{serial} {
+    // Start with the nominal speed of the line until the first drain has been measured.
+    _throughput = _serial->baudRate() / 10.0;
+    _chunkSize = std::max(MinimumChunkSize, static_cast<int>(_throughput * ChunkDuration / 1000));
+
+    _drainTimer.setSingleShot(true);
+    connect(&_drainTimer, &QTimer::timeout, this, &StreamWriter::_poll);
+    connect(_serial.get(), &QSerialPort::bytesWritten, this, &StreamWriter::_bytesWritten);
+}
+
+StreamWriter::~StreamWriter() {}
+
+void StreamWriter::write(QByteArray const& data) {
+    if(data.isEmpty()) {
+        return;
+    }
+
+    _pending.enqueue(data);
+    if(!_busy) {
+        _busy = true;
+        _clock.start();
+    }
+
+    // Only refill if the previous chunk has been handed to the OS already. Otherwise the
+    // data is picked up as soon as the port reports it drained.
+    if(_written == _handed && !_drainTimer.isActive()) {
+        _refill();
+    }
+}
+
+void StreamWriter::cancel() {
+    _pending.clear();
+    _offset = 0;
+    _drainTimer.stop();
+    _handed = _written;
+    _drained = _written;
+    _busy = false;
+}
+
+bool StreamWriter::busy() const {
+    return _busy;
+}
+
+bool StreamWriter::waitForFinished(int msecs) {
+    QElapsedTimer timer{};
+    timer.start();
+
+    while(_busy) {
+        auto remaining = msecs < 0 ? -1 : msecs - static_cast<int>(timer.elapsed());
+        if(msecs >= 0 && remaining <= 0) {
+            return false;
+        }
+
+        if(_serial->bytesToWrite() > 0) {
+            // Emits bytesWritten which refills the port on its own.
+            if(!_serial->waitForBytesWritten(remaining)) {
+                return false;
+            }
+        } else {
+            // Waiting for the driver to drain, there is no signal for it.
+            _drainTimer.stop();
+            QThread::msleep(std::max(1, _drainDelay(_queuedInDriver())));
+            _poll();
+        }
+    }
+    return true;
+}
+
+double StreamWriter::throughput() const {
+    return _throughput;
+}
+
+int StreamWriter::chunkSize() const {
+    return _chunkSize;
+}
+
+void StreamWriter::setMaximumChunkSize(int maximumChunkSize) {
+    _maximumChunkSize = std::max(MinimumChunkSize, maximumChunkSize);
+    _chunkSize = std::min(_chunkSize, _maximumChunkSize);
+}
+
+void StreamWriter::_bytesWritten(qint64 bytes) {
+    _written += bytes;
+    _poll();
+}
+
+void StreamWriter::_poll() {
+    auto queued = _queuedInDriver();
+    auto left = _written - queued;
+    if(left > _drained) {
+        _measure(left - _drained);
+        emit drained(left - _drained);
+        _drained = left;
+    }
+
+    if(_refilling || _written < _handed) {
+        // The port still holds data of the current chunk.
+        return;
+    }
+
+    if(queued > DriverLowWatermark) {
+        _drainTimer.start(_drainDelay(queued));
+        return;
+    }
+
+    _refill();
+}
+
+void StreamWriter::_refill() {
+    if(_pending.isEmpty()) {
+        if(_busy && _drained >= _handed) {
+            _busy = false;
+            emit finished();
+        } else if(_busy) {
+            _drainTimer.start(_drainDelay(_handed - _drained));
+        }
+        return;
+    }
+
+    // Fill up a chunk, coalescing small commands queued after each other.
+    _refilling = true;
+    qint64 budget{_chunkSize};
+    while(budget > 0 && !_pending.isEmpty()) {
+        auto const& head = _pending.head();
+        auto size = std::min<qint64>(budget, head.size() - _offset);
+        auto written = _serial->write(head.constData() + _offset, size);
+        if(written < 0) {
+            qDebug() << "failed to write to serial port:" << _serial->errorString();
+            _refilling = false;
+            cancel();
+            emit finished();
+            return;
+        }
+
+        Trace::tx(head.constData() + _offset, static_cast<int>(written));
+        _handed += written;
+        _offset += written;
+        budget -= written;
+        if(_offset >= head.size()) {
+            _pending.dequeue();
+            _offset = 0;
+        }
+    }
+
+    // Hand the chunk to the OS right away, commands may depend on the timing (e.g. baud rate changes).
+    _serial->flush();
+    _refilling = false;
+    if(_written == _handed) {
+        _drainTimer.start(_drainDelay(_queuedInDriver()));
+    }
+}
+
+void StreamWriter::_measure(qint64 bytes) {
+    auto elapsed = _clock.nsecsElapsed();
+    _clock.restart();
+    if(elapsed <= 0) {
+        return;
+    }
+
+    auto rate = bytes * 1e9 / elapsed;
+    _throughput = _throughput * 0.75 + rate * 0.25;
+    _chunkSize = std::min(_maximumChunkSize, std::max(MinimumChunkSize, static_cast<int>(_throughput * ChunkDuration / 1000)));
+    emit throughputChanged(_throughput);
+}
+
+int StreamWriter::_drainDelay(qint64 queued) const {
+    return _throughput > 0 ? static_cast<int>(queued * 1000 / _throughput) : ChunkDuration;
+}
+
+qint64 StreamWriter::_queuedInDriver() const {
+#if defined(Q_OS_UNIX) && defined(TIOCOUTQ)
+    int queued{0};
+    if(::ioctl(_serial->handle(), TIOCOUTQ, &queued) == 0) {
+        return queued;
+    }
+#endif
+    return 0;
+}
+
+}
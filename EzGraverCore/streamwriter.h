@@ -0,0 +1,144 @@
+#ifndef EZGRAVER_STREAMWRITER_H
+#define EZGRAVER_STREAMWRITER_H
+
+#include "ezgravercore_global.h"
+
+#include <QObject>
+#include <QByteArray>
+#include <QQueue>
+#include <QSerialPort>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include <memory>
+
+namespace Ez {
+
+/*!
+ * Streams data to a serial port without flooding its write buffer. Data is handed to the
+ * port chunk by chunk straight out of the queued buffers, and the next chunk is only written
+ * once the previous one has drained. The chunk size follows the measured drain rate.
+ */
+class EZGRAVERCORESHARED_EXPORT StreamWriter : public QObject {
+    Q_OBJECT
+
+public:
+    /*!
+     * Creates a new instance writing to the given \a serial port.
+     *
+     * \param serial The serial port to write to.
+     * \param parent The parent of the writer.
+     */
+    explicit StreamWriter(std::shared_ptr<QSerialPort> serial, QObject* parent=NULL);
+
+    /*!
+     * Frees all required resources upon deconstruction.
+     */
+    virtual ~StreamWriter();
+
+    /*!
+     * Queues the given \a data for transmission. Data is transmitted in the order it has
+     * been queued. The buffer is shared, not copied.
+     *
+     * \param data The data to transmit.
+     */
+    void write(QByteArray const& data);
+
+    /*!
+     * Drops all data which has not yet been handed to the serial port and stops
+     * tracking the data already handed over.
+     */
+    void cancel();
+
+    /*!
+     * Gets if there is data which has not yet left the host.
+     *
+     * \return \c true if a transmission is in progress.
+     */
+    bool busy() const;
+
+    /*!
+     * Blocks until all queued data has left the host. This can be used if no event loop is running.
+     *
+     * \param msecs The maximum time to wait in milliseconds. -1 waits without a timeout.
+     * \return \c true if all data has been transmitted.
+     */
+    bool waitForFinished(int msecs=-1);
+
+    /*!
+     * Gets the measured throughput on the wire.
+     *
+     * \return The throughput in bytes per second.
+     */
+    double throughput() const;
+
+    /*!
+     * Gets the size of the chunks currently handed to the serial port.
+     *
+     * \return The chunk size in bytes.
+     */
+    int chunkSize() const;
+
+    /*!
+     * Limits the size of the chunks handed to the serial port.
+     *
+     * \param maximumChunkSize The maximum chunk size in bytes.
+     */
+    void setMaximumChunkSize(int maximumChunkSize);
+
+signals:
+    /*!
+     * Fired as soon as data has left the host. If the driver queue can be inspected, this
+     * reflects the data actually sent on the wire.
+     *
+     * \param bytes The number of bytes drained since the last notification.
+     */
+    void drained(qint64 bytes);
+
+    /*!
+     * Fired as soon as the measured throughput changed.
+     *
+     * \param bytesPerSecond The throughput on the wire in bytes per second.
+     */
+    void throughputChanged(double bytesPerSecond);
+
+    /*!
+     * Fired as soon as all queued data has left the host.
+     */
+    void finished();
+
+private:
+    /*! The minimum number of bytes handed to the port at once. */
+    static int const MinimumChunkSize{64};
+    /*! The duration in milliseconds a single chunk should take on the wire. */
+    static int const ChunkDuration{100};
+    /*! The number of bytes the driver may still hold before the next chunk is written. */
+    static int const DriverLowWatermark{64};
+
+    std::shared_ptr<QSerialPort> _serial;
+    QQueue<QByteArray> _pending{};
+    int _offset{0};
+
+    qint64 _handed{0};
+    qint64 _written{0};
+    qint64 _drained{0};
+    bool _busy{false};
+    bool _refilling{false};
+
+    int _chunkSize{MinimumChunkSize};
+    int _maximumChunkSize{8192};
+    double _throughput{0};
+    QElapsedTimer _clock{};
+    QTimer _drainTimer{this};
+
+    void _bytesWritten(qint64 bytes);
+    void _poll();
+    void _refill();
+    void _measure(qint64 bytes);
+    int _drainDelay(qint64 queued) const;
+    qint64 _queuedInDriver() const;
+};
+
+}
+
+#endif // EZGRAVER_STREAMWRITER_H
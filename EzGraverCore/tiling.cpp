@@ -0,0 +1,62 @@
+#include "tiling.h"
+
+#include <QString>
+#include <QColor>
+#include <QPainter>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "specifications.h"
+
+namespace Ez {
+
+namespace {
+
+int tileCount(int length, int tileLength, int overlap) {
+    if(length <= tileLength) {
+        return 1;
+    }
+    auto step = tileLength - overlap;
+    return 1 + (length - tileLength + step - 1) / step;
+}
+
+}
+
+QVector<Tile> tileGrid(QSize const& size, int overlap) {
+    if(size.isEmpty()) {
+        throw std::invalid_argument{"cannot tile an empty artwork"};
+    }
+    if(overlap < 0 || overlap * 2 >= std::min(Specifications::ImageWidth, Specifications::ImageHeight)) {
+        throw std::invalid_argument{QString{"unsupported tile overlap '%1'"}.arg(overlap).toStdString()};
+    }
+
+    auto rows = tileCount(size.height(), Specifications::ImageHeight, overlap);
+    auto columns = tileCount(size.width(), Specifications::ImageWidth, overlap);
+
+    QVector<Tile> tiles{};
+    tiles.reserve(rows * columns);
+    for(int row{0}; row < rows; ++row) {
+        for(int column{0}; column < columns; ++column) {
+            Tile tile{};
+            tile.row = row;
+            tile.column = column;
+            tile.area = QRect{column * (Specifications::ImageWidth - overlap), row * (Specifications::ImageHeight - overlap),
+                              Specifications::ImageWidth, Specifications::ImageHeight};
+            tiles.append(tile);
+        }
+    }
+    return tiles;
+}
+
+QImage tileImage(QImage const& artwork, Tile const& tile) {
+    // Draw white background, otherwise the area beyond the artwork is engraved.
+    QImage image{tile.area.size(), QImage::Format_ARGB32};
+    image.fill(QColor{Qt::white});
+    QPainter painter{&image};
+    painter.drawImage(QPoint{0, 0}, artwork, tile.area);
+    painter.end();
+    return image;
+}
+
+}
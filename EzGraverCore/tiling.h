@@ -0,0 +1,51 @@
+#ifndef EZGRAVER_TILING_H
+#define EZGRAVER_TILING_H
+
+#include "ezgravercore_global.h"
+
+#include <QImage>
+#include <QRect>
+#include <QSize>
+#include <QVector>
+
+namespace Ez {
+
+/*!
+ * A part of an artwork larger than the work area, engraved on its own after repositioning
+ * the workpiece.
+ */
+struct EZGRAVERCORESHARED_EXPORT Tile {
+    /*! The row of the tile within the grid. */
+    int row{0};
+
+    /*! The column of the tile within the grid. */
+    int column{0};
+
+    /*! The area of the artwork covered, always the size of the work area. May exceed the artwork at its right and bottom edge. */
+    QRect area{};
+};
+
+/*!
+ * Splits an artwork into a grid of tiles the size of the work area. Adjacent tiles share
+ * \a overlap pixels, which are engraved by both of them and thus hide small repositioning
+ * errors. The tiles are ordered row by row.
+ *
+ * \param size The size of the artwork in device pixels.
+ * \param overlap The number of pixels shared by adjacent tiles.
+ * \return The tiles covering the artwork.
+ * \throws std::invalid_argument Thrown if the artwork is empty or the overlap is not less than half the work area.
+ */
+EZGRAVERCORESHARED_EXPORT QVector<Tile> tileGrid(QSize const& size, int overlap);
+
+/*!
+ * Cuts the given \a tile out of the artwork. Parts of the tile beyond the artwork are white.
+ *
+ * \param artwork The artwork in device pixels.
+ * \param tile The tile to cut out.
+ * \return The image of the tile, the size of the work area.
+ */
+EZGRAVERCORESHARED_EXPORT QImage tileImage(QImage const& artwork, Tile const& tile);
+
+}
+
+#endif // EZGRAVER_TILING_H
@@ -0,0 +1,145 @@
+#include "wiretrace.h"
+
+#include <QFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace Ez {
+namespace Trace {
+
+namespace {
+
+/*! The number of bytes a single slot holds. Larger frames span several consecutive slots. */
+int const SlotBytes{112};
+
+/*! The number of slots in the ring. Has to be a power of two. */
+quint64 const SlotCount{8192};
+
+/*! The version of the file format written by dump. */
+quint16 const FormatVersion{1};
+
+struct Slot {
+    // Zero while being written, the index of the slot plus one as soon as it is complete.
+    std::atomic<quint64> sequence;
+    qint64 timestamp;
+    quint32 frameSize;
+    quint32 offset;
+    quint8 category;
+    quint8 length;
+    char bytes[SlotBytes];
+};
+
+struct Ring {
+    std::atomic<quint64> head;
+    std::atomic<bool> enabled;
+    QElapsedTimer clock;
+    qint64 epoch;
+    std::unique_ptr<Slot[]> slots;
+
+    Ring() : slots{new Slot[SlotCount]} {
+        head.store(0);
+        enabled.store(true);
+        for(quint64 i{0}; i < SlotCount; ++i) {
+            slots[i].sequence.store(0);
+        }
+        epoch = QDateTime::currentMSecsSinceEpoch();
+        clock.start();
+    }
+};
+
+Ring& ring() {
+    static Ring instance{};
+    return instance;
+}
+
+}
+
+bool enabled() {
+    return ring().enabled.load(std::memory_order_relaxed);
+}
+
+void setEnabled(bool enabled) {
+    ring().enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void record(Category category, char const* data, int size) {
+    auto& trace = ring();
+    auto timestamp = trace.clock.nsecsElapsed();
+    quint64 count{size > 0 ? static_cast<quint64>((size + SlotBytes - 1) / SlotBytes) : 1};
+    auto first = trace.head.fetch_add(count, std::memory_order_relaxed);
+
+    for(quint64 i{0}; i < count; ++i) {
+        auto index = first + i;
+        auto& slot = trace.slots[index & (SlotCount - 1)];
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        auto offset = static_cast<int>(i) * SlotBytes;
+        auto length = std::min(SlotBytes, size - offset);
+        slot.timestamp = timestamp;
+        slot.frameSize = static_cast<quint32>(size);
+        slot.offset = static_cast<quint32>(offset);
+        slot.category = static_cast<quint8>(category);
+        slot.length = static_cast<quint8>(std::max(0, length));
+        if(length > 0) {
+            std::memcpy(slot.bytes, data + offset, length);
+        }
+
+        slot.sequence.store(index + 1, std::memory_order_release);
+    }
+}
+
+bool dump(QString const& fileName) {
+    QFile file{fileName};
+    if(!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "failed to open trace file" << fileName << file.errorString();
+        return false;
+    }
+
+    auto& trace = ring();
+    QDataStream out{&file};
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData("EZTR", 4);
+    out << FormatVersion << trace.epoch;
+
+    auto head = trace.head.load(std::memory_order_acquire);
+    auto start = head > SlotCount ? head - SlotCount : 0;
+    int frames{0};
+    for(auto index = start; index < head; ++index) {
+        auto const& slot = trace.slots[index & (SlotCount - 1)];
+        if(slot.sequence.load(std::memory_order_acquire) != index + 1) {
+            // Still being written or already overwritten.
+            continue;
+        }
+
+        Slot copy;
+        copy.timestamp = slot.timestamp;
+        copy.frameSize = slot.frameSize;
+        copy.offset = slot.offset;
+        copy.category = slot.category;
+        copy.length = slot.length;
+        std::memcpy(copy.bytes, slot.bytes, copy.length);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.sequence.load(std::memory_order_relaxed) != index + 1) {
+            continue;
+        }
+
+        out << copy.timestamp << copy.category << copy.frameSize << copy.offset << copy.length;
+        out.writeRawData(copy.bytes, copy.length);
+        ++frames;
+    }
+
+    qDebug() << "dumped" << frames << "trace slots to" << fileName;
+    return out.status() == QDataStream::Ok;
+}
+
+}
+}
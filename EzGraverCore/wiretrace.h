@@ -0,0 +1,98 @@
+#ifndef EZGRAVER_WIRETRACE_H
+#define EZGRAVER_WIRETRACE_H
+
+#include "ezgravercore_global.h"
+
+#include <QByteArray>
+#include <QString>
+
+/*! Category of data sent to the engraver. */
+#define EZ_TRACE_TX 0x01
+/*! Category of data received from the engraver. */
+#define EZ_TRACE_RX 0x02
+
+// The categories compiled into the binary. Defining EZ_TRACE_CATEGORIES=0
+// removes every trace point at compile time.
+#ifndef EZ_TRACE_CATEGORIES
+#define EZ_TRACE_CATEGORIES (EZ_TRACE_TX | EZ_TRACE_RX)
+#endif
+
+namespace Ez {
+namespace Trace {
+
+/*! The categories a traced frame belongs to. */
+enum class Category : quint8 {
+    Tx = EZ_TRACE_TX,
+    Rx = EZ_TRACE_RX
+};
+
+/*!
+ * Gets if the given \a category has been compiled in.
+ *
+ * \param category The category to check.
+ * \return \c true if trace points of the category are present.
+ */
+constexpr bool compiledIn(Category category) {
+    return (EZ_TRACE_CATEGORIES & static_cast<quint8>(category)) != 0;
+}
+
+/*!
+ * Gets if tracing is enabled at runtime. It is enabled by default.
+ *
+ * \return \c true if frames are recorded.
+ */
+EZGRAVERCORESHARED_EXPORT bool enabled();
+
+/*!
+ * Enables or disables the recording of frames at runtime.
+ *
+ * \param enabled \c true if frames should be recorded.
+ */
+EZGRAVERCORESHARED_EXPORT void setEnabled(bool enabled);
+
+/*!
+ * Records the given frame into the trace buffer. The buffer is lock-free and keeps
+ * the most recent frames only. Use the category specific functions instead, which
+ * vanish if the category is compiled out.
+ *
+ * \param category The category of the frame.
+ * \param data The bytes of the frame.
+ * \param size The number of bytes of the frame.
+ */
+EZGRAVERCORESHARED_EXPORT void record(Category category, char const* data, int size);
+
+/*!
+ * Writes the currently buffered frames into the given file. Recording continues while dumping.
+ *
+ * \param fileName The file to write the trace to.
+ * \return \c true if the trace has been written successfully.
+ */
+EZGRAVERCORESHARED_EXPORT bool dump(QString const& fileName);
+
+/*!
+ * Records data sent to the engraver.
+ *
+ * \param data The bytes sent.
+ * \param size The number of bytes sent.
+ */
+inline void tx(char const* data, int size) {
+    if(compiledIn(Category::Tx) && enabled()) {
+        record(Category::Tx, data, size);
+    }
+}
+
+/*!
+ * Records data received from the engraver.
+ *
+ * \param data The bytes received.
+ */
+inline void rx(QByteArray const& data) {
+    if(compiledIn(Category::Rx) && enabled()) {
+        record(Category::Rx, data.constData(), data.size());
+    }
+}
+
+}
+}
+
+#endif // EZGRAVER_WIRETRACE_H
@@ -0,0 +1,26 @@
+include(../common.pri)
+
+QT += core
+QT += serialport
+QT += concurrent
+QT += network
+
+TARGET = EzGraverDaemon
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+SOURCES += main.cpp \
+    daemon.cpp \
+    devicesession.cpp
+
+HEADERS += daemon.h \
+    devicesession.h
+
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../EzGraverCore/release/ -lEzGraverCore
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../EzGraverCore/debug/ -lEzGraverCore
+else:unix: LIBS += -L$$OUT_PWD/../EzGraverCore/ -lEzGraverCore
+
+INCLUDEPATH += $$PWD/../EzGraverCore
+DEPENDPATH += $$PWD/../EzGraverCore
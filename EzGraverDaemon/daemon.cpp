@@ -0,0 +1,244 @@
+#include "daemon.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonParseError>
+#include <QDir>
+#include <QDebug>
+
+#include <iterator>
+#include <stdexcept>
+#include <exception>
+
+#include "factory.h"
+#include "batchjob.h"
+#include "devicesession.h"
+
+int const Daemon::MaximumLineLength;
+int const Daemon::ProbeTimeout;
+
+Daemon::Daemon(QObject* parent) : QObject{parent}, _server{new QLocalServer{this}} {
+    _server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(_server, &QLocalServer::newConnection, this, &Daemon::_connected);
+}
+
+void Daemon::listen(QString const& name) {
+    // Only a socket nobody answers on is stale, a running daemon keeps its clients.
+    QLocalSocket probe{};
+    probe.connectToServer(name);
+    if(probe.waitForConnected(ProbeTimeout)) {
+        probe.disconnectFromServer();
+        throw std::runtime_error{QString{"another instance is already listening on %1"}.arg(name).toStdString()};
+    }
+    QLocalServer::removeServer(name);
+    if(!_server->listen(name)) {
+        throw std::runtime_error{QString{"failed to listen on %1: %2"}.arg(name, _server->errorString()).toStdString()};
+    }
+}
+
+QString Daemon::socketPath() const {
+    return _server->fullServerName();
+}
+
+void Daemon::_connected() {
+    while(auto socket = _server->nextPendingConnection()) {
+        _clients.insert(socket, Client{});
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket] { _readyRead(socket); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket] { _disconnected(socket); });
+    }
+}
+
+void Daemon::_readyRead(QLocalSocket* socket) {
+    if(!_clients.contains(socket)) {
+        return;
+    }
+
+    auto& buffer = _clients[socket].buffer;
+    buffer.append(socket->readAll());
+
+    int end{0};
+    while((end = buffer.indexOf('\n')) >= 0) {
+        auto line = buffer.left(end).trimmed();
+        buffer.remove(0, end + 1);
+        if(line.isEmpty()) {
+            continue;
+        }
+
+        QJsonParseError error{};
+        auto document = QJsonDocument::fromJson(line, &error);
+        if(error.error != QJsonParseError::NoError || !document.isObject()) {
+            _send(socket, QJsonObject{{"ok", false}, {"error", "request is not a JSON object"}});
+            continue;
+        }
+
+        auto request = document.object();
+        QJsonObject reply{};
+        try {
+            reply = _handle(socket, request);
+            reply.insert("ok", true);
+        } catch(std::exception const& e) {
+            reply = QJsonObject{{"ok", false}, {"error", QString::fromUtf8(e.what())}};
+        }
+        if(request.contains("id")) {
+            reply.insert("id", request["id"]);
+        }
+        _send(socket, reply);
+
+        // The request may have closed the connection, e.g. through a failing write.
+        if(!_clients.contains(socket)) {
+            return;
+        }
+    }
+
+    if(buffer.size() > MaximumLineLength) {
+        qDebug() << "closing client exceeding the maximum request length";
+        socket->abort();
+    }
+}
+
+void Daemon::_disconnected(QLocalSocket* socket) {
+    _clients.remove(socket);
+    socket->deleteLater();
+}
+
+void Daemon::_broadcast(QJsonObject const& event) {
+    auto port = event["port"].toString();
+    if(event["event"].toString() == "finished") {
+        _jobs.remove(event["job"].toInt());
+    }
+
+    for(auto it = _clients.cbegin(); it != _clients.cend(); ++it) {
+        if(it->subscribed && (it->filter.isEmpty() || it->filter == port)) {
+            _send(it.key(), event);
+        }
+    }
+}
+
+void Daemon::_send(QLocalSocket* socket, QJsonObject const& message) {
+    socket->write(QJsonDocument{message}.toJson(QJsonDocument::Compact));
+    socket->write("\n");
+}
+
+QJsonObject Daemon::_handle(QLocalSocket* socket, QJsonObject const& request) {
+    auto command = request["command"].toString();
+
+    if(command == "ports") {
+        return QJsonObject{{"ports", QJsonArray::fromStringList(Ez::availablePorts())}};
+    }
+    if(command == "devices") {
+        QJsonArray devices{};
+        for(auto session : _sessions) {
+            devices.append(session->describe());
+        }
+        return QJsonObject{{"devices", devices}};
+    }
+    if(command == "subscribe") {
+        auto& client = _clients[socket];
+        client.subscribed = true;
+        client.filter = request["port"].toString();
+        return QJsonObject{};
+    }
+
+    if(command == "open") {
+        auto port = request["port"].toString();
+        if(port.isEmpty()) {
+            throw std::invalid_argument{"no port provided"};
+        }
+        if(!_sessions.contains(port)) {
+            auto protocol = request["protocol"].toInt(Ez::AutoDetect);
+            if(protocol != Ez::AutoDetect) {
+                Ez::forgetProtocol(Ez::deviceId(port));
+            }
+            auto session = new DeviceSession{port, protocol, this};
+            connect(session, &DeviceSession::event, this, &Daemon::_broadcast);
+            _sessions.insert(port, session);
+        }
+        return _sessions[port]->describe();
+    }
+    if(command == "close") {
+        auto session = _session(request);
+        session->cancelAll();
+        _sessions.remove(session->portName());
+        for(auto it = _jobs.begin(); it != _jobs.end();) {
+            it = it.value() == session ? _jobs.erase(it) : std::next(it);
+        }
+        session->deleteLater();
+        return QJsonObject{};
+    }
+
+    if(command == "submit") {
+        auto session = _session(request);
+        auto directory = request.contains("directory") ? QDir{request["directory"].toString()} : QDir::current();
+        auto job = Ez::parseJob(request["job"].toObject(), directory);
+        if(job.tiled) {
+            throw std::invalid_argument{"tiled jobs need an operator and are only supported by the batch mode"};
+        }
+
+        auto id = _nextJob++;
+        _jobs.insert(id, session);
+        session->submit(id, job);
+        return QJsonObject{{"job", id}};
+    }
+    if(command == "cancel") {
+        auto id = request["job"].toInt(-1);
+        auto session = _jobs.value(id);
+        if(!session || !session->cancel(id)) {
+            throw std::invalid_argument{QString{"unknown job %1"}.arg(id).toStdString()};
+        }
+        return QJsonObject{};
+    }
+
+    if(command == "home") {
+        _idleSession(request)->engraver()->home();
+        return QJsonObject{};
+    }
+    if(command == "center") {
+        _idleSession(request)->engraver()->center();
+        return QJsonObject{};
+    }
+    if(command == "preview") {
+        _idleSession(request)->engraver()->preview();
+        return QJsonObject{};
+    }
+    if(command == "start") {
+        auto burnTime = request["burnTime"].toInt(60);
+        if(burnTime < 1 || burnTime > 255) {
+            throw std::invalid_argument{QString{"invalid burn time %1"}.arg(burnTime).toStdString()};
+        }
+        _idleSession(request)->engraver()->start(static_cast<unsigned char>(burnTime));
+        return QJsonObject{};
+    }
+
+    // Stopping the engraver always takes precedence over its jobs.
+    if(command == "pause" || command == "reset") {
+        auto session = _session(request);
+        session->cancelAll();
+        if(command == "pause") {
+            session->engraver()->pause();
+        } else {
+            session->engraver()->reset();
+        }
+        return QJsonObject{};
+    }
+
+    throw std::invalid_argument{QString{"unknown command '%1'"}.arg(command).toStdString()};
+}
+
+DeviceSession* Daemon::_session(QJsonObject const& request) const {
+    auto port = request["port"].toString();
+    auto session = _sessions.value(port);
+    if(!session) {
+        throw std::invalid_argument{QString{"port '%1' is not open"}.arg(port).toStdString()};
+    }
+    return session;
+}
+
+DeviceSession* Daemon::_idleSession(QJsonObject const& request) const {
+    auto session = _session(request);
+    if(session->busy()) {
+        throw std::runtime_error{"engraver is busy"};
+    }
+    return session;
+}
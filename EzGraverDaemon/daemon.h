@@ -0,0 +1,88 @@
+#ifndef EZGRAVER_DAEMON_H
+#define EZGRAVER_DAEMON_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QByteArray>
+#include <QJsonObject>
+
+class QLocalServer;
+class QLocalSocket;
+class DeviceSession;
+
+/*!
+ * Serves the engravers attached to the host on a local socket, a Unix domain socket on
+ * Unix. Clients send one JSON object per line, each containing a \c command and an
+ * optional \c id echoed in the reply:
+ *
+ * - \c ports lists the available ports
+ * - \c devices lists the open connections and their jobs
+ * - \c open connects to a \c port, optionally using the given \c protocol
+ * - \c close cancels all jobs of a \c port and disconnects
+ * - \c submit queues a \c job on a \c port, the job having the format of a batch manifest entry
+ * - \c cancel cancels the \c job with the given identifier
+ * - \c home, \c center, \c preview and \c start control an idle engraver directly
+ * - \c pause and \c reset stop the engraver and cancel its jobs
+ * - \c subscribe streams the events of all ports or the given \c port to the client
+ *
+ * Replies contain \c ok and either the result or an \c error.
+ */
+class Daemon : public QObject {
+    Q_OBJECT
+
+public:
+    /*! The longest request line accepted, longer ones close the connection. */
+    static int const MaximumLineLength{1 << 20};
+
+    /*! The time in ms to await another instance answering on the socket. */
+    static int const ProbeTimeout{1000};
+
+    /*!
+     * Creates a new daemon.
+     *
+     * \param parent The parent of the daemon.
+     */
+    explicit Daemon(QObject* parent=NULL);
+
+    /*!
+     * Starts listening on the given socket. A stale socket left by a crashed daemon is removed,
+     * one another instance is still listening on is left alone.
+     *
+     * \param name The name or path of the socket.
+     * \throws std::runtime_error Thrown if another instance listens on the socket or it cannot be listened on.
+     */
+    void listen(QString const& name);
+
+    /*!
+     * Gets the full path of the socket listened on.
+     *
+     * \return The path of the socket.
+     */
+    QString socketPath() const;
+
+private:
+    struct Client {
+        QByteArray buffer{};
+        bool subscribed{false};
+        QString filter{};
+    };
+
+    QLocalServer* _server;
+    QHash<QLocalSocket*, Client> _clients{};
+    QHash<QString, DeviceSession*> _sessions{};
+    QHash<int, DeviceSession*> _jobs{};
+    int _nextJob{1};
+
+    void _connected();
+    void _readyRead(QLocalSocket* socket);
+    void _disconnected(QLocalSocket* socket);
+    void _broadcast(QJsonObject const& event);
+    void _send(QLocalSocket* socket, QJsonObject const& message);
+
+    QJsonObject _handle(QLocalSocket* socket, QJsonObject const& request);
+    DeviceSession* _session(QJsonObject const& request) const;
+    DeviceSession* _idleSession(QJsonObject const& request) const;
+};
+
+#endif // EZGRAVER_DAEMON_H
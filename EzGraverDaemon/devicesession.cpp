@@ -0,0 +1,189 @@
+#include "devicesession.h"
+
+#include <QJsonArray>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDebug>
+
+#include <algorithm>
+
+#include "factory.h"
+#include "serialworker.h"
+
+DeviceSession::DeviceSession(QString const& portName, int protocol, QObject* parent)
+        : QObject{parent}, _portName{portName}, _engraver{Ez::create(portName, protocol)}, _layerJob{_engraver} {
+    connect(&_conversion, &QFutureWatcherBase::finished, this, &DeviceSession::_conversionFinished);
+
+    connect(&_layerJob, &Ez::LayerJob::layerStarted, this, [this](int layer, int pixels) {
+        _reportedProgress = 0;
+        _emit("layerStarted", QJsonObject{{"job", _current}, {"layer", layer}, {"pixels", pixels}});
+    });
+    connect(&_layerJob, &Ez::LayerJob::layerProgressed, this, [this](int layer, int engraved, int pixels) {
+        // Subscribers are notified every percent, not for every pixel.
+        auto progress = engraved * 100 / std::max(pixels, 1);
+        if(progress > _reportedProgress) {
+            _reportedProgress = progress;
+            _emit("progress", QJsonObject{{"job", _current}, {"layer", layer}, {"engraved", engraved}, {"pixels", pixels},
+                                          {"remaining", static_cast<double>(_layerJob.remainingTime())}});
+        }
+    });
+    connect(&_layerJob, &Ez::LayerJob::layerFinished, this, [this](Ez::LayerTiming const& timing) {
+        _emit("layerFinished", QJsonObject{{"job", _current}, {"layer", timing.layer}, {"skipped", timing.skipped},
+                                           {"incomplete", timing.incomplete}, {"erase", static_cast<double>(timing.erase)},
+                                           {"upload", static_cast<double>(timing.upload)}, {"engrave", static_cast<double>(timing.engrave)},
+                                           {"planned", static_cast<double>(timing.planned)}});
+    });
+    connect(&_layerJob, &Ez::LayerJob::finished, this, [this] { _jobFinished(false, QString{}); });
+    connect(&_layerJob, &Ez::LayerJob::failed, this, [this](QString const& reason) { _jobFinished(true, reason); });
+
+    // The session is the only consumer of the frames, see LayerJob.
+    connect(_engraver.get(), &Ez::EzGraver::frameDecoded, &_layerJob, &Ez::LayerJob::processFrame);
+}
+
+QString DeviceSession::portName() const {
+    return _portName;
+}
+
+std::shared_ptr<Ez::EzGraver> DeviceSession::engraver() const {
+    return _engraver;
+}
+
+bool DeviceSession::busy() const {
+    return _current >= 0 || _converting >= 0 || _prepared >= 0 || !_queue.isEmpty();
+}
+
+QJsonObject DeviceSession::describe() const {
+    QJsonArray queued{};
+    if(_prepared >= 0) {
+        queued.append(_prepared);
+    } else if(_converting >= 0 && !_convertingCanceled) {
+        queued.append(_converting);
+    }
+    for(auto const& entry : _queue) {
+        queued.append(entry.id);
+    }
+
+    return QJsonObject{{"port", _portName}, {"protocol", _engraver->protocol()}, {"job", _current}, {"queued", queued},
+                       {"remaining", static_cast<double>(_layerJob.remainingTime())}};
+}
+
+void DeviceSession::submit(int id, Ez::BatchJob const& job) {
+    _queue.enqueue(QueuedJob{id, job});
+    _emit("queued", QJsonObject{{"job", id}, {"image", job.image}});
+    _advance();
+}
+
+bool DeviceSession::cancel(int id) {
+    for(int i{0}; i < _queue.size(); ++i) {
+        if(_queue[i].id == id) {
+            _queue.removeAt(i);
+            _emit("finished", QJsonObject{{"job", id}, {"failed", true}, {"reason", "job canceled"}});
+            return true;
+        }
+    }
+
+    if(id == _converting && !_convertingCanceled) {
+        // The conversion cannot be interrupted, its result is dropped.
+        _convertingCanceled = true;
+        _emit("finished", QJsonObject{{"job", id}, {"failed", true}, {"reason", "job canceled"}});
+        return true;
+    }
+    if(id == _prepared) {
+        _prepared = -1;
+        _preparedJob = Ez::ConvertedJob{};
+        _emit("finished", QJsonObject{{"job", id}, {"failed", true}, {"reason", "job canceled"}});
+        _advance();
+        return true;
+    }
+    if(id == _current) {
+        _layerJob.cancel();
+        return true;
+    }
+    return false;
+}
+
+void DeviceSession::cancelAll() {
+    while(!_queue.isEmpty()) {
+        cancel(_queue.last().id);
+    }
+    if(_converting >= 0) {
+        cancel(_converting);
+    }
+    if(_prepared >= 0) {
+        cancel(_prepared);
+    }
+    if(_current >= 0) {
+        cancel(_current);
+    }
+}
+
+void DeviceSession::_advance() {
+    if(_converting < 0 && _prepared < 0 && !_queue.isEmpty()) {
+        auto next = _queue.dequeue();
+        _converting = next.id;
+        _convertingCanceled = false;
+        // Packed along, the layers are ready to be uploaded as soon as the device is.
+        auto format = _engraver->payloadFormat();
+        _conversion.setFuture(QtConcurrent::run([next, format] {
+            auto converted = Ez::convertJob(next.job);
+            Ez::packJob(converted, format);
+            return converted;
+        }));
+    }
+
+    if(_current >= 0 || _prepared < 0) {
+        return;
+    }
+
+    _current = _prepared;
+    auto layers = _preparedJob.layers;
+    _prepared = -1;
+    _preparedJob = Ez::ConvertedJob{};
+
+    _jobClock.start();
+    _layerJob.setLayers(layers);
+    _emit("started", QJsonObject{{"job", _current}, {"planned", static_cast<double>(_layerJob.predictedTime())}});
+    _layerJob.start();
+
+    // The next job is converted while this one is on the device.
+    _advance();
+}
+
+void DeviceSession::_conversionFinished() {
+    auto id = _converting;
+    auto canceled = _convertingCanceled;
+    auto converted = _conversion.result();
+    _converting = -1;
+    _convertingCanceled = false;
+
+    if(canceled) {
+        _advance();
+        return;
+    }
+    if(!converted.error.isEmpty()) {
+        _emit("finished", QJsonObject{{"job", id}, {"failed", true}, {"reason", converted.error}});
+        _advance();
+        return;
+    }
+
+    _emit("converted", QJsonObject{{"job", id}, {"duration", static_cast<double>(converted.duration)}});
+    _prepared = id;
+    _preparedJob = converted;
+    _advance();
+}
+
+void DeviceSession::_jobFinished(bool failed, QString const& reason) {
+    QJsonObject event{{"job", _current}, {"failed", failed}, {"elapsed", static_cast<double>(_jobClock.elapsed())}};
+    if(failed) {
+        event.insert("reason", reason);
+    }
+    _current = -1;
+    _emit("finished", event);
+    _advance();
+}
+
+void DeviceSession::_emit(QString const& name, QJsonObject event) {
+    qDebug() << _portName << name << event;
+    event.insert("event", name);
+    event.insert("port", _portName);
+    emit this->event(event);
+}
@@ -0,0 +1,120 @@
+#ifndef EZGRAVER_DEVICESESSION_H
+#define EZGRAVER_DEVICESESSION_H
+
+#include <QObject>
+#include <QString>
+#include <QQueue>
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+
+#include <memory>
+
+#include "ezgraver.h"
+#include "layerjob.h"
+#include "batchjob.h"
+
+/*!
+ * Keeps the connection to a single engraver open and runs the jobs submitted for it one after
+ * another. The next job is converted while the current one is on the device. Everything
+ * happening on the device is reported as an event.
+ */
+class DeviceSession : public QObject {
+    Q_OBJECT
+
+public:
+    /*!
+     * Connects to the engraver on the given port.
+     *
+     * \param portName The port the engraver is attached to.
+     * \param protocol The protocol version or \a Ez::AutoDetect.
+     * \param parent The parent of the session.
+     * \throws std::runtime_error Thrown if the connection cannot be established.
+     */
+    explicit DeviceSession(QString const& portName, int protocol, QObject* parent=NULL);
+
+    /*!
+     * Gets the port of the engraver.
+     *
+     * \return The port name.
+     */
+    QString portName() const;
+
+    /*!
+     * Gets the connected engraver.
+     *
+     * \return The engraver.
+     */
+    std::shared_ptr<Ez::EzGraver> engraver() const;
+
+    /*!
+     * Gets if a job is being run or waiting to be run.
+     *
+     * \return \c true if the engraver must not be controlled directly.
+     */
+    bool busy() const;
+
+    /*!
+     * Describes the session, i.e. its port, protocol, running and queued jobs.
+     *
+     * \return The state of the session.
+     */
+    QJsonObject describe() const;
+
+    /*!
+     * Appends a job to the queue of the engraver.
+     *
+     * \param id The identifier of the job, reported along with its events.
+     * \param job The job to engrave.
+     */
+    void submit(int id, Ez::BatchJob const& job);
+
+    /*!
+     * Cancels the given job, whether it is already running or still queued.
+     *
+     * \param id The identifier of the job.
+     * \return \c true if the job belonged to this session.
+     */
+    bool cancel(int id);
+
+    /*!
+     * Cancels all jobs.
+     */
+    void cancelAll();
+
+signals:
+    /*!
+     * Fired for everything happening on the device.
+     *
+     * \param event The event, always containing its name and the port.
+     */
+    void event(QJsonObject const& event);
+
+private:
+    struct QueuedJob {
+        int id;
+        Ez::BatchJob job;
+    };
+
+    QString _portName;
+    std::shared_ptr<Ez::EzGraver> _engraver;
+    Ez::LayerJob _layerJob;
+    QQueue<QueuedJob> _queue{};
+
+    QFutureWatcher<Ez::ConvertedJob> _conversion{};
+    int _converting{-1};
+    bool _convertingCanceled{false};
+    int _prepared{-1};
+    Ez::ConvertedJob _preparedJob{};
+
+    int _current{-1};
+    int _reportedProgress{0};
+    QElapsedTimer _jobClock{};
+
+    void _advance();
+    void _conversionFinished();
+    void _jobFinished(bool failed, QString const& reason);
+    void _emit(QString const& name, QJsonObject event);
+};
+
+#endif // EZGRAVER_DEVICESESSION_H
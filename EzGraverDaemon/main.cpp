@@ -0,0 +1,32 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+
+#include <iostream>
+#include <exception>
+
+#include "daemon.h"
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app{argc, argv};
+    app.setApplicationName("EzGraverDaemon");
+
+    QCommandLineParser parser{};
+    parser.setApplicationDescription("Serves NEJE engravers to local clients through a JSON job API.");
+    parser.addHelpOption();
+
+    QCommandLineOption socketOption{QStringList{"s", "socket"}, "The name or path of the local socket.", "name", "ezgraver"};
+    parser.addOption(socketOption);
+    parser.process(app);
+
+    try {
+        Daemon daemon{};
+        daemon.listen(parser.value(socketOption));
+
+        std::cout << "listening on " << daemon.socketPath().toStdString() << std::endl;
+        return app.exec();
+    } catch(std::exception const& e) {
+        std::cout << "Error: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,20 @@
+include(../common.pri)
+
+QT += core
+QT -= gui
+
+TARGET = EzGraverSim
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+SOURCES += main.cpp \
+    pseudoterminal.cpp \
+    simulator.cpp
+
+HEADERS += pseudoterminal.h \
+    simulator.h
+
+INCLUDEPATH += $$PWD/../EzGraverCore
+DEPENDPATH += $$PWD/../EzGraverCore
@@ -0,0 +1,52 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+
+#include <iostream>
+#include <exception>
+
+#include "pseudoterminal.h"
+#include "simulator.h"
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app{argc, argv};
+    app.setApplicationName("EzGraverSim");
+
+    QCommandLineParser parser{};
+    parser.setApplicationDescription("Simulates a NEJE engraver on a pseudo-terminal.");
+    parser.addHelpOption();
+
+    QCommandLineOption protocolOption{QStringList{"p", "protocol"}, "The protocol version to simulate (1-4).", "version", "1"};
+    QCommandLineOption eraseOption{QStringList{"e", "erase-time"}, "The time it takes to erase the EEPROM in ms.", "msecs"};
+    QCommandLineOption pixelRateOption{QStringList{"r", "pixel-rate"}, "The number of pixels engraved per second.", "pixels", "1000"};
+    QCommandLineOption linkOption{QStringList{"l", "link"}, "Creates a symbolic link to the pseudo-terminal.", "path"};
+    QCommandLineOption lineSpeedOption{QStringList{"s", "line-speed"}, "Limits the received data to what the baud rate is able to carry."};
+    QCommandLineOption singleSpeedOption{QStringList{"single-speed"}, "Ignores the request of protocol v4 to switch to double speed."};
+    parser.addOptions(QList<QCommandLineOption>{protocolOption, eraseOption, pixelRateOption, linkOption, lineSpeedOption, singleSpeedOption});
+    parser.process(app);
+
+    try {
+        auto protocol = parser.value(protocolOption).toInt();
+        PseudoTerminal terminal{};
+        Simulator simulator{&terminal, protocol};
+
+        if(parser.isSet(eraseOption)) {
+            simulator.setEraseTime(parser.value(eraseOption).toInt());
+        }
+        simulator.setPixelRate(parser.value(pixelRateOption).toInt());
+        simulator.setLineSpeedEmulated(parser.isSet(lineSpeedOption));
+        simulator.setDoubleSpeedSupported(!parser.isSet(singleSpeedOption));
+
+        auto portName = terminal.portName();
+        if(parser.isSet(linkOption)) {
+            terminal.link(parser.value(linkOption));
+            portName = parser.value(linkOption);
+        }
+
+        std::cout << "simulating protocol v" << protocol << " on " << portName.toStdString() << std::endl;
+        return app.exec();
+    } catch(std::exception const& e) {
+        std::cout << "Error: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,144 @@
+#include "pseudoterminal.h"
+
+#include <QFile>
+#include <QDebug>
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+namespace {
+
+std::runtime_error systemError(QString const& message) {
+    return std::runtime_error{QString{"%1 (%2)"}.arg(message, QString::fromLocal8Bit(strerror(errno))).toStdString()};
+}
+
+}
+
+PseudoTerminal::PseudoTerminal(QObject* parent) : QObject{parent} {
+    _master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(_master < 0 || grantpt(_master) != 0 || unlockpt(_master) != 0) {
+        throw systemError("failed to open pseudo-terminal");
+    }
+    _portName = QString::fromLocal8Bit(ptsname(_master));
+
+    // Keep the slave open, otherwise the master reports errors whenever no client is connected.
+    _slave = ::open(ptsname(_master), O_RDWR | O_NOCTTY);
+    if(_slave < 0) {
+        throw systemError("failed to open pseudo-terminal slave");
+    }
+
+    termios settings{};
+    tcgetattr(_slave, &settings);
+    cfmakeraw(&settings);
+    cfsetspeed(&settings, B57600);
+    tcsetattr(_slave, TCSANOW, &settings);
+
+    fcntl(_master, F_SETFL, fcntl(_master, F_GETFL) | O_NONBLOCK);
+    _notifier = new QSocketNotifier{_master, QSocketNotifier::Read, this};
+    connect(_notifier, &QSocketNotifier::activated, this, &PseudoTerminal::readyRead);
+
+    _writeNotifier = new QSocketNotifier{_master, QSocketNotifier::Write, this};
+    _writeNotifier->setEnabled(false);
+    connect(_writeNotifier, &QSocketNotifier::activated, this, &PseudoTerminal::_flush);
+}
+
+PseudoTerminal::~PseudoTerminal() {
+    if(!_link.isEmpty()) {
+        QFile::remove(_link);
+    }
+    ::close(_slave);
+    ::close(_master);
+}
+
+QString PseudoTerminal::portName() const {
+    return _portName;
+}
+
+void PseudoTerminal::link(QString const& path) {
+    QFile::remove(path);
+    if(!QFile::link(_portName, path)) {
+        throw std::runtime_error{QString{"failed to link %1 to %2"}.arg(path, _portName).toStdString()};
+    }
+    _link = path;
+}
+
+QByteArray PseudoTerminal::read(int maxSize) {
+    QByteArray data{maxSize, Qt::Uninitialized};
+    auto size = ::read(_master, data.data(), maxSize);
+    if(size < 0) {
+        if(errno != EAGAIN && errno != EIO) {
+            qDebug() << "failed to read from pseudo-terminal:" << strerror(errno);
+        }
+        size = 0;
+    }
+    data.resize(static_cast<int>(size));
+    return data;
+}
+
+void PseudoTerminal::write(QByteArray const& data) {
+    // Like a device nobody listens to, data not fitting into the buffers is lost. Only whole
+    // writes are dropped, thus the client never receives a partial frame.
+    if(_pending.size() + data.size() > MaximumPendingSize) {
+        if(!_dropping) {
+            qDebug() << "client does not read, dropping data until it does";
+            _dropping = true;
+        }
+        return;
+    }
+    _dropping = false;
+    _pending.append(data);
+    _flush();
+}
+
+qint32 PseudoTerminal::baudRate() const {
+    termios settings{};
+    if(tcgetattr(_slave, &settings) != 0) {
+        return 0;
+    }
+
+    switch(cfgetospeed(&settings)) {
+    case B9600:
+        return 9600;
+    case B19200:
+        return 19200;
+    case B38400:
+        return 38400;
+    case B57600:
+        return 57600;
+    case B115200:
+        return 115200;
+    default:
+        return 0;
+    }
+}
+
+void PseudoTerminal::setReadEnabled(bool enabled) {
+    _notifier->setEnabled(enabled);
+}
+
+void PseudoTerminal::_flush() {
+    while(!_pending.isEmpty()) {
+        auto size = ::write(_master, _pending.constData(), _pending.size());
+        if(size < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            if(errno == EAGAIN) {
+                // The client does not keep up, the rest is sent once the kernel buffer drained.
+                _writeNotifier->setEnabled(true);
+                return;
+            }
+            qDebug() << "failed to write to pseudo-terminal:" << strerror(errno);
+            _pending.clear();
+            break;
+        }
+        _pending.remove(0, static_cast<int>(size));
+    }
+    _writeNotifier->setEnabled(false);
+}
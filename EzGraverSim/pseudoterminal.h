@@ -0,0 +1,99 @@
+#ifndef PSEUDOTERMINAL_H
+#define PSEUDOTERMINAL_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QSocketNotifier>
+
+/*!
+ * The master side of a pseudo-terminal. The slave side behaves like a serial port
+ * and can be opened by EzGraver just like a real device.
+ */
+class PseudoTerminal : public QObject {
+    Q_OBJECT
+
+public:
+    /*! The number of bytes queued for a client not reading at most. */
+    static int const MaximumPendingSize{1 << 16};
+
+    /*!
+     * Opens a new pseudo-terminal in raw mode.
+     *
+     * \param parent The parent of the terminal.
+     * \throws std::runtime_error Thrown if no pseudo-terminal could be opened.
+     */
+    explicit PseudoTerminal(QObject* parent=NULL);
+
+    /*!
+     * Closes the pseudo-terminal and removes the link if any.
+     */
+    virtual ~PseudoTerminal();
+
+    /*!
+     * Gets the path of the slave side which clients open.
+     *
+     * \return The path of the slave device.
+     */
+    QString portName() const;
+
+    /*!
+     * Creates a symbolic link to the slave side, replacing any existing file.
+     *
+     * \param path The path of the link to create.
+     * \throws std::runtime_error Thrown if the link could not be created.
+     */
+    void link(QString const& path);
+
+    /*!
+     * Reads at most \a maxSize bytes sent by the client.
+     *
+     * \param maxSize The maximum number of bytes to read.
+     * \return The bytes read.
+     */
+    QByteArray read(int maxSize);
+
+    /*!
+     * Sends the given \a data to the client without blocking. Data the kernel does not accept
+     * right away is queued and sent as soon as the client reads. Once the client stopped reading
+     * and \a MaximumPendingSize bytes are queued, further data is dropped.
+     *
+     * \param data The data to send.
+     */
+    void write(QByteArray const& data);
+
+    /*!
+     * Gets the baud rate the client configured on its side.
+     *
+     * \return The baud rate or 0 if unknown.
+     */
+    qint32 baudRate() const;
+
+    /*!
+     * Enables or disables the readyRead notification. Disabling it leaves incoming
+     * data in the kernel buffer which in turn applies backpressure on the client.
+     *
+     * \param enabled \c true if incoming data should be signalled.
+     */
+    void setReadEnabled(bool enabled);
+
+signals:
+    /*!
+     * Fired as soon as the client sent data.
+     */
+    void readyRead();
+
+private:
+    int _master{-1};
+    int _slave{-1};
+    QString _portName{};
+    QString _link{};
+    QSocketNotifier* _notifier{NULL};
+    QSocketNotifier* _writeNotifier{NULL};
+    QByteArray _pending{};
+    bool _dropping{false};
+
+    void _flush();
+};
+
+#endif // PSEUDOTERMINAL_H
@@ -0,0 +1,403 @@
+#include "simulator.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+#include "pseudoterminal.h"
+#include "specifications.h"
+
+namespace {
+
+int const BitmapHeaderSize{62};
+int const RowBytes{Ez::Specifications::ImageWidth / 8};
+int const PixelBytes{RowBytes * Ez::Specifications::ImageHeight};
+int const ReadSize{4096};
+int const EngraveInterval{20};
+int const LineInterval{5};
+
+}
+
+Simulator::Simulator(PseudoTerminal* terminal, int protocol, QObject* parent)
+        : QObject{parent}, _terminal{terminal}, _protocol{protocol}, _eraseTime{defaultEraseTime(protocol)} {
+    if(protocol < 1 || protocol > 4) {
+        throw std::invalid_argument{QString{"unsupported protocol '%1' selected"}.arg(protocol).toStdString()};
+    }
+    // An erased EEPROM does not contain any pixel to engrave.
+    _eeprom = QByteArray{_payloadSize(), _protocol < 3 ? '\xFF' : '\x00'};
+
+    _eraseTimer.setSingleShot(true);
+    _engraveTimer.setInterval(EngraveInterval);
+    _lineTimer.setInterval(LineInterval);
+
+    connect(_terminal, &PseudoTerminal::readyRead, this, &Simulator::_readyRead);
+    connect(&_eraseTimer, &QTimer::timeout, this, &Simulator::_erased);
+    connect(&_engraveTimer, &QTimer::timeout, this, &Simulator::_progress);
+    connect(&_lineTimer, &QTimer::timeout, this, &Simulator::_pace);
+}
+
+void Simulator::setEraseTime(int msecs) {
+    _eraseTime = msecs;
+}
+
+void Simulator::setPixelRate(int pixelsPerSecond) {
+    _pixelRate = pixelsPerSecond;
+}
+
+void Simulator::setLineSpeedEmulated(bool enabled) {
+    _lineSpeedEmulated = enabled;
+}
+
+void Simulator::setDoubleSpeedSupported(bool supported) {
+    _doubleSpeedSupported = supported;
+}
+
+int Simulator::defaultEraseTime(int protocol) {
+    // Slightly less than what the clients wait for.
+    return protocol < 3 ? 5000 : 40;
+}
+
+void Simulator::_readyRead() {
+    if(!_lineSpeedEmulated) {
+        _consume(_terminal->read(ReadSize));
+        return;
+    }
+
+    // Leaving the data in the kernel buffer throttles the client just like a slow line would.
+    _terminal->setReadEnabled(false);
+    if(!_lineTimer.isActive()) {
+        _lineBudget = 0;
+        _lineClock.start();
+        _lineTimer.start();
+    }
+}
+
+void Simulator::_pace() {
+    auto baudRate = _terminal->baudRate();
+    // 8N1 takes ten bit times per byte.
+    auto bytesPerSecond = (baudRate > 0 ? baudRate : _expectedBaudRate) / 10.0;
+    _lineBudget = std::min(_lineBudget + _lineClock.restart() * bytesPerSecond / 1000.0, bytesPerSecond / 10.0);
+
+    auto size = static_cast<int>(_lineBudget);
+    if(size == 0) {
+        return;
+    }
+
+    auto data = _terminal->read(size);
+    _lineBudget -= data.size();
+    if(data.size() < size) {
+        _lineTimer.stop();
+        _terminal->setReadEnabled(true);
+    }
+    _consume(data);
+}
+
+void Simulator::_consume(QByteArray const& data) {
+    if(data.isEmpty()) {
+        return;
+    }
+
+    auto baudRate = _terminal->baudRate();
+    if(baudRate != _expectedBaudRate) {
+        // A real device would only see garbage.
+        _dropped += data.size();
+        qDebug() << "dropping" << data.size() << "bytes sent with" << baudRate << "baud instead of" << _expectedBaudRate;
+        return;
+    }
+
+    int offset{0};
+    while(offset < data.size()) {
+        if(_state == State::Erasing) {
+            _dropped += data.size() - offset;
+            qDebug() << "dropping" << data.size() - offset << "bytes received while erasing";
+            return;
+        }
+
+        if(_state == State::Receiving) {
+            _receive(data, offset);
+            continue;
+        }
+
+        auto byte = static_cast<unsigned char>(data[offset++]);
+        if(_protocol < 3) {
+            _command1(byte);
+            continue;
+        }
+
+        if(_command.isEmpty() && byte != 0xFF) {
+            if(_protocol == 3 && byte == 0xF3) {
+                _move("home");
+            } else {
+                qDebug() << "ignoring unknown byte" << byte;
+            }
+            continue;
+        }
+
+        _command.append(static_cast<char>(byte));
+        if(_command.size() == 4) {
+            _command3(_command);
+            _command.clear();
+        }
+    }
+}
+
+void Simulator::_receive(QByteArray const& data, int& offset) {
+    if(_received == 0) {
+        _uploadClock.start();
+    }
+
+    auto size = std::min(data.size() - offset, _payloadSize() - _received);
+    std::memcpy(_eeprom.data() + _received, data.constData() + offset, size);
+    _received += size;
+    offset += size;
+
+    if(_received == _payloadSize()) {
+        _uploaded();
+    }
+}
+
+void Simulator::_command1(unsigned char byte) {
+    if(!_command.isEmpty() && _command[0] == '\xF5') {
+        _command.clear();
+        char const* directions[]{"up", "down", "left", "right"};
+        if(byte >= 0x01 && byte <= 0x04) {
+            _move(directions[byte - 1]);
+        } else {
+            qDebug() << "ignoring unknown move" << byte;
+        }
+        return;
+    }
+
+    if(byte == 0xFE) {
+        _command.append(static_cast<char>(byte));
+        if(_command.size() == 8) {
+            _command.clear();
+            _erase();
+        }
+        return;
+    }
+    _command.clear();
+
+    if(byte >= 0x01 && byte <= 0xF0) {
+        _burnTime = byte;
+        qDebug() << "burn time set to" << _burnTime;
+        return;
+    }
+
+    switch(byte) {
+    case 0xF1:
+        _start();
+        break;
+    case 0xF2:
+        _pause();
+        break;
+    case 0xF3:
+        _move("home");
+        break;
+    case 0xF4:
+        _move("preview");
+        break;
+    case 0xF5:
+        if(_protocol == 2) {
+            _command.append(static_cast<char>(byte));
+        } else {
+            _move("up");
+        }
+        break;
+    case 0xF6:
+        _move("down");
+        break;
+    case 0xF7:
+        _move("left");
+        break;
+    case 0xF8:
+        _move("right");
+        break;
+    case 0xF9:
+        _reset();
+        break;
+    case 0xFB:
+        _move("center");
+        break;
+    default:
+        qDebug() << "ignoring unknown command" << byte;
+    }
+}
+
+void Simulator::_command3(QByteArray const& frame) {
+    auto command = static_cast<unsigned char>(frame[1]);
+    auto argument = static_cast<unsigned char>(frame[2]);
+    char const* directions[]{"up", "down", "left", "right"};
+
+    switch(command) {
+    case 0x01:
+        if(argument == 0x01) {
+            _start();
+        } else {
+            _pause();
+        }
+        return;
+    case 0x02:
+        _move(argument == 0x01 ? "center" : "preview");
+        return;
+    case 0x03:
+        if(argument >= 0x01 && argument <= 0x04) {
+            _move(directions[argument - 1]);
+            return;
+        }
+        break;
+    case 0x04:
+        _reset();
+        return;
+    case 0x05:
+        _burnTime = argument;
+        qDebug() << "burn time set to" << _burnTime;
+        return;
+    case 0x06:
+        _erase();
+        return;
+    case 0x0A:
+    case 0x0B:
+        if(_protocol == 4) {
+            _move("home");
+            return;
+        }
+        break;
+    case 0x0E:
+        if(_protocol == 4 && static_cast<unsigned char>(frame[3]) == 0x00) {
+            qDebug() << "switching to regular speed";
+            _expectedBaudRate = 57600;
+            return;
+        }
+        if(_protocol == 4 && !_doubleSpeedSupported) {
+            qDebug() << "ignoring double speed request";
+            return;
+        }
+        if(_protocol == 4) {
+            qDebug() << "switching to double speed";
+            _expectedBaudRate = 115200;
+            return;
+        }
+        break;
+    }
+    qDebug() << "ignoring unknown command" << frame.toHex();
+}
+
+void Simulator::_erase() {
+    qDebug() << "erasing EEPROM";
+    _engraveTimer.stop();
+    _state = State::Erasing;
+    _eeprom.fill(_protocol < 3 ? '\xFF' : '\x00');
+    _eraseTimer.start(_eraseTime);
+}
+
+void Simulator::_erased() {
+    qDebug() << "EEPROM erased, awaiting" << _payloadSize() << "bytes";
+    _state = State::Receiving;
+    _received = 0;
+
+    if(_protocol == 4) {
+        // Uploads are always received with the regular speed.
+        _terminal->write(QByteArray::fromRawData("\xFF\x05\x01\x01", 4));
+        _expectedBaudRate = 57600;
+    }
+}
+
+void Simulator::_uploaded() {
+    auto elapsed = std::max<qint64>(_uploadClock.elapsed(), 1);
+    qDebug() << "received image of" << _received << "bytes in" << elapsed << "ms ("
+             << _received * 1000 / elapsed << "bytes/s," << _dropped << "bytes dropped so far)";
+    _state = State::Idle;
+
+    if(_protocol == 4) {
+        _engrave();
+    }
+}
+
+void Simulator::_start() {
+    if(_state == State::Paused) {
+        qDebug() << "continuing engrave process";
+        _state = State::Engraving;
+        _engraveClock.start();
+        _engraveTimer.start();
+        return;
+    }
+    _engrave();
+}
+
+void Simulator::_pause() {
+    if(_state != State::Engraving) {
+        return;
+    }
+    qDebug() << "pausing engrave process at pixel" << _engraved << "of" << _pixels.size();
+    _state = State::Paused;
+    _engraveTimer.stop();
+}
+
+void Simulator::_reset() {
+    qDebug() << "resetting";
+    _eraseTimer.stop();
+    _engraveTimer.stop();
+    _state = State::Idle;
+    _command.clear();
+    _pixels.clear();
+    _expectedBaudRate = 57600;
+}
+
+void Simulator::_engrave() {
+    _pixels.clear();
+    for(int y{0}; y < Ez::Specifications::ImageHeight; ++y) {
+        for(int x{0}; x < Ez::Specifications::ImageWidth; ++x) {
+            if(_burns(x, y)) {
+                _pixels.append(QPoint{x, y});
+            }
+        }
+    }
+
+    qDebug() << "engraving" << _pixels.size() << "pixels with burn time" << _burnTime;
+    _state = State::Engraving;
+    _engraved = 0;
+    _engraveBudget = 0;
+    _engraveClock.start();
+    _engraveTimer.start();
+}
+
+void Simulator::_progress() {
+    _engraveBudget += _engraveClock.restart() * _pixelRate / 1000.0;
+    auto count = std::min(static_cast<int>(_engraveBudget), _pixels.size() - _engraved);
+    _engraveBudget -= count;
+
+    QByteArray packets{};
+    packets.reserve(count * 5);
+    for(int i{0}; i < count; ++i) {
+        auto pixel = _pixels[_engraved++];
+        char packet[]{'\xFF',
+                      static_cast<char>(pixel.x() / 100), static_cast<char>(pixel.x() % 100),
+                      static_cast<char>(pixel.y() / 100), static_cast<char>(pixel.y() % 100)};
+        packets.append(packet, sizeof(packet));
+    }
+    _terminal->write(packets);
+
+    if(_engraved == _pixels.size()) {
+        qDebug() << "engraving finished";
+        _engraveTimer.stop();
+        _state = State::Idle;
+    }
+}
+
+void Simulator::_move(char const* direction) {
+    qDebug() << "moving" << direction;
+}
+
+int Simulator::_payloadSize() const {
+    return _protocol < 3 ? BitmapHeaderSize + PixelBytes : PixelBytes;
+}
+
+bool Simulator::_burns(int x, int y) const {
+    // Protocols v1 and v2 receive an inverted bitmap, the later ones the raw pixels.
+    auto offset = (_protocol < 3 ? BitmapHeaderSize : 0) + y * RowBytes + x / 8;
+    auto set = (static_cast<unsigned char>(_eeprom[offset]) >> (7 - x % 8)) & 1;
+    return _protocol < 3 ? set == 0 : set == 1;
+}
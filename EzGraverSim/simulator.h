@@ -0,0 +1,127 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QVector>
+#include <QPoint>
+#include <QTimer>
+#include <QElapsedTimer>
+
+class PseudoTerminal;
+
+/*!
+ * Emulates a NEJE engraver speaking one of the protocol versions 1 to 4 on a pseudo-terminal.
+ * The simulator covers erasing the EEPROM, uploading images, the baud rate negotiation of
+ * protocol v4 and the progress reports sent while engraving.
+ */
+class Simulator : public QObject {
+    Q_OBJECT
+
+public:
+    /*!
+     * Creates a new instance simulating the given \a protocol on the \a terminal.
+     *
+     * \param terminal The terminal to communicate with the client.
+     * \param protocol The protocol version to simulate.
+     * \param parent The parent of the simulator.
+     * \throws std::invalid_argument Thrown if the provided protocol is unknown.
+     */
+    explicit Simulator(PseudoTerminal* terminal, int protocol, QObject* parent=NULL);
+
+    /*!
+     * Sets the time it takes to erase the EEPROM. Any data received meanwhile is lost.
+     *
+     * \param msecs The erase time in milliseconds.
+     */
+    void setEraseTime(int msecs);
+
+    /*!
+     * Sets the number of engraved pixels per second.
+     *
+     * \param pixelsPerSecond The engraving speed.
+     */
+    void setPixelRate(int pixelsPerSecond);
+
+    /*!
+     * Enables or disables limiting the received data to what the configured baud rate
+     * would be able to carry.
+     *
+     * \param enabled \c true if the line speed should be emulated.
+     */
+    void setLineSpeedEmulated(bool enabled);
+
+    /*!
+     * Enables or disables the double speed of protocol v4. Without it, the request to switch
+     * to 115200 baud is ignored like by older firmwares.
+     *
+     * \param supported \c true if the double speed is supported.
+     */
+    void setDoubleSpeedSupported(bool supported);
+
+    /*!
+     * Gets the default time it takes to erase the EEPROM for the given \a protocol.
+     *
+     * \param protocol The protocol version.
+     * \return The erase time in milliseconds.
+     */
+    static int defaultEraseTime(int protocol);
+
+private:
+    enum class State {
+        Idle,
+        Erasing,
+        Receiving,
+        Engraving,
+        Paused
+    };
+
+    PseudoTerminal* _terminal;
+    int _protocol;
+    int _eraseTime;
+    int _pixelRate{1000};
+    bool _lineSpeedEmulated{false};
+    bool _doubleSpeedSupported{true};
+
+    State _state{State::Idle};
+    QByteArray _command{};
+    QByteArray _eeprom;
+    int _received{0};
+    int _dropped{0};
+    qint32 _expectedBaudRate{57600};
+    int _burnTime{60};
+    QElapsedTimer _uploadClock{};
+
+    QTimer _eraseTimer{};
+    QTimer _engraveTimer{};
+    QElapsedTimer _engraveClock{};
+    double _engraveBudget{0};
+    QVector<QPoint> _pixels{};
+    int _engraved{0};
+
+    QTimer _lineTimer{};
+    QElapsedTimer _lineClock{};
+    double _lineBudget{0};
+
+    void _readyRead();
+    void _pace();
+    void _consume(QByteArray const& data);
+    void _receive(QByteArray const& data, int& offset);
+    void _command1(unsigned char byte);
+    void _command3(QByteArray const& frame);
+
+    void _erase();
+    void _erased();
+    void _uploaded();
+    void _start();
+    void _pause();
+    void _reset();
+    void _engrave();
+    void _progress();
+    void _move(char const* direction);
+
+    int _payloadSize() const;
+    bool _burns(int x, int y) const;
+};
+
+#endif // SIMULATOR_H
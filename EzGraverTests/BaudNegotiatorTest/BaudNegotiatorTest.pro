@@ -0,0 +1,8 @@
+include(../tests.pri)
+include(../simulation.pri)
+
+QT += serialport
+
+TARGET = BaudNegotiatorTest
+
+SOURCES += baudnegotiatortest.cpp
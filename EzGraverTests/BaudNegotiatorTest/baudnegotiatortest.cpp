@@ -0,0 +1,102 @@
+#include <QtTest>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+
+#include <memory>
+
+#include "ezgraver.h"
+#include "factory.h"
+#include "simulatedengraver.h"
+
+/*!
+ * Negotiates the upload speed of protocol v4 with a simulated engraver switching its baud
+ * rate, with and without support for the double speed.
+ */
+class BaudNegotiatorTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void doubleSpeed();
+    void fallback();
+
+private:
+    QTemporaryDir _settings{};
+};
+
+namespace {
+
+/*! The time in ms to await a negotiation, covering the handshake timeout of every rate. */
+int const NegotiationTimeout{10000};
+
+int uploadReadyFrames(QSignalSpy const& spy) {
+    int count{0};
+    for(auto const& arguments : spy) {
+        if(arguments.at(0).value<Ez::Frame>().type == Ez::Frame::Type::UploadReady) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+}
+
+void BaudNegotiatorTest::initTestCase() {
+    qRegisterMetaType<Ez::Frame>();
+    SimulatedEngraver::isolateSettings(_settings);
+}
+
+void BaudNegotiatorTest::doubleSpeed() {
+    SimulatedEngraver simulator{QStringList{"--protocol", "4", "--erase-time", "50"}};
+    auto engraver = Ez::create(simulator.portName(), 4);
+    QSignalSpy frames{engraver.get(), &Ez::EzGraver::frameDecoded};
+
+    engraver->start(60);
+    QTRY_VERIFY_WITH_TIMEOUT(engraver->negotiationMetrics().baudRate > 0, NegotiationTimeout);
+
+    auto metrics = engraver->negotiationMetrics();
+    QCOMPARE(metrics.baudRate, static_cast<qint32>(115200));
+    QCOMPARE(metrics.attempts, 1);
+    QCOMPARE(metrics.fallbacks, 0);
+    QCOMPARE(metrics.reverts, 0);
+    QVERIFY(!metrics.recovered);
+    QCOMPARE(uploadReadyFrames(frames), 1);
+
+    // Protocol v4 keeps the burn time set on the device, only the speed switch is sent.
+    QTRY_VERIFY(simulator.log().contains("switching to double speed"));
+    QVERIFY(!simulator.log().contains("burn time set to"));
+}
+
+void BaudNegotiatorTest::fallback() {
+    SimulatedEngraver simulator{QStringList{"--protocol", "4", "--erase-time", "50", "--single-speed"}};
+    auto engraver = Ez::create(simulator.portName(), 4);
+    QSignalSpy frames{engraver.get(), &Ez::EzGraver::frameDecoded};
+
+    engraver->start(42);
+    QTRY_VERIFY_WITH_TIMEOUT(engraver->negotiationMetrics().baudRate > 0, NegotiationTimeout);
+
+    // The device never switched, thus the revert sent with double speed is lost and the regular speed is acknowledged.
+    auto metrics = engraver->negotiationMetrics();
+    QCOMPARE(metrics.baudRate, static_cast<qint32>(57600));
+    QCOMPARE(metrics.attempts, 2);
+    QCOMPARE(metrics.fallbacks, 1);
+    QCOMPARE(metrics.reverts, 1);
+    QVERIFY(metrics.recovered);
+    QCOMPARE(uploadReadyFrames(frames), 1);
+    QTRY_VERIFY(simulator.log().contains("ignoring double speed request"));
+
+    // Subsequent negotiations start with the acknowledged rate and do not wait for the timeout anymore.
+    engraver->reset();
+    engraver->start(43);
+    QTRY_VERIFY_WITH_TIMEOUT(uploadReadyFrames(frames) == 2, NegotiationTimeout);
+    metrics = engraver->negotiationMetrics();
+    QCOMPARE(metrics.baudRate, static_cast<qint32>(57600));
+    QCOMPARE(metrics.attempts, 1);
+    QCOMPARE(metrics.fallbacks, 1);
+    QCOMPARE(metrics.reverts, 0);
+    QVERIFY(!simulator.log().contains("burn time set to"));
+}
+
+QTEST_GUILESS_MAIN(BaudNegotiatorTest)
+
+#include "baudnegotiatortest.moc"
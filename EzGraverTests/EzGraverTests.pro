@@ -0,0 +1,10 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    FrameDecoderTest \
+    ProtocolSpecTest
+
+# The simulator runs on pseudo-terminals of Linux only.
+unix:!macx: SUBDIRS += \
+    BaudNegotiatorTest \
+    FarmTest
@@ -0,0 +1,8 @@
+include(../tests.pri)
+include(../simulation.pri)
+
+QT += serialport
+
+TARGET = FarmTest
+
+SOURCES += farmtest.cpp
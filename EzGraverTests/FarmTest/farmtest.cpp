@@ -0,0 +1,147 @@
+#include <QtTest>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QImage>
+#include <QSet>
+
+#include <memory>
+#include <vector>
+
+#include "farm.h"
+#include "factory.h"
+#include "specifications.h"
+#include "simulatedengraver.h"
+
+/*!
+ * Runs a farm of simulated engravers speaking different protocol versions and checks that
+ * the jobs are spread across them and shared payloads are packed once.
+ */
+class FarmTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void distributesJobs();
+    void sharesPinnedJob();
+
+private:
+    QTemporaryDir _settings{};
+    std::vector<std::unique_ptr<SimulatedEngraver>> _simulators{};
+    std::unique_ptr<Ez::Farm> _farm{};
+};
+
+namespace {
+
+/*! The time in ms to await a farm running out of work. */
+int const FarmTimeout{60000};
+
+/*! The number of pixels burnt by every job. */
+int const JobPixels{200};
+
+QVector<Ez::JobLayer> createJob() {
+    QImage image{Ez::Specifications::ImageWidth, Ez::Specifications::ImageHeight, QImage::Format_Mono};
+    image.setColorTable(QVector<QRgb>{qRgb(255, 255, 255), qRgb(0, 0, 0)});
+    image.fill(0);
+    for(int y{0}; y < 10; ++y) {
+        for(int x{0}; x < JobPixels / 10; ++x) {
+            image.setPixel(100 + x, 200 + y, 1);
+        }
+    }
+
+    Ez::JobLayer layer{};
+    layer.image = image;
+    layer.burnTime = 10;
+    return QVector<Ez::JobLayer>{layer};
+}
+
+}
+
+void FarmTest::initTestCase() {
+    SimulatedEngraver::isolateSettings(_settings);
+}
+
+void FarmTest::init() {
+    // Protocols v3 and v4 share the payload format but differ in how uploads are started.
+    QList<QStringList> arguments{
+        QStringList{"--protocol", "3", "--erase-time", "20", "--pixel-rate", "20000"},
+        QStringList{"--protocol", "3", "--erase-time", "20", "--pixel-rate", "20000"},
+        QStringList{"--protocol", "4", "--erase-time", "20", "--pixel-rate", "20000"}
+    };
+
+    _farm.reset(new Ez::Farm{});
+    for(auto const& simulatorArguments : arguments) {
+        std::unique_ptr<SimulatedEngraver> simulator{new SimulatedEngraver{simulatorArguments}};
+        auto protocol = simulatorArguments[1].toInt();
+        _farm->addEngraver(Ez::create(simulator->portName(), protocol), simulator->portName());
+        _simulators.push_back(std::move(simulator));
+    }
+}
+
+void FarmTest::cleanup() {
+    // The engravers are closed before their simulators are stopped.
+    _farm.reset();
+    _simulators.clear();
+}
+
+void FarmTest::distributesJobs() {
+    QSignalSpy started{_farm.get(), &Ez::Farm::jobStarted};
+    QSignalSpy finished{_farm.get(), &Ez::Farm::jobFinished};
+    QSignalSpy idle{_farm.get(), &Ez::Farm::idle};
+
+    int const jobs{6};
+    for(int i{0}; i < jobs; ++i) {
+        _farm->submit(createJob());
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(idle.count(), 1, FarmTimeout);
+
+    auto statistics = _farm->statistics();
+    QCOMPARE(statistics.engravers, 3);
+    QCOMPARE(statistics.finishedJobs, jobs);
+    QCOMPARE(statistics.failedJobs, 0);
+    QCOMPARE(statistics.busyEngravers, 0);
+    QCOMPARE(statistics.queuedJobs, 0);
+    QCOMPARE(statistics.engravedPixels, static_cast<qint64>(jobs * JobPixels));
+    QCOMPARE(finished.count(), jobs);
+
+    // Every job ran exactly once, every engraver took part.
+    QSet<int> startedJobs{};
+    QSet<int> busyEngravers{};
+    for(auto const& arguments : started) {
+        startedJobs.insert(arguments.at(0).toInt());
+        busyEngravers.insert(arguments.at(1).toInt());
+    }
+    QCOMPARE(startedJobs.size(), jobs);
+    QCOMPARE(busyEngravers.size(), 3);
+    for(auto& simulator : _simulators) {
+        QVERIFY(simulator->log().contains(QByteArray{"engraving "} + QByteArray::number(JobPixels) + " pixels"));
+    }
+}
+
+void FarmTest::sharesPinnedJob() {
+    QSignalSpy finished{_farm.get(), &Ez::Farm::jobFinished};
+    QSignalSpy idle{_farm.get(), &Ez::Farm::idle};
+
+    auto job = _farm->submit(createJob(), QList<int>{0, 1, 2});
+    QTRY_COMPARE_WITH_TIMEOUT(idle.count(), 1, FarmTimeout);
+
+    // All engravers run the job, its payload is packed once for the common format.
+    QCOMPARE(finished.count(), 3);
+    QSet<int> engravers{};
+    for(auto const& arguments : finished) {
+        QCOMPARE(arguments.at(0).toInt(), job);
+        QVERIFY(!arguments.at(2).toBool());
+        engravers.insert(arguments.at(1).toInt());
+    }
+    QCOMPARE(engravers.size(), 3);
+
+    auto statistics = _farm->statistics();
+    QCOMPARE(statistics.packedPayloads, 1);
+    QCOMPARE(statistics.stolenJobs, 0);
+    QCOMPARE(statistics.engravedPixels, static_cast<qint64>(3 * JobPixels));
+}
+
+QTEST_GUILESS_MAIN(FarmTest)
+
+#include "farmtest.moc"
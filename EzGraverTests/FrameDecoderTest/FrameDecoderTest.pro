@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = FrameDecoderTest
+
+SOURCES += framedecodertest.cpp
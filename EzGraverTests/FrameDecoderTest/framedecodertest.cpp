@@ -0,0 +1,197 @@
+#include <QtTest>
+#include <QByteArray>
+#include <QList>
+#include <QPoint>
+
+#include "framedecoder.h"
+
+/*!
+ * Checks that the frame decoder yields the same frames no matter how the received byte
+ * stream is split or coalesced, and that it recovers from bytes not belonging to any frame.
+ */
+class FrameDecoderTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void byteByByte_data();
+    void byteByByte();
+    void coalesced_data();
+    void coalesced();
+    void split_data();
+    void split();
+    void resynchronizes();
+    void uploadReadyOnlyIfAnnounced();
+    void uploadReadyBetweenProgress();
+    void reset();
+};
+
+namespace {
+
+QByteArray progressFrame(int x, int y) {
+    QByteArray frame{};
+    frame.append('\xFF');
+    frame.append(static_cast<char>(x / 100));
+    frame.append(static_cast<char>(x % 100));
+    frame.append(static_cast<char>(y / 100));
+    frame.append(static_cast<char>(y % 100));
+    return frame;
+}
+
+QByteArray uploadReadyFrame() {
+    return QByteArray{"\xFF\x05\x01\x01", 4};
+}
+
+QList<QPoint> positions() {
+    // Covers both digits of the coordinates including zero and the last pixel.
+    return QList<QPoint>{QPoint{0, 0}, QPoint{1, 0}, QPoint{99, 100}, QPoint{255, 256}, QPoint{501, 100}, QPoint{511, 511}};
+}
+
+QByteArray progressStream(QList<QPoint> const& points) {
+    QByteArray stream{};
+    for(auto const& point : points) {
+        stream.append(progressFrame(point.x(), point.y()));
+    }
+    return stream;
+}
+
+QList<Ez::Frame> decode(Ez::FrameDecoder& decoder, QList<QByteArray> const& chunks) {
+    QList<Ez::Frame> frames{};
+    for(auto const& chunk : chunks) {
+        decoder.feed(chunk, [&frames](Ez::Frame const& frame) { frames.append(frame); });
+    }
+    return frames;
+}
+
+void addProtocolRows() {
+    QTest::addColumn<int>("protocol");
+    for(int protocol{1}; protocol <= 4; ++protocol) {
+        QTest::newRow(qPrintable(QString{"v%1"}.arg(protocol))) << protocol;
+    }
+}
+
+void compareProgress(QList<Ez::Frame> const& frames, QList<QPoint> const& points) {
+    QCOMPARE(frames.size(), points.size());
+    for(int i{0}; i < frames.size(); ++i) {
+        QCOMPARE(frames[i].type, Ez::Frame::Type::Progress);
+        QCOMPARE(frames[i].position, points[i]);
+    }
+}
+
+}
+
+void FrameDecoderTest::byteByByte_data() {
+    addProtocolRows();
+}
+
+void FrameDecoderTest::byteByByte() {
+    QFETCH(int, protocol);
+    Ez::FrameDecoder decoder{Ez::frameTable(protocol)};
+
+    QList<Ez::Frame> frames{};
+    auto stream = progressStream(positions());
+    for(int i{0}; i < stream.size(); ++i) {
+        Ez::Frame frame{};
+        auto completed = decoder.push(static_cast<unsigned char>(stream[i]), frame);
+        // Only the last byte of a frame completes it.
+        QCOMPARE(completed, i % 5 == 4);
+        if(completed) {
+            frames.append(frame);
+        }
+    }
+    compareProgress(frames, positions());
+    QCOMPARE(decoder.decodedFrames(), static_cast<quint64>(positions().size()));
+}
+
+void FrameDecoderTest::coalesced_data() {
+    addProtocolRows();
+}
+
+void FrameDecoderTest::coalesced() {
+    QFETCH(int, protocol);
+    Ez::FrameDecoder decoder{Ez::frameTable(protocol)};
+
+    auto frames = decode(decoder, QList<QByteArray>{progressStream(positions())});
+    compareProgress(frames, positions());
+}
+
+void FrameDecoderTest::split_data() {
+    addProtocolRows();
+}
+
+void FrameDecoderTest::split() {
+    QFETCH(int, protocol);
+    auto stream = progressStream(positions());
+
+    // Every possible pair of split points, including chunks ending mid-frame and empty ones.
+    for(int first{0}; first <= stream.size(); ++first) {
+        for(int second{first}; second <= stream.size(); ++second) {
+            Ez::FrameDecoder decoder{Ez::frameTable(protocol)};
+            auto frames = decode(decoder, QList<QByteArray>{stream.left(first), stream.mid(first, second - first), stream.mid(second)});
+            compareProgress(frames, positions());
+        }
+    }
+}
+
+void FrameDecoderTest::resynchronizes() {
+    Ez::FrameDecoder decoder{Ez::frameTable(3)};
+
+    // A stray byte, a truncated frame and an out of range coordinate are skipped.
+    QByteArray stream{};
+    stream.append('\x42');
+    stream.append(progressFrame(10, 20));
+    stream.append(QByteArray{"\xFF\x01", 2});
+    stream.append(progressFrame(30, 40));
+    stream.append(QByteArray{"\xFF\x01\x02\x64\x00", 5});
+    stream.append(progressFrame(50, 60));
+
+    auto frames = decode(decoder, QList<QByteArray>{stream});
+    compareProgress(frames, QList<QPoint>{QPoint{10, 20}, QPoint{30, 40}, QPoint{50, 60}});
+}
+
+void FrameDecoderTest::uploadReadyOnlyIfAnnounced() {
+    // Unannounced, the bytes are the beginning of the progress report of the pixel 501/100.
+    Ez::FrameDecoder decoder{Ez::frameTable(4)};
+    auto stream = uploadReadyFrame() + QByteArray{1, '\x00'};
+    compareProgress(decode(decoder, QList<QByteArray>{stream}), QList<QPoint>{QPoint{501, 100}});
+
+    decoder.expect(Ez::Frame::Type::UploadReady);
+    QVERIFY(decoder.expecting(Ez::Frame::Type::UploadReady));
+    auto frames = decode(decoder, QList<QByteArray>{uploadReadyFrame()});
+    QCOMPARE(frames.size(), 1);
+    QCOMPARE(frames[0].type, Ez::Frame::Type::UploadReady);
+    QVERIFY(!decoder.expecting(Ez::Frame::Type::UploadReady));
+
+    // Other protocols never send the frame.
+    Ez::FrameDecoder v3{Ez::frameTable(3)};
+    v3.expect(Ez::Frame::Type::UploadReady);
+    compareProgress(decode(v3, QList<QByteArray>{stream}), QList<QPoint>{QPoint{501, 100}});
+}
+
+void FrameDecoderTest::uploadReadyBetweenProgress() {
+    auto stream = progressFrame(1, 2) + uploadReadyFrame() + progressFrame(3, 4);
+    for(int i{0}; i <= stream.size(); ++i) {
+        Ez::FrameDecoder decoder{Ez::frameTable(4)};
+        decoder.expect(Ez::Frame::Type::UploadReady);
+        auto frames = decode(decoder, QList<QByteArray>{stream.left(i), stream.mid(i)});
+        QCOMPARE(frames.size(), 3);
+        QCOMPARE(frames[0].position, QPoint(1, 2));
+        QCOMPARE(frames[1].type, Ez::Frame::Type::UploadReady);
+        QCOMPARE(frames[2].position, QPoint(3, 4));
+    }
+}
+
+void FrameDecoderTest::reset() {
+    Ez::FrameDecoder decoder{Ez::frameTable(4)};
+    decoder.expect(Ez::Frame::Type::UploadReady);
+    auto frame = progressFrame(7, 8);
+    QVERIFY(decode(decoder, QList<QByteArray>{frame.left(3)}).isEmpty());
+
+    // The partial frame and the announcement are dropped.
+    decoder.reset();
+    QVERIFY(!decoder.expecting(Ez::Frame::Type::UploadReady));
+    compareProgress(decode(decoder, QList<QByteArray>{frame}), QList<QPoint>{QPoint{7, 8}});
+}
+
+QTEST_GUILESS_MAIN(FrameDecoderTest)
+
+#include "framedecodertest.moc"
@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = ProtocolSpecTest
+
+SOURCES += protocolspectest.cpp
@@ -0,0 +1,148 @@
+#include <QtTest>
+#include <QByteArray>
+#include <QList>
+
+#include <stdexcept>
+
+#include "protocolspec.h"
+
+/*!
+ * Round-trips every entry of the command tables through \a Ez::encodeCommand and checks
+ * the bytes of selected commands against the ones the engravers are known to understand.
+ */
+class ProtocolSpecTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void knownCommands_data();
+    void knownCommands();
+    void burnTimeRange();
+    void unknownProtocol();
+};
+
+namespace {
+
+QByteArray encode(Ez::ProtocolSpec const& spec, Ez::Command command, unsigned char burnTime) {
+    unsigned char buffer[Ez::MaximumCommandSize];
+    auto size = Ez::encodeCommand(spec, command, burnTime, buffer);
+    return QByteArray{reinterpret_cast<char const*>(buffer), size};
+}
+
+bool matches(Ez::CommandSpec const& command, QByteArray const& data, unsigned char& burnTime) {
+    if(command.size == 0 || data.size() != command.size) {
+        return false;
+    }
+    for(int i{0}; i < command.size; ++i) {
+        auto byte = static_cast<unsigned char>(data[i]);
+        if(i == command.burnTimeOffset) {
+            burnTime = byte;
+        } else if(byte != command.bytes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QList<Ez::Command> decode(Ez::ProtocolSpec const& spec, QByteArray const& data, unsigned char& burnTime) {
+    // Every command the bytes could stand for, the tables must never be ambiguous.
+    QList<Ez::Command> commands{};
+    for(int i{0}; i < Ez::CommandCount; ++i) {
+        if(matches(spec.commands[i], data, burnTime)) {
+            commands.append(spec.commands[i].command);
+        }
+    }
+    return commands;
+}
+
+}
+
+void ProtocolSpecTest::roundTrip_data() {
+    QTest::addColumn<int>("protocol");
+    QTest::addColumn<int>("command");
+
+    for(int protocol{1}; protocol <= 4; ++protocol) {
+        for(int command{0}; command < Ez::CommandCount; ++command) {
+            QTest::newRow(qPrintable(QString{"v%1/%2"}.arg(protocol).arg(command))) << protocol << command;
+        }
+    }
+}
+
+void ProtocolSpecTest::roundTrip() {
+    QFETCH(int, protocol);
+    QFETCH(int, command);
+    auto const& spec = Ez::protocolSpec(protocol);
+    auto const& entry = spec.commands[command];
+    QCOMPARE(spec.protocol, protocol);
+    QCOMPARE(static_cast<int>(entry.command), command);
+
+    if(entry.size == 0) {
+        unsigned char buffer[Ez::MaximumCommandSize];
+        QVERIFY_EXCEPTION_THROWN(Ez::encodeCommand(spec, entry.command, 60, buffer), std::invalid_argument);
+        return;
+    }
+
+    for(unsigned char burnTime : {0x01, 0x3C, 0xF0}) {
+        auto data = encode(spec, entry.command, burnTime);
+        QCOMPARE(data.size(), static_cast<int>(entry.size));
+
+        unsigned char decodedBurnTime{0};
+        auto commands = decode(spec, data, decodedBurnTime);
+        QCOMPARE(commands.size(), 1);
+        QCOMPARE(static_cast<int>(commands.first()), command);
+        if(entry.burnTimeOffset >= 0) {
+            QCOMPARE(static_cast<int>(decodedBurnTime), static_cast<int>(burnTime));
+        }
+    }
+}
+
+void ProtocolSpecTest::knownCommands_data() {
+    QTest::addColumn<int>("protocol");
+    QTest::addColumn<int>("command");
+    QTest::addColumn<QByteArray>("expected");
+
+    auto start = static_cast<int>(Ez::Command::Start);
+    auto home = static_cast<int>(Ez::Command::Home);
+    auto up = static_cast<int>(Ez::Command::Up);
+    auto erase = static_cast<int>(Ez::Command::Erase);
+    QTest::newRow("v1/start") << 1 << start << QByteArray{"\x3C\xF1", 2};
+    QTest::newRow("v1/up") << 1 << up << QByteArray{"\xF5", 1};
+    QTest::newRow("v1/erase") << 1 << erase << QByteArray{8, '\xFE'};
+    QTest::newRow("v2/up") << 2 << up << QByteArray{"\xF5\x01", 2};
+    QTest::newRow("v3/start") << 3 << start << QByteArray{"\xFF\x05\x3C\x00\xFF\x01\x01\x00", 8};
+    QTest::newRow("v3/home") << 3 << home << QByteArray{"\xF3", 1};
+    QTest::newRow("v3/erase") << 3 << erase << QByteArray{"\xFF\x06\x01\x00", 4};
+    QTest::newRow("v4/start") << 4 << start << QByteArray{"\xFF\x05\x3C\x00", 4};
+    QTest::newRow("v4/home") << 4 << home << QByteArray{"\xFF\x0A\x00\x00\xFF\x0B\x00\x00", 8};
+    QTest::newRow("v4/erase") << 4 << erase << QByteArray{"\xFF\x06\x01\x01", 4};
+}
+
+void ProtocolSpecTest::knownCommands() {
+    QFETCH(int, protocol);
+    QFETCH(int, command);
+    QFETCH(QByteArray, expected);
+
+    QCOMPARE(encode(Ez::protocolSpec(protocol), static_cast<Ez::Command>(command), 0x3C).toHex(), expected.toHex());
+}
+
+void ProtocolSpecTest::burnTimeRange() {
+    unsigned char buffer[Ez::MaximumCommandSize];
+    for(int protocol{1}; protocol <= 4; ++protocol) {
+        auto const& spec = Ez::protocolSpec(protocol);
+        QVERIFY_EXCEPTION_THROWN(Ez::encodeCommand(spec, Ez::Command::Start, 0x00, buffer), std::out_of_range);
+        QVERIFY_EXCEPTION_THROWN(Ez::encodeCommand(spec, Ez::Command::Start, 0xF1, buffer), std::out_of_range);
+
+        // Commands without an argument ignore the burn time.
+        QCOMPARE(Ez::encodeCommand(spec, Ez::Command::Pause, 0x00, buffer), static_cast<int>(spec.commands[static_cast<int>(Ez::Command::Pause)].size));
+    }
+}
+
+void ProtocolSpecTest::unknownProtocol() {
+    QVERIFY_EXCEPTION_THROWN(Ez::protocolSpec(0), std::invalid_argument);
+    QVERIFY_EXCEPTION_THROWN(Ez::protocolSpec(5), std::invalid_argument);
+}
+
+QTEST_GUILESS_MAIN(ProtocolSpecTest)
+
+#include "protocolspectest.moc"
@@ -0,0 +1,60 @@
+#include "simulatedengraver.h"
+
+#include <QElapsedTimer>
+
+#include <stdexcept>
+
+namespace {
+
+/*! The time in ms the simulator is given to open its pseudo-terminal. */
+int const StartTimeout{10000};
+
+QString simulatorPath() {
+    return qEnvironmentVariableIsSet("EZ_SIMULATOR") ? QString::fromLocal8Bit(qgetenv("EZ_SIMULATOR")) : QString{EZ_SIMULATOR};
+}
+
+}
+
+SimulatedEngraver::SimulatedEngraver(QStringList const& arguments) {
+    if(!_directory.isValid()) {
+        throw std::runtime_error{"failed to create a directory for the simulator"};
+    }
+
+    _portName = _directory.path() + "/ezgraver";
+    _process.setProcessChannelMode(QProcess::MergedChannels);
+    _process.start(simulatorPath(), QStringList{arguments} << "--link" << _portName);
+    if(!_process.waitForStarted(StartTimeout)) {
+        throw std::runtime_error{QString{"failed to start %1: %2"}.arg(simulatorPath(), _process.errorString()).toStdString()};
+    }
+
+    // The port is announced once the link has been created.
+    QElapsedTimer clock{};
+    clock.start();
+    while(!_log.contains("simulating protocol")) {
+        if(clock.elapsed() > StartTimeout || !_process.waitForReadyRead(StartTimeout)) {
+            throw std::runtime_error{QString{"simulator did not start: %1"}.arg(QString::fromLocal8Bit(_log)).toStdString()};
+        }
+        _log.append(_process.readAll());
+    }
+}
+
+SimulatedEngraver::~SimulatedEngraver() {
+    _process.terminate();
+    if(!_process.waitForFinished(StartTimeout)) {
+        _process.kill();
+        _process.waitForFinished();
+    }
+}
+
+QString SimulatedEngraver::portName() const {
+    return _portName;
+}
+
+QByteArray SimulatedEngraver::log() {
+    _log.append(_process.readAll());
+    return _log;
+}
+
+void SimulatedEngraver::isolateSettings(QTemporaryDir const& directory) {
+    qputenv("XDG_CONFIG_HOME", directory.path().toLocal8Bit());
+}
@@ -0,0 +1,59 @@
+#ifndef EZGRAVER_SIMULATEDENGRAVER_H
+#define EZGRAVER_SIMULATEDENGRAVER_H
+
+#include <QProcess>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QTemporaryDir>
+
+/*!
+ * Runs an instance of EzGraverSim for the duration of a test. The simulator is found next
+ * to the build of the tests, or at the path given by the environment variable EZ_SIMULATOR.
+ */
+class SimulatedEngraver {
+public:
+    /*!
+     * Starts a simulator and waits until its port can be opened.
+     *
+     * \param arguments The options passed to the simulator, e.g. the protocol version.
+     * \throws std::runtime_error Thrown if the simulator could not be started.
+     */
+    explicit SimulatedEngraver(QStringList const& arguments);
+
+    /*!
+     * Stops the simulator.
+     */
+    ~SimulatedEngraver();
+
+    /*!
+     * Gets the port of the simulated engraver.
+     *
+     * \return The name of the port.
+     */
+    QString portName() const;
+
+    /*!
+     * Gets everything logged by the simulator so far.
+     *
+     * \return The log of the simulator.
+     */
+    QByteArray log();
+
+    /*!
+     * Points the settings shared by all front-ends to a temporary directory, thus tests
+     * neither depend on nor change the settings of the user. Has to be called before the
+     * settings are accessed for the first time.
+     *
+     * \param directory The directory to keep the settings in.
+     */
+    static void isolateSettings(QTemporaryDir const& directory);
+
+private:
+    QTemporaryDir _directory{};
+    QProcess _process{};
+    QString _portName{};
+    QByteArray _log{};
+};
+
+#endif // EZGRAVER_SIMULATEDENGRAVER_H
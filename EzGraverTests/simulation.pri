@@ -0,0 +1,8 @@
+# Tests driving engravers emulated by EzGraverSim, only available on Linux.
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += $$PWD/simulatedengraver.cpp
+HEADERS += $$PWD/simulatedengraver.h
+
+DEFINES += EZ_SIMULATOR=\\\"$$OUT_PWD/../../EzGraverSim/EzGraverSim\\\"
@@ -3,6 +3,7 @@ include(../common.pri)
 QT += core
 QT += gui
 QT += serialport
+QT += concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
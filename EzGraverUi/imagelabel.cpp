@@ -1,17 +1,32 @@
 #include "imagelabel.h"
 
 #include <QPainter>
+#include <QPaintEvent>
+#include <QStyle>
+#include <QtConcurrent/QtConcurrentRun>
 
 #include <algorithm>
 
 #include "ezgraver.h"
 
+namespace {
+
+QRgb const ProgressColor{qRgb(255, 0, 0)};
+
+}
+
 ImageLabel::ImageLabel(QWidget* parent) : ClickLabel{parent} {
+    _engravedPixels.reserve(4096);
+    _progressTimer.setSingleShot(true);
     resetProgressImage();
-    connect(&_refreshTimer, &QTimer::timeout, this, &ImageLabel::_updateDisplayedImage);
+    connect(&_progressTimer, &QTimer::timeout, this, &ImageLabel::_applyEngravedPixels);
+    connect(&_renderWatcher, &QFutureWatcher<QImage>::finished, this, &ImageLabel::_renderFinished);
 }
 
-ImageLabel::~ImageLabel() {}
+ImageLabel::~ImageLabel() {
+    ++_renderGeneration;
+    _renderWatcher.waitForFinished();
+}
 
 QImage ImageLabel::image() const {
     return _image;
@@ -19,6 +34,9 @@ QImage ImageLabel::image() const {
 
 void ImageLabel::setImage(QImage const& image) {
     _image = image;
+    _proxy = std::max(image.width(), image.height()) > ProxySize
+            ? image.scaled(ProxySize, ProxySize, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+            : image;
     _updateEngraveImage();
     emit imageLoadedChanged(true);
     emit imageChanged(image);
@@ -35,12 +53,10 @@ void ImageLabel::setEngraveImage(QImage const& engraveImage) {
 }
 
 void ImageLabel::setPixelEngraved(QPoint const& location) {
-    if(!_refreshTimer.isActive()) {
-        _refreshTimer.start(ImageRefreshIntervalDelay);
+    _engravedPixels.append(location);
+    if(!_progressTimer.isActive()) {
+        _progressTimer.start(ProgressFlushInterval);
     }
-
-    _progressImage.setPixel(location, qRgb(255, 0, 0));
-    emit progressImageChanged(_progressImage);
 }
 
 QImage ImageLabel::progressImage() const {
@@ -48,14 +64,33 @@ QImage ImageLabel::progressImage() const {
 }
 
 void ImageLabel::setProgressImage(QImage const& progressImage) {
-    _progressImage = progressImage;
+    _progressTimer.stop();
+    _engravedPixels.resize(0);
+
+    if(progressImage.format() == QImage::Format_MonoLSB) {
+        _progressImage = progressImage;
+    } else {
+        // Every visible pixel counts as engraved.
+        _progressImage = QImage{progressImage.size(), QImage::Format_MonoLSB};
+        _progressImage.setColorTable(QVector<QRgb>{qRgba(0, 0, 0, 0), ProgressColor});
+        _progressImage.fill(0);
+        for(int y{0}; y < progressImage.height(); ++y) {
+            for(int x{0}; x < progressImage.width(); ++x) {
+                if(qAlpha(progressImage.pixel(x, y)) > 0) {
+                    _progressImage.setPixel(x, y, 1);
+                }
+            }
+        }
+    }
+
     _updateDisplayedImage();
-    emit progressImageChanged(progressImage);
+    emit progressImageChanged(_progressImage);
 }
 
 void ImageLabel::resetProgressImage() {
-    QImage image{QSize{Ez::Specifications::ImageWidth, Ez::Specifications::ImageHeight}, QImage::Format_ARGB32};
-    image.fill(qRgba(0, 0, 0, 0));
+    QImage image{QSize{Ez::Specifications::ImageWidth, Ez::Specifications::ImageHeight}, QImage::Format_MonoLSB};
+    image.setColorTable(QVector<QRgb>{qRgba(0, 0, 0, 0), ProgressColor});
+    image.fill(0);
     setProgressImage(image);
 }
 
@@ -69,6 +104,16 @@ void ImageLabel::setConversionFlags(Qt::ImageConversionFlags const& flags) {
     emit conversionFlagsChanged(flags);
 }
 
+Ez::DitherMethod ImageLabel::ditherMethod() const {
+    return _ditherMethod;
+}
+
+void ImageLabel::setDitherMethod(Ez::DitherMethod const& method) {
+    _ditherMethod = method;
+    _updateEngraveImage();
+    emit ditherMethodChanged(method);
+}
+
 bool ImageLabel::grayscale() const {
     return _grayscale;
 }
@@ -164,71 +209,145 @@ void ImageLabel::_updateEngraveImage() {
         return;
     }
 
-    // Draw white background, otherwise transparency is converted to black.
-    QImage image{QSize{Ez::Specifications::ImageWidth, Ez::Specifications::ImageHeight}, QImage::Format_ARGB32};
-    image.fill(QColor{Qt::white});
-    QPainter painter{&image};
+    // A running render is stale now, it stops before its next stage.
+    ++_renderGeneration;
+
+    _configure(_previewPipeline, _renderSettings(_proxy));
+    setEngraveImage(_previewPipeline.result());
 
-    QImage flipped{_image.mirrored(_flipHorizontally, _flipVertically)};
+    // The preview of small sources is exact already.
+    if(_proxy.cacheKey() == _image.cacheKey()) {
+        _renderPending = false;
+    } else if(_rendering) {
+        _renderPending = true;
+    } else {
+        _startRender();
+    }
+}
 
-    if(_transformed) {
-        QTransform rotation{};
-        rotation.rotate(_imageRotation);
-        auto rotated = flipped.transformed(rotation);
+QByteArray ImageLabel::conversionSettings() const {
+    Ez::ImagePipeline pipeline{};
+    _configure(pipeline, _renderSettings(_image));
+    return pipeline.settings();
+}
 
-        auto scaled = rotated.scaled(rotated.width() * _imageScale, rotated.height() * _imageScale);
-        QPoint position{(image.width() - scaled.width()) / 2, (image.height() - scaled.height()) / 2};
+ImageLabel::RenderSettings ImageLabel::_renderSettings(QImage const& source) const {
+    // The free transformation scales relative to the source, thus a proxy has to be scaled up accordingly.
+    auto scale = source.width() > 0 ? _imageScale * _image.width() / source.width() : _imageScale;
+    return RenderSettings{source, _flipHorizontally, _flipVertically, _keepAspectRatio, _transformed,
+                          scale, _imageRotation, _flags, _ditherMethod, _grayscale, _layerCount, _layer};
+}
 
-        painter.drawImage(position, scaled);
-    } else if(_keepAspectRatio) {
-        // As at this time, the target image is quadratic, scaling according the larger dimension is sufficient.
-        auto scaled = (flipped.width() > flipped.height() ? flipped.scaledToWidth(image.width()) : flipped.scaledToHeight(image.height()));
-        auto position = (flipped.width() > flipped.height() ? QPoint{0, (image.height() - scaled.height()) / 2} : QPoint{(image.width() - scaled.width()) / 2, 0});
-        painter.drawImage(position, scaled);
-    } else {
-        painter.drawImage(QPoint{}, flipped.scaled(image.size()));
+void ImageLabel::_configure(Ez::ImagePipeline& pipeline, RenderSettings const& settings) {
+    // Only the stages affected by changed settings are run again.
+    pipeline.setSource(settings.source);
+    pipeline.setFlip(settings.flipHorizontally, settings.flipVertically);
+    pipeline.setKeepAspectRatio(settings.keepAspectRatio);
+    pipeline.setTransformation(settings.transformed, settings.imageScale, settings.imageRotation);
+    pipeline.setConversionFlags(settings.flags);
+    pipeline.setDitherMethod(settings.ditherMethod);
+    pipeline.setLayers(settings.grayscale, settings.layerCount, settings.layer);
+}
+
+void ImageLabel::_startRender() {
+    _rendering = true;
+    _renderPending = false;
+    _runningGeneration = _renderGeneration;
+
+    // The full resolution pipeline is exclusively used by the one render running at a time.
+    auto settings = _renderSettings(_image);
+    auto generation = _runningGeneration;
+    _renderWatcher.setFuture(QtConcurrent::run([this, settings, generation]() -> QImage {
+        _configure(_pipeline, settings);
+        return _pipeline.result([this, generation] { return _renderGeneration != generation; });
+    }));
+}
+
+void ImageLabel::_renderFinished() {
+    if(!_rendering) {
+        return;
     }
+    _rendering = false;
 
-    auto targetImage = _grayscale ? _createGrayscaleImage(image) : image.convertToFormat(QImage::Format_Mono, _flags);
-    setEngraveImage(targetImage);
+    auto image = _renderWatcher.result();
+    if(_renderPending) {
+        _startRender();
+    } else if(_runningGeneration == _renderGeneration && !image.isNull()) {
+        setEngraveImage(image);
+    }
+}
+
+void ImageLabel::finishRendering() {
+    while(_rendering) {
+        _renderWatcher.waitForFinished();
+        _renderFinished();
+    }
 }
 
 void ImageLabel::_updateDisplayedImage() {
-    QImage image{QSize{Ez::Specifications::ImageWidth, Ez::Specifications::ImageHeight}, QImage::Format_ARGB32};
-    QPainter painter{&image};
+    if(_engraveImage.isNull()) {
+        _displayImage = QImage{};
+        _displayPixmap = QPixmap{};
+        update();
+        return;
+    }
+
+    _displayImage = QImage{QSize{Ez::Specifications::ImageWidth, Ez::Specifications::ImageHeight}, QImage::Format_ARGB32};
+    QPainter painter{&_displayImage};
     painter.drawImage(QPoint{}, _engraveImage);
     painter.drawImage(QPoint{}, _progressImage);
-    setPixmap(QPixmap::fromImage(image));
+    painter.end();
+
+    _displayPixmap = QPixmap::fromImage(_displayImage);
+    update();
 }
 
-QImage ImageLabel::_createGrayscaleImage(QImage const& original) const {
-    auto colorTable = _createColorTable();
-    QImage grayed = original.convertToFormat(QImage::Format_Indexed8, colorTable, _flags);
-    if(_layer == 0) {
-        return grayed;
+void ImageLabel::_applyEngravedPixels() {
+    QRect dirty{};
+    auto bounds = _progressImage.rect();
+    auto display = !_displayImage.isNull();
+
+    for(auto const& location : _engravedPixels) {
+        if(!bounds.contains(location)) {
+            continue;
+        }
+
+        _progressImage.scanLine(location.y())[location.x() >> 3] |= 1 << (location.x() & 7);
+        if(display) {
+            reinterpret_cast<QRgb*>(_displayImage.scanLine(location.y()))[location.x()] = ProgressColor;
+        }
+        dirty |= QRect{location, QSize{1, 1}};
     }
+    _engravedPixels.resize(0);
 
-    auto visibleLayer = _layer-1;
-    int i{0};
-    std::transform(colorTable.begin(), colorTable.end(), colorTable.begin(), [&i,visibleLayer](QRgb) {
-        return i++ == visibleLayer ? qRgb(0, 0, 0) : qRgb(255, 255, 255);
-    });
-    grayed.setColorTable(colorTable);
+    if(dirty.isNull()) {
+        return;
+    }
 
-    return grayed.convertToFormat(QImage::Format_Mono, _flags);
+    if(display) {
+        // Only the region touched by this batch is transferred and repainted.
+        QPainter painter{&_displayPixmap};
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(dirty.topLeft(), _displayImage, dirty);
+        painter.end();
+        update(dirty.translated(_displayRect().topLeft()));
+    }
+    emit progressImageChanged(_progressImage);
 }
 
-QVector<QRgb> ImageLabel::_createColorTable() const {
-    QVector<QRgb> colorTable(_layerCount - 1);
+QRect ImageLabel::_displayRect() const {
+    return QStyle::alignedRect(layoutDirection(), alignment(), _displayPixmap.size(), contentsRect());
+}
 
-    int i{0};
-    std::generate(colorTable.begin(), colorTable.end(), [this, &i] {
-      int gray = (256 / (_layerCount-1)) * (i++);
-      return qRgb(gray, gray, gray);
-    });
-    colorTable.push_back(qRgb(255, 255, 255));
+void ImageLabel::paintEvent(QPaintEvent* event) {
+    if(_displayPixmap.isNull()) {
+        ClickLabel::paintEvent(event);
+        return;
+    }
 
-    return colorTable;
+    QFrame::paintEvent(event);
+    QPainter painter{this};
+    painter.drawPixmap(_displayRect().topLeft(), _displayPixmap);
 }
 
 bool ImageLabel::imageLoaded() const {
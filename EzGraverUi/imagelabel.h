@@ -5,10 +5,14 @@
 #include <QPixmap>
 #include <QTimer>
 #include <QVector>
+#include <QFutureWatcher>
+
+#include <atomic>
 
 #include "clicklabel.h"
 
 #include "specifications.h"
+#include "imagepipeline.h"
 
 class ImageLabel : public ClickLabel {
     Q_OBJECT
@@ -17,6 +21,7 @@ class ImageLabel : public ClickLabel {
     Q_PROPERTY(QImage progressImage READ progressImage WRITE setProgressImage RESET resetProgressImage NOTIFY progressImageChanged)
 
     Q_PROPERTY(Qt::ImageConversionFlags conversionFlags READ conversionFlags WRITE setConversionFlags NOTIFY conversionFlagsChanged)
+    Q_PROPERTY(Ez::DitherMethod ditherMethod READ ditherMethod WRITE setDitherMethod NOTIFY ditherMethodChanged)
 
     Q_PROPERTY(bool grayscale READ grayscale WRITE setGrayscale NOTIFY grayscaleChanged)
     Q_PROPERTY(int layer READ layer WRITE setLayer NOTIFY layerChanged)
@@ -62,12 +67,26 @@ public:
     void setImage(QImage const& image);
 
     /*!
-     * Gets the currently active engraving image.
+     * Gets the currently active engraving image. While the exact image of a large
+     * source is rendered in the background, this is a preview rendered from a proxy.
+     * Use \a finishRendering to obtain the exact image.
      *
      * \return The current engraving image.
      */
     QImage engraveImage() const;
 
+    /*!
+     * Blocks until the exact engraving image has been rendered and applied.
+     */
+    void finishRendering();
+
+    /*!
+     * Gets a fingerprint of all settings affecting the engraving image, not including the image itself.
+     *
+     * \return The serialized conversion settings.
+     */
+    QByteArray conversionSettings() const;
+
     /*!
      * Changes the currently active engraving image.
      *
@@ -90,7 +109,8 @@ public:
     void setProgressImage(QImage const& progressImage);
 
     /*!
-     * Marks the pixel at the specified point as engraved.
+     * Marks the pixel at the specified point as engraved. Pixels are buffered and
+     * applied in batches, only the affected region is repainted.
      *
      * \param location The location of the pixel to mark as engraved.
      */
@@ -116,6 +136,21 @@ public:
      */
     void setConversionFlags(Qt::ImageConversionFlags const& flags);
 
+    /*!
+     * Gets the currently selected dither method.
+     *
+     * \return The currently selected dither method.
+     */
+    Ez::DitherMethod ditherMethod() const;
+
+    /*!
+     * Changes the dither method to the given one and updates the currently displayed image.
+     * The conversion flags are only applied by \a Ez::DitherMethod::ConversionFlags.
+     *
+     * \param method The dither method to use.
+     */
+    void setDitherMethod(Ez::DitherMethod const& method);
+
     /*!
      * Gets if grayscale is enabled.
      *
@@ -285,6 +320,13 @@ signals:
      */
     void conversionFlagsChanged(Qt::ImageConversionFlags const& flags);
 
+    /*!
+     * Fired as soon as the dither method has been changed.
+     *
+     * \param method The newly applied dither method.
+     */
+    void ditherMethodChanged(Ez::DitherMethod const& method);
+
     /*!
      * Fired as soon as grayscale has been enabled or disabled.
      *
@@ -354,18 +396,46 @@ signals:
      * \param imageLoaded \c true if an image is loaded.
      */
     void imageLoadedChanged(bool imageLoaded);
+
+protected:
+    /*!
+     * Paints the composed image, or the text if no image has been loaded yet.
+     *
+     * \param event The paint event.
+     */
+    void paintEvent(QPaintEvent* event) override;
+
 private:
-    // The delay between refreshing the image.
+    // The delay between applying the buffered progress.
     // Used to reduce the stress on the UI when updating the progress.
     // All other actions lead to an immediate update.
-    static int const ImageRefreshIntervalDelay{500};
-    QTimer _refreshTimer{};
+    static int const ProgressFlushInterval{40};
+    QTimer _progressTimer{};
+    QVector<QPoint> _engravedPixels{};
 
     QImage _image{};
+    Ez::ImagePipeline _pipeline{};
+
+    // Sources larger than this are previewed from a downsampled proxy while the
+    // exact image is rendered in the background.
+    static int const ProxySize{1024};
+    QImage _proxy{};
+    Ez::ImagePipeline _previewPipeline{};
+    QFutureWatcher<QImage> _renderWatcher{};
+    std::atomic<int> _renderGeneration{0};
+    int _runningGeneration{0};
+    bool _rendering{false};
+    bool _renderPending{false};
     QImage _engraveImage{};
+    // A 1-bit overlay marking the engraved pixels.
     QImage _progressImage{};
 
+    // The engrave image composed with the progress as displayed.
+    QImage _displayImage{};
+    QPixmap _displayPixmap{};
+
     Qt::ImageConversionFlags _flags{Qt::DiffuseDither};
+    Ez::DitherMethod _ditherMethod{Ez::DitherMethod::ConversionFlags};
     bool _grayscale{false};
     int _layer{0};
     int _layerCount{3};
@@ -378,10 +448,29 @@ private:
     float _imageScale{1.0};
     int _imageRotation{0};
 
+    struct RenderSettings {
+        QImage source;
+        bool flipHorizontally;
+        bool flipVertically;
+        bool keepAspectRatio;
+        bool transformed;
+        float imageScale;
+        int imageRotation;
+        Qt::ImageConversionFlags flags;
+        Ez::DitherMethod ditherMethod;
+        bool grayscale;
+        int layerCount;
+        int layer;
+    };
+
     void _updateEngraveImage();
+    RenderSettings _renderSettings(QImage const& source) const;
+    static void _configure(Ez::ImagePipeline& pipeline, RenderSettings const& settings);
+    void _startRender();
+    void _renderFinished();
     void _updateDisplayedImage();
-    QImage _createGrayscaleImage(QImage const& original) const;
-    QVector<QRgb> _createColorTable() const;
+    void _applyEngravedPixels();
+    QRect _displayRect() const;
 };
 
 #endif // IMAGELABEL_H
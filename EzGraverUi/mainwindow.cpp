@@ -11,23 +11,33 @@
 #include <QImageReader>
 #include <QFileInfo>
 #include <QShortcut>
+#include <QFile>
 
 #include <stdexcept>
 #include <algorithm>
 #include <iterator>
 
 #include "factory.h"
+#include "serialworker.h"
+#include "wiretrace.h"
 #include "specifications.h"
+#include "imagepacker.h"
+#include "dithering.h"
 
 static QString const ProtocolSetting{"protocol"};
 static QString const DirectorySetting{"directory"};
+static int const DitherMethodRole{Qt::UserRole + 1};
 
 MainWindow::MainWindow(QWidget* parent) : QMainWindow{parent}, _ui{new Ui::MainWindow} {
     _ui->setupUi(this);
     setAcceptDrops(true);
 
-    connect(&_portTimer, &QTimer::timeout, this, &MainWindow::updatePorts);
-    _portTimer.start(PortUpdateDelay);
+    // The watcher reports all present ports first, thus the list starts with the empty entry only.
+    _ui->ports->addItem("");
+    connect(&_portWatcher, &Ez::PortWatcher::portAdded, this, &MainWindow::portAdded);
+    connect(&_portWatcher, &Ez::PortWatcher::portRemoved, this, &MainWindow::portRemoved);
+    _portWatcher.start();
+    connect(&_eraseProgressTimer, &QTimer::timeout, this, &MainWindow::_eraseProgressed);
 
     _initBindings();
     _initConversionFlags();
@@ -50,6 +60,9 @@ void MainWindow::_initBindings() {
 
     auto openImageShortcut = new QShortcut{QKeySequence{Qt::CTRL | Qt::Key_O}, this};
     connect(openImageShortcut, &QShortcut::activated, this, &MainWindow::on_image_clicked);
+
+    auto dumpTraceShortcut = new QShortcut{QKeySequence{Qt::CTRL | Qt::SHIFT | Qt::Key_T}, this};
+    connect(dumpTraceShortcut, &QShortcut::activated, this, &MainWindow::_dumpTrace);
 }
 
 void MainWindow::_initConnectionBindings() {
@@ -86,6 +99,7 @@ void MainWindow::_initSetupBindings() {
     connect(_ui->burnTime, &QSlider::valueChanged, [this](int const& v) { _ui->burnTimeLabel->setText(QString::number(v)); });
     connect(_ui->conversionFlags, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged), [this](int const& index) {
         _ui->image->setConversionFlags(static_cast<Qt::ImageConversionFlags>(_ui->conversionFlags->itemData(index).toInt()));
+        _ui->image->setDitherMethod(_ui->conversionFlags->itemData(index, DitherMethodRole).value<Ez::DitherMethod>());
     });
 
     connect(_ui->keepAspectRatio, &QCheckBox::toggled, _ui->image, &ImageLabel::setKeepAspectRatio);
@@ -119,21 +133,33 @@ void MainWindow::_initLayerBindings() {
 }
 
 void MainWindow::_initConversionFlags() {
-    _ui->conversionFlags->addItem("DiffuseDither", Qt::DiffuseDither);
-    _ui->conversionFlags->addItem("OrderedDither", Qt::OrderedDither);
-    _ui->conversionFlags->addItem("ThresholdDither", Qt::ThresholdDither);
+    auto addItem = [this](QString const& text, Qt::ImageConversionFlags flags, Ez::DitherMethod method) {
+        _ui->conversionFlags->addItem(text, static_cast<int>(flags));
+        _ui->conversionFlags->setItemData(_ui->conversionFlags->count() - 1, QVariant::fromValue(method), DitherMethodRole);
+    };
+    addItem("DiffuseDither", Qt::DiffuseDither, Ez::DitherMethod::ConversionFlags);
+    addItem("OrderedDither", Qt::OrderedDither, Ez::DitherMethod::ConversionFlags);
+    addItem("ThresholdDither", Qt::ThresholdDither, Ez::DitherMethod::ConversionFlags);
+    // The methods of the dithering engine ignore the conversion flags.
+    for(auto method : Ez::ditherMethods()) {
+        if(method != Ez::DitherMethod::ConversionFlags) {
+            addItem(Ez::ditherMethodName(method), Qt::DiffuseDither, method);
+        }
+    }
     _ui->conversionFlags->setCurrentIndex(0);
 }
 
 void MainWindow::_initProtocols() {
+    _ui->protocolVersion->addItem("auto", Ez::AutoDetect);
     auto protocols = Ez::protocols();
     for(auto protocol : protocols) {
         _ui->protocolVersion->addItem(QString{"v%1"}.arg(protocol), protocol);
     }
 
-    auto selectedProtocol = _settings.value(ProtocolSetting, 1).toInt();
-    if(protocols.contains(selectedProtocol)) {
-        _ui->protocolVersion->setCurrentText(QString{"v%1"}.arg(selectedProtocol));
+    auto selectedProtocol = _settings.value(ProtocolSetting, Ez::AutoDetect).toInt();
+    auto index = _ui->protocolVersion->findData(selectedProtocol);
+    if(index >= 0) {
+        _ui->protocolVersion->setCurrentIndex(index);
     }
 }
 
@@ -141,28 +167,46 @@ void MainWindow::_printVerbose(QString const& verbose) {
     _ui->verbose->appendPlainText(verbose);
 }
 
-void MainWindow::updatePorts() {
-    QStringList ports{Ez::availablePorts()};
-    ports.insert(0, "");
+void MainWindow::portAdded(Ez::PortInfo const& port) {
+    if(_ui->ports->findText(port.portName) >= 0) {
+        return;
+    }
+
+    _ui->ports->addItem(port.portName);
+    auto details = QStringList{port.description, port.manufacturer, port.serialNumber};
+    details.removeAll("");
+    _ui->ports->setItemData(_ui->ports->count() - 1, details.join(", "), Qt::ToolTipRole);
+}
 
-    QString original{_ui->ports->currentText()};
-    _ui->ports->clear();
-    _ui->ports->addItems(ports);
+void MainWindow::portRemoved(Ez::PortInfo const& port) {
+    auto index = _ui->ports->findText(port.portName);
+    if(index < 0) {
+        return;
+    }
 
-    if(ports.contains(original)) {
-        _ui->ports->setCurrentText(original);
+    if(_connected && index == _ui->ports->currentIndex()) {
+        _printVerbose(QString{"port %1 has been removed"}.arg(port.portName));
     }
+    _ui->ports->removeItem(index);
 }
 
 void MainWindow::_loadImage(QString const& fileName) {
     _printVerbose(QString{"loading image: %1"}.arg(fileName));
 
+    QFile file{fileName};
     QImage image{};
-    if(!image.load(fileName)) {
+    if(!file.open(QIODevice::ReadOnly)) {
+        _printVerbose("failed to load image");
+        return;
+    }
+    auto source = file.readAll();
+    if(!image.loadFromData(source)) {
         _printVerbose("failed to load image");
         return;
     }
 
+    // Converted payloads are cached by the content of the source file.
+    _sourceDigest = Ez::PayloadCache::sourceDigest(source);
     _ui->image->setImage(image);
 }
 
@@ -184,43 +228,67 @@ void MainWindow::updateProgress(qint64 bytes) {
     auto progress = _ui->progress->value() + bytes;
     _ui->progress->setValue(progress);
     if(progress >= _ui->progress->maximum()) {
-        _printVerbose("upload completed");
+        _printVerbose(QString{"upload completed (%1 bytes/s)"}.arg(_ezGraver->serialWorker()->throughput(), 0, 'f', 0));
+        auto negotiation = _ezGraver->negotiationMetrics();
+        if(negotiation.baudRate > 0) {
+            _printVerbose(QString{"upload mode entered with %1 baud after %2 attempt(s), handshake took %3 ms"}
+                          .arg(negotiation.baudRate).arg(negotiation.attempts).arg(negotiation.handshakeTime));
+            if(negotiation.reverts > 0) {
+                _printVerbose(QString{"device reverted to the regular speed %1 time(s)"}.arg(negotiation.reverts));
+            }
+        }
         _bytesWrittenProcessor = [](qint64){};
     }
 }
 
-void MainWindow::updateEngraveProgress() {
+void MainWindow::updateEngraveProgress(Ez::Frame const& frame) {
     // Based on suggestion: https://github.com/camrein/EzGraver/issues/18#issuecomment-293070214
-    auto data = _ezGraver->serialPort()->read(16);
-    qDebug() << "received" << data.size() << "bytes:" << data.toHex();
-
-    if((data.size() == 5) && (data[0] == (char)0xFF)) {
-        int x{data[1]*100 + data[2]};
-        int y{data[3]*100 + data[4]};
-        _ui->image->setPixelEngraved(QPoint{x, y});
+    switch(frame.type) {
+    case Ez::Frame::Type::Progress:
+        _ui->image->setPixelEngraved(frame.position);
+        _engraveProgressed(frame.position);
+        break;
+    case Ez::Frame::Type::UploadReady:
+        if(_eraseOperation->running()) {
+            _eraseOperation->processFrame(frame);
+        } else {
+            _ezGraver->setBaudRate(QSerialPort::Baud57600);
+            _uploadImage(_engravePayload());
+        }
+        break;
     }
-
-    if((data.size() == 4) && (data[0] == (char)0xFF) && (data[1] == (char)0x05) && (data[2] == (char)0x01) && (data[3] == (char)0x01)) {
-        QImage image{_ui->image->engraveImage()};
-        _uploadImage(image);
-        _ezGraver->serialPort()->setBaudRate(QSerialPort::Baud57600, QSerialPort::AllDirections);
-    }
-
-    _ezGraver->dataRecieved(data);
 }
 
 void MainWindow::on_connect_clicked() {
     try {
         auto protocol = _ui->protocolVersion->currentData().toInt();
-        _printVerbose(QString{"connecting to port %1 with protocol version %2"}.arg(_ui->ports->currentText()).arg(protocol));
-        _ezGraver = Ez::create(_ui->ports->currentText(), protocol);
-        _printVerbose("connection established successfully");
+        auto portName = _ui->ports->currentText();
+        _printVerbose(QString{"connecting to port %1 with protocol version %2"}.arg(portName, _ui->protocolVersion->currentText()));
+        if(protocol == Ez::AutoDetect) {
+            // Only protocol v4 can be detected, the others are guessed from earlier answers.
+            auto detected = Ez::detectProtocol(portName) != Ez::AutoDetect;
+            _ezGraver = Ez::create(portName, protocol);
+            _printVerbose(QString{"connection established successfully using %1 protocol version %2"}
+                    .arg(detected ? "detected" : "guessed").arg(_ezGraver->protocol()));
+        } else {
+            Ez::forgetProtocol(Ez::deviceId(portName));
+            _ezGraver = Ez::create(portName, protocol);
+            _printVerbose(QString{"connection established successfully using protocol version %1"}.arg(_ezGraver->protocol()));
+        }
         _setConnected(true);
 
         _settings.setValue(ProtocolSetting, protocol);
 
-        connect(_ezGraver->serialPort().get(), &QSerialPort::bytesWritten, this, &MainWindow::bytesWritten);
-        connect(_ezGraver->serialPort().get(), &QSerialPort::readyRead, this, &MainWindow::updateEngraveProgress);
+        connect(_ezGraver->serialWorker(), &Ez::SerialWorker::drained, this, &MainWindow::bytesWritten);
+        connect(_ezGraver.get(), &Ez::EzGraver::frameDecoded, this, &MainWindow::updateEngraveProgress);
+
+        _timeModel.reset(new Ez::EngraveTimeModel{_ezGraver->deviceId()});
+        _eraseOperation.reset(new Ez::EraseOperation{_ezGraver});
+        connect(_eraseOperation.get(), &Ez::EraseOperation::erased, this, &MainWindow::_erased);
+        connect(_eraseOperation.get(), &Ez::EraseOperation::failed, this, [this](QString const& reason) {
+            _eraseProgressTimer.stop();
+            _printVerbose(QString{"erasing failed: %1"}.arg(reason));
+        });
     } catch(std::exception const& e) {
         _printVerbose(QString{"Error: %1"}.arg(e.what()));
     }
@@ -253,36 +321,77 @@ void MainWindow::on_down_clicked() {
 }
 
 void MainWindow::on_upload_clicked() {
+    auto payload = _engravePayload();
+    if(payload.isNull()) {
+        _printVerbose("failed to convert the image");
+        return;
+    }
+    if(_ezGraver->holdsPayload(payload.data)) {
+        _printVerbose("image already uploaded, skipping erase and upload");
+        _ui->progress->setMaximum(1);
+        _ui->progress->setValue(1);
+        _ui->image->resetProgressImage();
+        return;
+    }
+
     _printVerbose("erasing EEPROM");
-    auto waitTimeMs = _ezGraver->erase();
+    _erasePayload = payload;
+    _eraseOperation->start();
 
-    QImage image{_ui->image->engraveImage()};
-    QTimer* eraseProgressTimer{new QTimer{this}};
+    // The bar merely indicates the expected time, the upload starts as soon as the engraver is ready.
     _ui->progress->setValue(0);
-    _ui->progress->setMaximum(waitTimeMs);
-
-    auto eraseProgress = std::bind(&MainWindow::_eraseProgressed, this, eraseProgressTimer, image, waitTimeMs);
-    connect(eraseProgressTimer, &QTimer::timeout, eraseProgress);
-    eraseProgressTimer->start(EraseProgressDelay < waitTimeMs ? EraseProgressDelay : waitTimeMs);
+    _ui->progress->setMaximum(std::max(_eraseOperation->expectedTime(), 1));
+    _eraseProgressTimer.start(std::min(EraseProgressDelay, _ui->progress->maximum()));
 
     _ui->image->resetProgressImage();
 }
 
-void MainWindow::_eraseProgressed(QTimer* eraseProgressTimer, QImage const& image, int const& waitTimeMs) {
-    auto value = _ui->progress->value() + EraseProgressDelay;
-    _ui->progress->setValue(value);
-    if(value < waitTimeMs) {
-        return;
+void MainWindow::_eraseProgressed() {
+    _ui->progress->setValue(std::min(_ui->progress->value() + _eraseProgressTimer.interval(), _ui->progress->maximum()));
+}
+
+void MainWindow::_erased(qint64 elapsed) {
+    _eraseProgressTimer.stop();
+    _printVerbose(QString{"EEPROM erased after %1 ms"}.arg(elapsed));
+
+    auto payload = _erasePayload;
+    _erasePayload = Ez::CachedPayload{};
+    _uploadImage(payload);
+}
+
+Ez::CachedPayload MainWindow::_engravePayload() {
+    // Without an image there is nothing to convert, nor to look up.
+    if(!_ui->image->imageLoaded()) {
+        return Ez::CachedPayload{};
+    }
+
+    auto format = _ezGraver->payloadFormat();
+    auto key = Ez::PayloadCache::key(_sourceDigest, _ui->image->conversionSettings(), format);
+    auto payload = _payloadCache.find(key);
+    if(!payload.isNull()) {
+        _printVerbose("using cached payload");
+        return payload;
     }
-    eraseProgressTimer->stop();
 
-    _uploadImage(image);
+    _ui->image->finishRendering();
+    payload.data = Ez::packImage(_ui->image->engraveImage(), format);
+    if(!payload.data.isEmpty()) {
+        _payloadCache.insert(key, payload.data);
+    }
+    return payload;
 }
 
-void MainWindow::_uploadImage(QImage const& image) {
+void MainWindow::_uploadImage(Ez::CachedPayload const& payload) {
+    if(payload.isNull()) {
+        _printVerbose("no image to upload");
+        return;
+    }
+
+    // Mapped payloads have to stay alive until they have been transmitted.
+    _uploadedPayload = payload;
     _bytesWrittenProcessor = std::bind(&MainWindow::updateProgress, this, std::placeholders::_1);
     _printVerbose("uploading image to EEPROM");
-    auto bytes = _ezGraver->uploadImage(image);
+    auto bytes = _ezGraver->uploadImage(payload.data);
     _ui->progress->setValue(0);
     _ui->progress->setMaximum(bytes);
 }
@@ -295,22 +404,68 @@ void MainWindow::on_preview_clicked() {
 void MainWindow::on_start_clicked() {
     _printVerbose(QString{"starting engrave process with burn time %1"}.arg(_ui->burnTime->value()));
     _ezGraver->start(_ui->burnTime->value());
+
+    // Protocol v4 uploads the image after the start, all others engrave the image uploaded last.
+    auto payload = _ezGraver->engravesAfterUpload() && _ui->image->imageLoaded() ? _engravePayload() : _uploadedPayload;
+    auto features = Ez::engraveFeatures(payload.data, _ezGraver->payloadFormat());
+    _engravePixels = features.pixels;
+    _reportedProgress = 0;
+    if(_engravePixels > 0) {
+        _timeModel->begin(features, static_cast<unsigned char>(_ui->burnTime->value()));
+        _printVerbose(QString{"engraving %1 pixels is expected to take %2 s"}.arg(_engravePixels).arg(_timeModel->planned() / 1000.0, 0, 'f', 0));
+    }
+}
+
+void MainWindow::_engraveProgressed(QPoint const& position) {
+    if(!_timeModel || !_timeModel->running()) {
+        return;
+    }
+
+    _timeModel->progress(position);
+    auto engraved = _timeModel->engraved();
+    if(engraved >= _engravePixels) {
+        _printVerbose(QString{"engraving done after %1 s, expected %2 s"}
+                      .arg(_timeModel->elapsed() / 1000.0, 0, 'f', 0).arg(_timeModel->planned() / 1000.0, 0, 'f', 0));
+        _timeModel->finish();
+        return;
+    }
+
+    // The remaining time is reported every tenth of the image.
+    auto progress = engraved * 10 / _engravePixels;
+    if(progress > _reportedProgress) {
+        _reportedProgress = progress;
+        _printVerbose(QString{"%1% engraved, %2 s remaining"}.arg(progress * 10).arg(_timeModel->remaining() / 1000.0, 0, 'f', 0));
+    }
+}
+
+void MainWindow::_stopEngraveTracking() {
+    if(_timeModel) {
+        _timeModel->finish();
+    }
 }
 
 void MainWindow::on_pause_clicked() {
     _printVerbose("pausing engrave process");
+    _stopEngraveTracking();
     _ezGraver->pause();
 }
 
 void MainWindow::on_reset_clicked() {
     _printVerbose("resetting engraver");
+    _eraseOperation->cancel();
+    _eraseProgressTimer.stop();
+    _stopEngraveTracking();
     _ezGraver->reset();
+    _ezGraver->frameDecoder().reset();
     _ui->image->resetProgressImage();
 }
 
 void MainWindow::on_disconnect_clicked() {
     _printVerbose("disconnecting");
     _setConnected(false);
+    _eraseProgressTimer.stop();
+    _eraseOperation.reset();
+    _timeModel.reset();
     _ezGraver.reset();
     _printVerbose("disconnected");
 }
@@ -334,6 +489,15 @@ void MainWindow::on_image_clicked() {
     }
 }
 
+void MainWindow::_dumpTrace() {
+    auto fileName = QFileDialog::getSaveFileName(this, "Save Wire Trace", "", "Wire Traces (*.eztrace)");
+    if(fileName.isNull()) {
+        return;
+    }
+
+    _printVerbose(Ez::Trace::dump(fileName) ? QString{"wire trace written to %1"}.arg(fileName) : "failed to write wire trace");
+}
+
 void MainWindow::dragEnterEvent(QDragEnterEvent* event) {
     if(event->mimeData()->hasUrls() && event->mimeData()->urls().count() == 1) {
         event->acceptProposedAction();
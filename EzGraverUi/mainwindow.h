@@ -5,11 +5,16 @@
 #include <QTimer>
 #include <QSettings>
 #include <QString>
+#include <QByteArray>
 
 #include <memory>
 #include <functional>
 
 #include "ezgraver.h"
+#include "payloadcache.h"
+#include "eraseoperation.h"
+#include "engravetimemodel.h"
+#include "portwatcher.h"
 
 namespace Ui {
 class MainWindow;
@@ -43,27 +48,35 @@ private slots:
     void on_disconnect_clicked();
     void on_image_clicked();
 
-    void updatePorts();
+    void portAdded(Ez::PortInfo const& port);
+    void portRemoved(Ez::PortInfo const& port);
     void bytesWritten(qint64 bytes);
     void updateProgress(qint64 bytes);
-    void updateEngraveProgress();
+    void updateEngraveProgress(Ez::Frame const& frame);
 
 protected:
     void dragEnterEvent(QDragEnterEvent* event);
     void dropEvent(QDropEvent* event);
 
 private:
-    /*! The delay between each port list update. */
-    static int const PortUpdateDelay{1000};
     /*! The delay between each progress update while erasing the EEPROM. */
     static int const EraseProgressDelay{500};
 
     Ui::MainWindow* _ui;
-    QTimer _portTimer{};
+    Ez::PortWatcher _portWatcher{};
+    QTimer _eraseProgressTimer{};
     QImage _image{};
     QSettings _settings{"EzGraver", "EzGraver"};
+    Ez::PayloadCache _payloadCache{};
+    QByteArray _sourceDigest{};
+    Ez::CachedPayload _uploadedPayload{};
+    Ez::CachedPayload _erasePayload{};
 
     std::shared_ptr<Ez::EzGraver> _ezGraver{};
+    std::unique_ptr<Ez::EraseOperation> _eraseOperation{};
+    std::unique_ptr<Ez::EngraveTimeModel> _timeModel{};
+    int _engravePixels{0};
+    int _reportedProgress{0};
     std::function<void(qint64)> _bytesWrittenProcessor{[](qint64){}};
     bool _connected{false};
 
@@ -80,8 +93,13 @@ private:
     void _setConnected(bool connected);
     void _printVerbose(QString const& verbose);
     void _loadImage(QString const& fileName);
-    void _eraseProgressed(QTimer* eraseProgressTimer, QImage const& image, int const& waitTimeMs);
-    void _uploadImage(QImage const& image);
+    void _eraseProgressed();
+    void _erased(qint64 elapsed);
+    void _engraveProgressed(QPoint const& position);
+    void _stopEngraveTracking();
+    Ez::CachedPayload _engravePayload();
+    void _uploadImage(Ez::CachedPayload const& payload);
+    void _dumpTrace();
 };
 
 #endif // MAINWINDOW_H